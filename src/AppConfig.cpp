@@ -3,7 +3,8 @@
  * @brief Preferences-backed load/save for AppConfig.
  *
  * Stores user settings in ESP32 Preferences under namespace "knittled".
- * Keys are kept short to reduce NVS usage.
+ * Keys are kept short to reduce NVS usage. Writes are deferred and
+ * coalesced, and only keys whose value changed are written.
  */
 
 #include "AppConfig.h"
@@ -11,38 +12,101 @@
 
 static Preferences prefs;
 
-/**
- * @brief Load configuration from Preferences into @p cfg.
- */
+// Values as last read from / written to flash; flushConfig() diffs against it.
+static AppConfig stored;
+
+// saveConfig() requests not yet written (millis() of the first and last).
+static bool pending = false;
+static uint32_t pendingSinceMs = 0;
+static uint32_t lastRequestMs = 0;
+
 void loadConfig(AppConfig& cfg) {
   prefs.begin("knittled", true);
   cfg.colorActive = (uint32_t)prefs.getUInt("cA", (unsigned int)cfg.colorActive);
   cfg.colorConfirmed = (uint32_t)prefs.getUInt("cC", (unsigned int)cfg.colorConfirmed);
   cfg.brightness = (uint8_t)prefs.getUChar("br", cfg.brightness);
+  cfg.colorCorrection = (uint32_t)prefs.getUInt("cor", (unsigned int)cfg.colorCorrection);
+
+  cfg.ledSegments = prefs.getString("seg", cfg.ledSegments);
+  cfg.needlePitch = prefs.getUShort("np", cfg.needlePitch);
+  cfg.ledPitch = prefs.getUShort("lp", cfg.ledPitch);
+  cfg.viewCenter = prefs.getShort("vc", cfg.viewCenter);
 
   cfg.autoAdvance = prefs.getBool("aa", cfg.autoAdvance);
   cfg.blinkWarning = prefs.getBool("bw", cfg.blinkWarning);
 
   cfg.currentPatternFile = prefs.getString("file", cfg.currentPatternFile);
-  cfg.activeRow = prefs.getInt("row", cfg.activeRow);
+  cfg.activeRow = prefs.getInt("row", cfg.activeRow);  // legacy; StateJournal overrides
   cfg.rowFromBottom = prefs.getBool("rb", cfg.rowFromBottom);
+
+  cfg.mirrorH = prefs.getBool("mh", cfg.mirrorH);
+  cfg.mirrorV = prefs.getBool("mv", cfg.mirrorV);
+  cfg.invert = prefs.getBool("inv", cfg.invert);
+  cfg.tileX = prefs.getUChar("tx", cfg.tileX);
+  cfg.tileY = prefs.getUChar("ty", cfg.tileY);
+  cfg.needleOffset = prefs.getShort("off", cfg.needleOffset);
   prefs.end();
+
+  stored = cfg;
+  pending = false;
 }
 
-/**
- * @brief Save configuration @p cfg into Preferences.
- */
 void saveConfig(const AppConfig& cfg) {
+  (void)cfg;
+  uint32_t now = millis();
+  if (!pending) pendingSinceMs = now;
+  lastRequestMs = now;
+  pending = true;
+}
+
+void configLoop(const AppConfig& cfg) {
+  if (!pending) return;
+  uint32_t now = millis();
+  if (now - lastRequestMs >= CONFIG_FLUSH_IDLE_MS || now - pendingSinceMs >= CONFIG_FLUSH_MAX_MS) {
+    flushConfig(cfg);
+  }
+}
+
+void flushConfig(const AppConfig& cfg) {
+  pending = false;
+
+  const AppConfig& s = stored;
+  bool dirty =
+    cfg.colorActive != s.colorActive || cfg.colorConfirmed != s.colorConfirmed ||
+    cfg.brightness != s.brightness || cfg.colorCorrection != s.colorCorrection ||
+    cfg.autoAdvance != s.autoAdvance ||
+    cfg.ledSegments != s.ledSegments || cfg.needlePitch != s.needlePitch ||
+    cfg.ledPitch != s.ledPitch || cfg.viewCenter != s.viewCenter ||
+    cfg.blinkWarning != s.blinkWarning || cfg.currentPatternFile != s.currentPatternFile ||
+    cfg.rowFromBottom != s.rowFromBottom ||
+    cfg.mirrorH != s.mirrorH || cfg.mirrorV != s.mirrorV || cfg.invert != s.invert ||
+    cfg.tileX != s.tileX || cfg.tileY != s.tileY || cfg.needleOffset != s.needleOffset;
+  if (!dirty) return;
+
   prefs.begin("knittled", false);
-  prefs.putUInt("cA", (unsigned int)cfg.colorActive);
-  prefs.putUInt("cC", (unsigned int)cfg.colorConfirmed);
-  prefs.putUChar("br", cfg.brightness);
+  if (cfg.colorActive != s.colorActive) prefs.putUInt("cA", (unsigned int)cfg.colorActive);
+  if (cfg.colorConfirmed != s.colorConfirmed) prefs.putUInt("cC", (unsigned int)cfg.colorConfirmed);
+  if (cfg.brightness != s.brightness) prefs.putUChar("br", cfg.brightness);
+  if (cfg.colorCorrection != s.colorCorrection) prefs.putUInt("cor", (unsigned int)cfg.colorCorrection);
+
+  if (cfg.ledSegments != s.ledSegments) prefs.putString("seg", cfg.ledSegments);
+  if (cfg.needlePitch != s.needlePitch) prefs.putUShort("np", cfg.needlePitch);
+  if (cfg.ledPitch != s.ledPitch) prefs.putUShort("lp", cfg.ledPitch);
+  if (cfg.viewCenter != s.viewCenter) prefs.putShort("vc", cfg.viewCenter);
 
-  prefs.putBool("aa", cfg.autoAdvance);
-  prefs.putBool("bw", cfg.blinkWarning);
+  if (cfg.autoAdvance != s.autoAdvance) prefs.putBool("aa", cfg.autoAdvance);
+  if (cfg.blinkWarning != s.blinkWarning) prefs.putBool("bw", cfg.blinkWarning);
 
-  prefs.putString("file", cfg.currentPatternFile);
-  prefs.putInt("row", cfg.activeRow);
-  prefs.putBool("rb", cfg.rowFromBottom);
+  if (cfg.currentPatternFile != s.currentPatternFile) prefs.putString("file", cfg.currentPatternFile);
+  if (cfg.rowFromBottom != s.rowFromBottom) prefs.putBool("rb", cfg.rowFromBottom);
+
+  if (cfg.mirrorH != s.mirrorH) prefs.putBool("mh", cfg.mirrorH);
+  if (cfg.mirrorV != s.mirrorV) prefs.putBool("mv", cfg.mirrorV);
+  if (cfg.invert != s.invert) prefs.putBool("inv", cfg.invert);
+  if (cfg.tileX != s.tileX) prefs.putUChar("tx", cfg.tileX);
+  if (cfg.tileY != s.tileY) prefs.putUChar("ty", cfg.tileY);
+  if (cfg.needleOffset != s.needleOffset) prefs.putShort("off", cfg.needleOffset);
   prefs.end();
+
+  stored = cfg;
 }
@@ -3,18 +3,20 @@
  * @brief Persistent runtime configuration for KnittLED.
  *
  * This header defines @ref AppConfig which holds user-configurable settings
- * (LED colors/brightness, behavior toggles, row direction) and runtime state
- * that may be persisted (active pattern file, active row).
+ * (LED colors/brightness, behavior toggles, row direction) and the selected
+ * pattern file. Knitting progress (row, pulses, warning) lives in KnitEngine.
+ *
+ * Saving is deferred: saveConfig() only marks the settings as changed and
+ * configLoop() writes the keys that differ from flash once changes settle.
  */
 
 #pragma once
 #include <Arduino.h>
 
 /**
- * @brief Application configuration and runtime state.
+ * @brief Application configuration.
  *
- * Most fields are persisted using Preferences (see AppConfig.cpp).
- * Some fields (like counters) are runtime-only unless you decide to persist them.
+ * Fields are persisted using Preferences (see AppConfig.cpp).
  */
 struct AppConfig {
   /** @name LED rendering settings */
@@ -27,6 +29,28 @@ struct AppConfig {
 
   /** @brief LED brightness (0..255). */
   uint8_t brightness = 64;
+
+  /** @brief Per-channel scaling of both colors, 0xRRGGBB (0xFFFFFF = none). */
+  uint32_t colorCorrection = 0xFFFFFF;
+  ///@}
+
+  /** @name LED layout (see LedLayout.h) */
+  ///@{
+  /**
+   * @brief Strip segments from needle #1 on, @c "pin:count" with @c r for reversed.
+   *
+   * Read at boot; changes apply after a restart.
+   */
+  String ledSegments = "25:12";
+
+  /** @brief Needle spacing (0.01 mm). */
+  uint16_t needlePitch = 450;
+
+  /** @brief LED spacing (0.01 mm). */
+  uint16_t ledPitch = 450;
+
+  /** @brief Needle (1-based) under the middle of the strip; 0 = strip starts at needle #1. */
+  int16_t viewCenter = 0;
   ///@}
 
   /** @name Row counting direction */
@@ -49,21 +73,68 @@ struct AppConfig {
   bool blinkWarning = true;
   ///@}
 
+  /** @name Pattern view (applied on the fly while knitting, see PatternViews.h) */
+  ///@{
+  /** @brief Mirror left/right. */
+  bool mirrorH = false;
+
+  /** @brief Mirror top/bottom. */
+  bool mirrorV = false;
+
+  /** @brief Negative (swap knit/unknit stitches). */
+  bool invert = false;
+
+  /** @brief Repeats across the needle bed (1 = off). */
+  uint8_t tileX = 1;
+
+  /** @brief Repeats down the rows (1 = off). */
+  uint8_t tileY = 1;
+
+  /** @brief Needle offset, wrapping; positive moves away from needle #1. */
+  int16_t needleOffset = 0;
+  ///@}
+
   /** @name Persisted selection */
   ///@{
   /** @brief Path to the currently selected pattern file in LittleFS. */
   String currentPatternFile = "/patterns/default.json";
 
-  /** @brief Active row index (0-based, internal top-origin indexing). */
+  /**
+   * @brief Row to start at, from the legacy @c row key (read only).
+   *
+   * Older firmware kept the active row in Preferences. StateJournal
+   * overrides it; the live row is KnitEngine::activeRow().
+   */
   int activeRow = 0;
   ///@}
+};
 
-  /** @name Runtime counters/state */
-  ///@{
-  /** @brief Total carriage sensor pulses since boot (or persisted if desired). */
-  uint32_t totalPulses = 0;
+/** @brief Quiet time after the last saveConfig() before settings are written (ms). */
+static constexpr uint32_t CONFIG_FLUSH_IDLE_MS = 3000;
 
-  /** @brief True when warning blink state is active. */
-  bool warnBlinkActive = false;
-  ///@}
-};
+/** @brief Longest a change may stay unwritten while changes keep coming (ms). */
+static constexpr uint32_t CONFIG_FLUSH_MAX_MS = 30000;
+
+/** @brief Load configuration from Preferences into @p cfg. */
+void loadConfig(AppConfig& cfg);
+
+/**
+ * @brief Note that @p cfg changed and should be persisted.
+ *
+ * Does not touch flash, so it is safe on the carriage pulse path.
+ * The write happens in configLoop() or flushConfig().
+ */
+void saveConfig(const AppConfig& cfg);
+
+/**
+ * @brief Write pending changes once idle for @ref CONFIG_FLUSH_IDLE_MS or
+ *        pending for @ref CONFIG_FLUSH_MAX_MS. Call from loop().
+ */
+void configLoop(const AppConfig& cfg);
+
+/**
+ * @brief Write the keys that differ from flash now (shutdown, reboot).
+ *
+ * Keys whose value did not change since the last write are skipped.
+ */
+void flushConfig(const AppConfig& cfg);
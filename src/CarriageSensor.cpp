@@ -0,0 +1,52 @@
+/**
+ * @file CarriageSensor.cpp
+ * @brief Carriage sensor interrupt handler and edge debouncing.
+ */
+
+#include "CarriageSensor.h"
+
+void CarriageSensor::begin(int pin, bool pullup) {
+  _pin = pin;
+  pinMode(_pin, pullup ? INPUT_PULLUP : INPUT);
+  _level = digitalRead(_pin);
+  _armed = (_level == HIGH);
+  _lastEdgeUs = micros();
+  attachInterruptArg(digitalPinToInterrupt(_pin), onEdge, this, CHANGE);
+}
+
+// Runs in interrupt context: timestamp, read the level, push, wake the consumer.
+void IRAM_ATTR CarriageSensor::onEdge(void* arg) {
+  CarriageSensor* self = static_cast<CarriageSensor*>(arg);
+  CarriageEdge e{ (uint32_t)micros(), (uint8_t)digitalRead(self->_pin) };
+  if (!self->_ring.push(e)) self->_lost.fetch_add(1, std::memory_order_relaxed);
+
+  TaskHandle_t task = self->_notify;
+  if (task) {
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR(task, &woken);
+    if (woken) portYIELD_FROM_ISR();
+  }
+}
+
+bool CarriageSensor::nextPulse(uint32_t& us) {
+  CarriageEdge e;
+  while (_ring.pop(e)) {
+    uint32_t waited = micros() - e.us;
+    if (waited > _maxLatencyUs) _maxLatencyUs = waited;
+
+    // Re-arm once the sensor sat released for a whole debounce period.
+    if (!_armed && _level == HIGH && e.us - _lastEdgeUs >= _debounceUs) _armed = true;
+    _level = e.level;
+    _lastEdgeUs = e.us;
+
+    if (e.level == LOW && _armed && e.us - _pulseUs >= _debounceUs) {
+      _armed = false;
+      _pulseUs = e.us;
+      us = e.us;
+      return true;
+    }
+  }
+
+  if (!_armed && _level == HIGH && micros() - _lastEdgeUs >= _debounceUs) _armed = true;
+  return false;
+}
@@ -0,0 +1,76 @@
+/**
+ * @file CarriageSensor.h
+ * @brief Interrupt-driven carriage sensor with timestamped edges.
+ *
+ * The sensor GPIO raises an interrupt on every edge. The handler only
+ * stamps the edge with micros() and pushes it into a lock-free ring, so a
+ * slow web request or display refresh can delay the processing of a pulse
+ * but cannot lose it. Debouncing works on the recorded timestamps.
+ */
+
+#pragma once
+#include <Arduino.h>
+#include <atomic>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include "SpscRing.h"
+
+/** @brief Edges buffered between interrupt and knitting logic (power of two). */
+static constexpr uint32_t CARRIAGE_RING_SIZE = 64;
+
+/** @brief One sensor edge as seen by the interrupt handler. */
+struct CarriageEdge {
+  uint32_t us;    /**< @brief micros() at the interrupt. */
+  uint8_t level;  /**< @brief Pin level after the edge. */
+};
+
+/**
+ * @brief Carriage pulse detector (INPUT_PULLUP wiring, active LOW).
+ *
+ * A pulse is reported on the first falling edge after the sensor has been
+ * released (HIGH) for at least the debounce time, so latency is not padded
+ * by the debounce window.
+ */
+class CarriageSensor {
+public:
+  explicit CarriageSensor(uint32_t debounceMs = 40) : _debounceUs(debounceMs * 1000u) {}
+
+  CarriageSensor(const CarriageSensor&) = delete;
+  CarriageSensor& operator=(const CarriageSensor&) = delete;
+
+  /** @brief Configure the GPIO and attach the edge interrupt. */
+  void begin(int pin, bool pullup = true);
+
+  /** @brief Wake @p task (task notification) on every edge; nullptr to stop. */
+  void notify(TaskHandle_t task) { _notify = task; }
+
+  /**
+   * @brief Drain buffered edges up to the next pulse.
+   * @param us set to the pulse's interrupt timestamp (micros()).
+   * @return true if a pulse was found; call again until false.
+   */
+  bool nextPulse(uint32_t& us);
+
+  /** @brief Edges dropped because the ring was full (lost pulses show up here). */
+  uint32_t lostEdges() const { return _lost.load(std::memory_order_relaxed); }
+
+  /** @brief Longest time an edge waited in the ring before it was processed (us). */
+  uint32_t maxLatencyUs() const { return _maxLatencyUs; }
+
+private:
+  static void IRAM_ATTR onEdge(void* arg);
+
+  int _pin = -1;
+  uint32_t _debounceUs;
+
+  SpscRing<CarriageEdge, CARRIAGE_RING_SIZE> _ring;
+  std::atomic<uint32_t> _lost{0};
+  TaskHandle_t volatile _notify = nullptr;
+
+  // Consumer-side state
+  bool _armed = true;        // released long enough to accept the next pulse
+  uint8_t _level = HIGH;     // level after the last processed edge
+  uint32_t _lastEdgeUs = 0;
+  uint32_t _pulseUs = 0;
+  uint32_t _maxLatencyUs = 0;
+};
@@ -0,0 +1,77 @@
+/**
+ * @file EventStream.cpp
+ * @brief Server-Sent Events client set.
+ */
+
+#include "EventStream.h"
+
+int EventStream::open() {
+  int slot = -1;
+  for (int i = 0; i < EVENT_MAX_CLIENTS; i++) {
+    if (_ids[i] >= 0 && !_srv->streamOpen(_ids[i])) _ids[i] = -1;
+    if (_ids[i] < 0 && slot < 0) slot = i;
+  }
+
+  if (slot < 0) {
+    _srv->send(503, "text/plain", "Too many event streams");
+    return -1;
+  }
+
+  int id = _srv->beginStream("text/event-stream");
+  if (id < 0) return -1;
+  _ids[slot] = id;
+
+  // Reconnect after 2 s if the stream drops (browser default is 3 s)
+  write(slot, "retry: 2000\n\n");
+  return slot;
+}
+
+void EventStream::write(int slot, const String& frame) {
+  if (!_srv->push(_ids[slot], frame)) _ids[slot] = -1;
+}
+
+static String eventFrame(const char* event, const String& data) {
+  String frame = "event: ";
+  frame += event;
+  frame += "\ndata: ";
+  frame += data;
+  frame += "\n\n";
+  return frame;
+}
+
+void EventStream::sendTo(int slot, const char* event, const String& data) {
+  if (slot < 0 || slot >= EVENT_MAX_CLIENTS || _ids[slot] < 0) return;
+  write(slot, eventFrame(event, data));
+  _lastSendMs = millis();
+}
+
+void EventStream::broadcast(const char* event, const String& data) {
+  String frame = eventFrame(event, data);
+  for (int i = 0; i < EVENT_MAX_CLIENTS; i++) {
+    if (_ids[i] >= 0) write(i, frame);
+  }
+  _lastSendMs = millis();
+}
+
+void EventStream::loop() {
+  for (int i = 0; i < EVENT_MAX_CLIENTS; i++) {
+    if (_ids[i] >= 0 && !_srv->streamOpen(_ids[i])) _ids[i] = -1;
+  }
+  if (!count()) return;
+  if (millis() - _lastSendMs < EVENT_KEEPALIVE_MS) return;
+
+  // A comment line: ignored by EventSource, but finds dead sockets
+  static const String ping(":\n\n");
+  for (int i = 0; i < EVENT_MAX_CLIENTS; i++) {
+    if (_ids[i] >= 0) write(i, ping);
+  }
+  _lastSendMs = millis();
+}
+
+int EventStream::count() const {
+  int n = 0;
+  for (int i = 0; i < EVENT_MAX_CLIENTS; i++) {
+    if (_ids[i] >= 0) n++;
+  }
+  return n;
+}
@@ -0,0 +1,61 @@
+/**
+ * @file EventStream.h
+ * @brief Server-Sent Events push channel on top of HttpServer streams.
+ *
+ * A browser opens @c /api/events once and keeps the response open; the
+ * device writes an event whenever the knitting state changes instead of
+ * answering a request every 350 ms. Only changed fields are sent, so a
+ * carriage pass costs one small frame per client.
+ *
+ * The streams are ordinary HttpServer connections (see
+ * HttpServer::beginStream()): writes are queued without blocking, and a
+ * client that stops reading is dropped once its queue is full.
+ */
+
+#pragma once
+#include <Arduino.h>
+#include "HttpServer.h"
+
+/** @brief Open event streams (each one holds an HttpServer connection). */
+static constexpr int EVENT_MAX_CLIENTS = 4;
+
+/** @brief Comment line sent on idle streams so proxies and browsers keep them (ms). */
+static constexpr uint32_t EVENT_KEEPALIVE_MS = 15000;
+
+/**
+ * @brief Set of open @c text/event-stream responses. Web task only.
+ */
+class EventStream {
+public:
+  EventStream() {
+    for (int& id : _ids) id = -1;
+  }
+
+  /** @brief Server whose connections carry the streams. */
+  void begin(HttpServer* srv) { _srv = srv; }
+
+  /**
+   * @brief Answer the request being handled with an event stream.
+   * @return Slot of the new stream, or -1 if all are taken (503 sent).
+   */
+  int open();
+
+  /** @brief Event to a single client (e.g. the full state right after open()). */
+  void sendTo(int slot, const char* event, const String& data);
+
+  /** @brief Event to every open client; clients that went away are dropped. */
+  void broadcast(const char* event, const String& data);
+
+  /** @brief Drop closed clients and send keepalives. Call from the web task loop. */
+  void loop();
+
+  /** @brief Number of open streams. */
+  int count() const;
+
+private:
+  void write(int slot, const String& frame);
+
+  HttpServer* _srv = nullptr;
+  int _ids[EVENT_MAX_CLIENTS];  // HttpServer stream ids, -1 = free
+  uint32_t _lastSendMs = 0;
+};
@@ -0,0 +1,896 @@
+/**
+ * @file HttpServer.cpp
+ * @brief Non-blocking HTTP/1.1 server: connection state machine and I/O.
+ */
+
+#include "HttpServer.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+static constexpr size_t FILE_CHUNK = 1436;
+
+struct HttpConn {
+  enum State : uint8_t { READ_HEAD, READ_BODY, WRITE, STREAM };
+  enum Body : uint8_t { BODY_PLAIN, BODY_FORM, BODY_MULTIPART, BODY_RAW };
+  enum Part : uint8_t { MP_PREAMBLE, MP_HEAD, MP_DATA, MP_AFTER, MP_DONE };
+
+  int fd = -1;
+  uint16_t gen = 0;
+  State state = READ_HEAD;
+  uint32_t lastMs = 0;
+
+  char in[HTTP_IN_BUF];
+  size_t inLen = 0;
+
+  // Request (READ_HEAD .. handler)
+  HTTPMethod method = HTTP_GET;
+  String uri;
+  String head;  // header lines, for header()
+  std::vector<std::pair<String, String>> args;
+  String plain;
+  bool http10 = false;
+  bool keepAlive = true;
+  size_t bodyLeft = 0;  // body bytes not yet consumed from in[] and the socket
+  Body body = BODY_PLAIN;
+  const void* route = nullptr;
+
+  // Multipart body
+  String delim;  // "\r\n--" + boundary
+  Part part = MP_PREAMBLE;
+  bool fileOpen = false;
+  String fieldName;
+  String fieldValue;
+
+  // Response
+  size_t contentLength = CONTENT_LENGTH_NOT_SET;
+  String headers;  // from sendHeader()
+  bool responded = false;
+  bool chunked = false;
+  bool chunkEnded = false;
+  String out;
+  size_t outPos = 0;
+  const char* flash = nullptr;
+  size_t flashLen = 0;
+  File file;
+  uint8_t* fileBuf = nullptr;
+  size_t fileLen = 0;
+  size_t filePos = 0;
+  HttpBodySource* source = nullptr;  // sendChunked() body, pulled by pump()
+  String piece;                      // one fill() of it
+
+  ~HttpConn() {
+    delete[] fileBuf;
+    delete source;
+  }
+
+  // Body goes to the upload handler (one such request at a time)
+  bool streamsBody() const { return state == READ_BODY && (body == BODY_MULTIPART || body == BODY_RAW); }
+
+  size_t pending() const { return out.length() - outPos + flashLen + (fileLen - filePos); }
+  bool sending() const { return pending() || file || source; }
+};
+
+// ------------------------------------------------------------
+// Helpers
+// ------------------------------------------------------------
+
+static int findBytes(const char* hay, size_t n, const char* needle, size_t k) {
+  if (k == 0 || n < k) return -1;
+  for (size_t i = 0; i + k <= n; i++) {
+    if (hay[i] == needle[0] && memcmp(hay + i, needle, k) == 0) return (int)i;
+  }
+  return -1;
+}
+
+// Print into a String (body source pieces).
+class StringSink : public Print {
+public:
+  explicit StringSink(String& s) : _s(s) {}
+  size_t write(uint8_t c) override { return _s.concat((char)c) ? 1 : 0; }
+  size_t write(const uint8_t* b, size_t n) override {
+    return _s.concat((const char*)b, n) ? n : 0;
+  }
+
+private:
+  String& _s;
+};
+
+static void consume(HttpConn* c, size_t n) {
+  memmove(c->in, c->in + n, c->inLen - n);
+  c->inLen -= n;
+}
+
+static int hexVal(char h) {
+  if (h >= '0' && h <= '9') return h - '0';
+  if (h >= 'a' && h <= 'f') return h - 'a' + 10;
+  if (h >= 'A' && h <= 'F') return h - 'A' + 10;
+  return -1;
+}
+
+static String urlDecode(const char* s, size_t n) {
+  String out;
+  out.reserve(n);
+  for (size_t i = 0; i < n; i++) {
+    char ch = s[i];
+    if (ch == '+') ch = ' ';
+    else if (ch == '%' && i + 2 < n && hexVal(s[i + 1]) >= 0 && hexVal(s[i + 2]) >= 0) {
+      ch = (char)(hexVal(s[i + 1]) * 16 + hexVal(s[i + 2]));
+      i += 2;
+    }
+    out += ch;
+  }
+  return out;
+}
+
+// "a=1&b=two" -> args
+static void parseArgs(HttpConn* c, const char* s, size_t n) {
+  size_t i = 0;
+  while (i < n) {
+    size_t end = i;
+    while (end < n && s[end] != '&') end++;
+    size_t eq = i;
+    while (eq < end && s[eq] != '=') eq++;
+    if (end > i) {
+      String v = eq < end ? urlDecode(s + eq + 1, end - eq - 1) : String();
+      c->args.push_back(std::make_pair(urlDecode(s + i, eq - i), v));
+    }
+    i = end + 1;
+  }
+}
+
+// Value of "name=..." (optionally quoted) inside a header value.
+static String headerParam(const String& v, const char* name) {
+  String key = String(name) + "=";
+  int p = -1;
+  do {
+    p = v.indexOf(key, p + 1);
+  } while (p > 0 && v[p - 1] != ' ' && v[p - 1] != ';');  // "name" is also in "filename"
+  if (p < 0) return String();
+  p += key.length();
+  if (p < (int)v.length() && v[p] == '"') {
+    int e = v.indexOf('"', p + 1);
+    return v.substring(p + 1, e < 0 ? v.length() : e);
+  }
+  int e = v.indexOf(';', p);
+  String r = v.substring(p, e < 0 ? v.length() : e);
+  r.trim();
+  return r;
+}
+
+// Header value from a block of "Name: value\r\n" lines.
+static String findHeader(const String& head, const char* name) {
+  size_t k = strlen(name);
+  int pos = 0;
+  while (pos < (int)head.length()) {
+    int eol = head.indexOf("\r\n", pos);
+    if (eol < 0) eol = head.length();
+    if (eol - pos > (int)k && head[pos + k] == ':' && strncasecmp(head.c_str() + pos, name, k) == 0) {
+      String v = head.substring(pos + k + 1, eol);
+      v.trim();
+      return v;
+    }
+    pos = eol + 2;
+  }
+  return String();
+}
+
+static const char* reason(int code) {
+  switch (code) {
+    case 200: return "OK";
+    case 204: return "No Content";
+    case 302: return "Found";
+    case 304: return "Not Modified";
+    case 400: return "Bad Request";
+    case 404: return "Not Found";
+    case 411: return "Length Required";
+    case 413: return "Payload Too Large";
+    case 431: return "Request Header Fields Too Large";
+    case 500: return "Internal Server Error";
+    case 503: return "Service Unavailable";
+    default: return "";
+  }
+}
+
+// ------------------------------------------------------------
+// Setup
+// ------------------------------------------------------------
+
+bool HttpServer::begin() {
+  stop();
+
+  _listen = socket(AF_INET, SOCK_STREAM, 0);
+  if (_listen < 0) return false;
+
+  int one = 1;
+  setsockopt(_listen, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+  sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(_port);
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+
+  if (bind(_listen, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(_listen, HTTP_MAX_CLIENTS) != 0) {
+    Serial.println("HTTP: cannot listen on port " + String(_port));
+    ::close(_listen);
+    _listen = -1;
+    return false;
+  }
+  fcntl(_listen, F_SETFL, fcntl(_listen, F_GETFL, 0) | O_NONBLOCK);
+  return true;
+}
+
+void HttpServer::stop() {
+  for (int i = 0; i < HTTP_MAX_CLIENTS; i++) close(i);
+  if (_listen >= 0) ::close(_listen);
+  _listen = -1;
+}
+
+void HttpServer::on(const String& uri, HTTPMethod method, THandlerFunction fn) {
+  on(uri, method, fn, THandlerFunction());
+}
+
+void HttpServer::on(const String& uri, HTTPMethod method, THandlerFunction fn, THandlerFunction upload) {
+  Route r;
+  r.uri = uri;
+  r.method = method;
+  r.fn = fn;
+  r.upload = upload;
+  _routes.push_back(r);
+}
+
+// ------------------------------------------------------------
+// Event loop
+// ------------------------------------------------------------
+
+void HttpServer::handleClient() {
+  if (_listen < 0) return;
+
+  fd_set rd, wr;
+  FD_ZERO(&rd);
+  FD_ZERO(&wr);
+  int maxFd = -1;
+  int used = 0;
+
+  for (int i = 0; i < HTTP_MAX_CLIENTS; i++) {
+    HttpConn* c = _conns[i];
+    if (!c) continue;
+    used++;
+    if (c->sending()) FD_SET(c->fd, &wr);
+    // Responses first: a connection is not read while its answer is queued,
+    // except streams (to notice the client leaving). An upload queued behind
+    // another one is not read either.
+    bool read = c->state == HttpConn::STREAM || (c->state != HttpConn::WRITE && !c->sending());
+    if (c->streamsBody() && _uploading && _uploading != c) read = false;
+    if (read && c->inLen < sizeof(c->in)) FD_SET(c->fd, &rd);
+    if (c->fd > maxFd) maxFd = c->fd;
+  }
+  if (used < HTTP_MAX_CLIENTS) {
+    FD_SET(_listen, &rd);
+    if (_listen > maxFd) maxFd = _listen;
+  }
+
+  timeval tv = {0, 0};
+  if (select(maxFd + 1, &rd, &wr, nullptr, &tv) < 0) return;
+
+  if (FD_ISSET(_listen, &rd)) accept();
+
+  uint32_t now = millis();
+  for (int i = 0; i < HTTP_MAX_CLIENTS; i++) {
+    HttpConn* c = _conns[i];
+    if (!c || c->fd < 0) continue;
+
+    if (FD_ISSET(c->fd, &wr) && !pump(c)) { close(i); continue; }
+
+    if (FD_ISSET(c->fd, &rd)) {
+      ssize_t n = recv(c->fd, c->in + c->inLen, sizeof(c->in) - c->inLen, MSG_DONTWAIT);
+      if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) { close(i); continue; }
+      if (n > 0) {
+        c->lastMs = now;
+        if (c->state == HttpConn::STREAM) c->inLen = 0;  // nothing to read on a stream
+        else c->inLen += n;
+      }
+    }
+
+    if (c->streamsBody() && _uploading && _uploading != c) {
+      c->lastMs = now;  // queued behind another upload, not idle
+    }
+    if (c->state == HttpConn::READ_HEAD || c->state == HttpConn::READ_BODY) process(c);
+    if (c->state == HttpConn::WRITE && !c->sending()) finish(c);
+    if (!_conns[i]) continue;
+
+    if (c->state != HttpConn::STREAM && millis() - c->lastMs > HTTP_IDLE_MS) close(i);
+  }
+}
+
+void HttpServer::accept() {
+  for (int i = 0; i < HTTP_MAX_CLIENTS; i++) {
+    if (_conns[i]) continue;
+
+    int fd = ::accept(_listen, nullptr, nullptr);
+    if (fd < 0) return;
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    HttpConn* c = new HttpConn();
+    c->fd = fd;
+    c->gen = ++_gen;
+    c->lastMs = millis();
+    _conns[i] = c;
+  }
+}
+
+void HttpServer::close(int slot) {
+  HttpConn* c = _conns[slot];
+  if (!c) return;
+  if (_uploading == c) {
+    if (c->fileOpen) uploadEvent(c, UPLOAD_FILE_ABORTED);
+    _uploading = nullptr;
+  }
+  if (c->file) c->file.close();
+  if (c->fd >= 0) ::close(c->fd);
+  delete c;
+  _conns[slot] = nullptr;
+}
+
+// ------------------------------------------------------------
+// Requests
+// ------------------------------------------------------------
+
+void HttpServer::process(HttpConn* c) {
+  if (c->state == HttpConn::READ_HEAD && !parseHead(c)) return;
+  if (c->state == HttpConn::READ_BODY && readBody(c)) dispatch(c);
+}
+
+// Request line and headers; false until the blank line is in.
+bool HttpServer::parseHead(HttpConn* c) {
+  int end = findBytes(c->in, c->inLen, "\r\n\r\n", 4);
+  if (end < 0) {
+    if (c->inLen == sizeof(c->in)) fail(c, 431, "Request head too large");
+    return false;
+  }
+
+  const char* p = c->in;
+  const char* lineEnd = p + findBytes(p, end + 2, "\r\n", 2);
+  const char* sp1 = (const char*)memchr(p, ' ', lineEnd - p);
+  const char* sp2 = sp1 ? (const char*)memchr(sp1 + 1, ' ', lineEnd - sp1 - 1) : nullptr;
+  if (!sp2) { fail(c, 400, "Bad request"); return false; }
+
+  String m;
+  m.concat(p, sp1 - p);
+  c->method = m == "GET" ? HTTP_GET : m == "POST" ? HTTP_POST : m == "HEAD" ? HTTP_HEAD :
+              m == "PUT" ? HTTP_PUT : m == "PATCH" ? HTTP_PATCH : m == "DELETE" ? HTTP_DELETE :
+              m == "OPTIONS" ? HTTP_OPTIONS : HTTP_ANY;
+  c->http10 = (lineEnd - sp2 - 1 == 8) && memcmp(sp2 + 1, "HTTP/1.0", 8) == 0;
+
+  const char* target = sp1 + 1;
+  const char* q = (const char*)memchr(target, '?', sp2 - target);
+  c->uri = urlDecode(target, (q ? q : sp2) - target);
+  c->args.clear();
+  if (q) parseArgs(c, q + 1, sp2 - q - 1);
+
+  c->head = String();
+  c->head.concat(lineEnd + 2, (c->in + end + 2) - (lineEnd + 2));
+  consume(c, end + 4);
+
+  String conn = findHeader(c->head, "Connection");
+  conn.toLowerCase();
+  c->keepAlive = c->http10 ? conn.indexOf("keep-alive") >= 0 : conn.indexOf("close") < 0;
+
+  c->route = nullptr;
+  for (const Route& r : _routes) {
+    if (r.uri == c->uri && (r.method == HTTP_ANY || r.method == c->method)) { c->route = &r; break; }
+  }
+
+  // Response state for this request
+  c->contentLength = CONTENT_LENGTH_NOT_SET;
+  c->headers = String();
+  c->responded = c->chunked = c->chunkEnded = false;
+  c->plain = String();
+
+  if (findHeader(c->head, "Transfer-Encoding").length()) { fail(c, 411, "Length required"); return false; }
+  c->bodyLeft = (size_t)findHeader(c->head, "Content-Length").toInt();
+
+  String type = findHeader(c->head, "Content-Type");
+  const Route* route = (const Route*)c->route;
+  c->body = HttpConn::BODY_PLAIN;
+  if (type.startsWith("application/x-www-form-urlencoded")) c->body = HttpConn::BODY_FORM;
+  else if (type.startsWith("multipart/form-data") && route && route->upload) {
+    c->body = HttpConn::BODY_MULTIPART;
+    c->delim = "\r\n--" + headerParam(type, "boundary");
+    c->part = HttpConn::MP_PREAMBLE;
+    c->fileOpen = false;
+    if (c->delim.length() <= 4 || c->delim.length() > 80) { fail(c, 400, "Bad boundary"); return false; }
+  } else if (route && route->upload) {
+    c->body = HttpConn::BODY_RAW;
+    c->fileOpen = false;
+  }
+  if ((c->body == HttpConn::BODY_PLAIN || c->body == HttpConn::BODY_FORM) && c->bodyLeft &&
+      (c->bodyLeft > HTTP_BODY_MAX || !c->plain.reserve(c->bodyLeft))) {
+    fail(c, 413, "Body too large");
+    return false;
+  }
+
+  if (c->bodyLeft && findHeader(c->head, "Expect").equalsIgnoreCase("100-continue")) {
+    static const char cont[] = "HTTP/1.1 100 Continue\r\n\r\n";
+    queue(c, cont, sizeof(cont) - 1);
+  }
+
+  c->state = HttpConn::READ_BODY;
+  return true;
+}
+
+// Consumes body bytes from in[]; true once the whole body is in.
+bool HttpServer::readBody(HttpConn* c) {
+  if (c->body == HttpConn::BODY_MULTIPART) {
+    if (_uploading && _uploading != c) return false;
+    _uploading = c;
+    bool done = multipart(c);
+    if (done) _uploading = nullptr;
+    return done;
+  }
+
+  if (c->body == HttpConn::BODY_RAW) {
+    if (_uploading && _uploading != c) return false;
+    if (!c->fileOpen) {
+      _uploading = c;
+      _upload.filename = String();
+      _upload.name = String();
+      _upload.type = findHeader(c->head, "Content-Type");
+      _upload.totalSize = 0;
+      _upload.currentSize = 0;
+      c->fileOpen = true;
+      uploadEvent(c, UPLOAD_FILE_START);
+    }
+    size_t n = min(c->inLen, c->bodyLeft);
+    uploadPiece(c, c->in, n);
+    consume(c, n);
+    c->bodyLeft -= n;
+    if (c->bodyLeft) return false;
+
+    c->fileOpen = false;
+    uploadEvent(c, UPLOAD_FILE_END);
+    _uploading = nullptr;
+    return true;
+  }
+
+  size_t n = min(c->inLen, c->bodyLeft);
+  c->plain.concat(c->in, n);
+  consume(c, n);
+  c->bodyLeft -= n;
+  if (c->bodyLeft) return false;
+
+  if (c->body == HttpConn::BODY_FORM) {
+    parseArgs(c, c->plain.c_str(), c->plain.length());
+    c->plain = String();
+  }
+  return true;
+}
+
+// Streams the parts of a multipart body; files go to the upload handler,
+// other fields become args. true once the whole body is consumed.
+bool HttpServer::multipart(HttpConn* c) {
+  const char* delim = c->delim.c_str();
+  const size_t dlen = c->delim.length();
+
+  for (;;) {
+    size_t avail = min(c->inLen, c->bodyLeft);
+    bool last = avail == c->bodyLeft;  // nothing more will arrive for this body
+    size_t used = 0;
+
+    switch (c->part) {
+      case HttpConn::MP_PREAMBLE: {
+        // First delimiter has no leading CRLF
+        int p = findBytes(c->in, avail, delim + 2, dlen - 2);
+        if (p < 0) {
+          used = last ? avail : (avail > dlen ? avail - dlen : 0);
+          if (last) c->part = HttpConn::MP_DONE;
+        } else if (p + dlen - 2 + 2 <= avail) {
+          used = p + dlen - 2;
+          c->part = HttpConn::MP_AFTER;
+        } else if (last) {
+          used = avail;
+          c->part = HttpConn::MP_DONE;
+        }
+        break;
+      }
+
+      case HttpConn::MP_HEAD: {
+        int p = findBytes(c->in, avail, "\r\n\r\n", 4);
+        if (p < 0) {
+          if (last || avail == sizeof(c->in)) { used = avail; c->part = HttpConn::MP_DONE; }
+          break;
+        }
+        String h;
+        h.concat(c->in, p + 2);
+        String disp = findHeader(h, "Content-Disposition");
+        c->fieldName = headerParam(disp, "name");
+        c->fieldValue = String();
+        if (disp.indexOf("filename=") >= 0) {
+          _upload.filename = headerParam(disp, "filename");
+          _upload.name = c->fieldName;
+          _upload.type = findHeader(h, "Content-Type");
+          _upload.totalSize = 0;
+          _upload.currentSize = 0;
+          c->fileOpen = true;
+          uploadEvent(c, UPLOAD_FILE_START);
+        }
+        used = p + 4;
+        c->part = HttpConn::MP_DATA;
+        break;
+      }
+
+      case HttpConn::MP_DATA: {
+        int p = findBytes(c->in, avail, delim, dlen);
+        size_t n = p >= 0 ? (size_t)p : last ? avail : (avail >= dlen ? avail - (dlen - 1) : 0);
+        if (!c->fileOpen && c->fieldValue.length() + n > HTTP_BODY_MAX) {
+          // Fields are kept in RAM like form bodies, and limited the same way
+          _uploading = nullptr;
+          fail(c, 413, "Body too large");
+          return false;
+        }
+        uploadPiece(c, c->in, n);
+        used = n;
+        if (p >= 0) {
+          used += dlen;
+          if (c->fileOpen) {
+            c->fileOpen = false;
+            uploadEvent(c, UPLOAD_FILE_END);
+          } else if (c->fieldName.length()) {
+            c->args.push_back(std::make_pair(c->fieldName, c->fieldValue));
+          }
+          c->part = HttpConn::MP_AFTER;
+        } else if (last) {
+          c->part = HttpConn::MP_DONE;
+        }
+        break;
+      }
+
+      case HttpConn::MP_AFTER:
+        if (avail < 2) {
+          if (last) { used = avail; c->part = HttpConn::MP_DONE; }
+          break;
+        }
+        c->part = (c->in[0] == '-' && c->in[1] == '-') ? HttpConn::MP_DONE : HttpConn::MP_HEAD;
+        used = 2;
+        break;
+
+      case HttpConn::MP_DONE:
+        used = avail;  // epilogue
+        break;
+    }
+
+    consume(c, used);
+    c->bodyLeft -= used;
+
+    if (c->part == HttpConn::MP_DONE && !c->bodyLeft) {
+      if (c->fileOpen) {
+        c->fileOpen = false;
+        uploadEvent(c, UPLOAD_FILE_ABORTED);
+      }
+      return true;
+    }
+    if (!used) return false;
+  }
+}
+
+void HttpServer::uploadPiece(HttpConn* c, const char* data, size_t len) {
+  if (!c->fileOpen) {
+    c->fieldValue.concat(data, len);
+    return;
+  }
+  while (len) {
+    size_t k = min(len, sizeof(_upload.buf));
+    memcpy(_upload.buf, data, k);
+    _upload.currentSize = k;
+    _upload.totalSize += k;
+    uploadEvent(c, UPLOAD_FILE_WRITE);
+    data += k;
+    len -= k;
+  }
+}
+
+void HttpServer::uploadEvent(HttpConn* c, HTTPUploadStatus status) {
+  const Route* r = (const Route*)c->route;
+  _upload.status = status;
+  _cur = c;
+  if (r && r->upload) r->upload();
+  _cur = nullptr;
+}
+
+void HttpServer::dispatch(HttpConn* c) {
+  const Route* r = (const Route*)c->route;
+  _cur = c;
+  if (r) r->fn();
+  else if (_notFound) _notFound();
+  else send(404, "text/plain", "Not found");
+
+  if (!c->responded) send(500, "text/plain", "No response");
+  if (c->chunked && !c->chunkEnded && !c->source) sendContent("", 0);
+  _cur = nullptr;
+
+  // Drop what only the handler needed
+  c->args.clear();
+  c->plain = String();
+  c->head = String();
+  c->fieldName = String();
+  c->fieldValue = String();
+  c->headers = String();
+
+  if (c->state != HttpConn::STREAM) c->state = HttpConn::WRITE;
+}
+
+// Error before a handler ran: answer and close.
+void HttpServer::fail(HttpConn* c, int code, const char* msg) {
+  c->keepAlive = false;
+  c->inLen = 0;
+  c->contentLength = CONTENT_LENGTH_NOT_SET;
+  c->headers = String();
+  c->responded = false;
+  _cur = c;
+  send(code, "text/plain", msg);
+  _cur = nullptr;
+  c->state = HttpConn::WRITE;
+}
+
+// Response fully written: next request on the connection, or close.
+void HttpServer::finish(HttpConn* c) {
+  if (!c->keepAlive) {
+    for (int i = 0; i < HTTP_MAX_CLIENTS; i++) {
+      if (_conns[i] == c) close(i);
+    }
+    return;
+  }
+  c->state = HttpConn::READ_HEAD;
+  c->lastMs = millis();
+  if (c->inLen) process(c);  // pipelined request
+}
+
+// ------------------------------------------------------------
+// Request accessors
+// ------------------------------------------------------------
+
+String HttpServer::arg(const String& name) const {
+  if (!_cur) return String();
+  if (name == "plain") return _cur->plain;
+  for (const auto& a : _cur->args) {
+    if (a.first == name) return a.second;
+  }
+  return String();
+}
+
+bool HttpServer::hasArg(const String& name) const {
+  if (!_cur) return false;
+  if (name == "plain") return _cur->plain.length() > 0;
+  for (const auto& a : _cur->args) {
+    if (a.first == name) return true;
+  }
+  return false;
+}
+
+String HttpServer::uri() const { return _cur ? _cur->uri : String(); }
+
+HTTPMethod HttpServer::method() const { return _cur ? _cur->method : HTTP_ANY; }
+
+String HttpServer::header(const char* name) const { return _cur ? findHeader(_cur->head, name) : String(); }
+
+// ------------------------------------------------------------
+// Responses
+// ------------------------------------------------------------
+
+void HttpServer::sendHeader(const String& name, const String& value, bool first) {
+  if (!_cur) return;
+  String line = name + ": " + value + "\r\n";
+  if (first) _cur->headers = line + _cur->headers;
+  else _cur->headers += line;
+}
+
+void HttpServer::setContentLength(size_t len) {
+  if (_cur) _cur->contentLength = len;
+}
+
+void HttpServer::writeHead(HttpConn* c, int code, const char* type, size_t len) {
+  String h = "HTTP/1.1 " + String(code) + " " + reason(code) + "\r\n";
+  if (type && *type) h += String("Content-Type: ") + type + "\r\n";
+  if (len == CONTENT_LENGTH_UNKNOWN) {
+    // HTTP/1.0 has no chunks: the end of the body is the end of the connection
+    if (c->http10) c->keepAlive = false;
+    else {
+      h += "Transfer-Encoding: chunked\r\n";
+      c->chunked = true;
+    }
+  } else {
+    h += "Content-Length: " + String((unsigned long)len) + "\r\n";
+  }
+  h += c->keepAlive ? "Connection: keep-alive\r\n" : "Connection: close\r\n";
+  h += c->headers;
+  h += "\r\n";
+  queue(c, h.c_str(), h.length());
+  c->responded = true;
+}
+
+void HttpServer::send(int code, const char* type, const String& body) {
+  HttpConn* c = _cur;
+  if (!c || c->responded) return;
+  size_t len = c->contentLength == CONTENT_LENGTH_NOT_SET ? body.length() : c->contentLength;
+  writeHead(c, code, type, len);
+  if (body.length()) sendContent(body);
+}
+
+void HttpServer::send_P(int code, const char* type, const char* body, size_t len) {
+  HttpConn* c = _cur;
+  if (!c || c->responded) return;
+  writeHead(c, code, type, len);
+  c->flash = body;
+  c->flashLen = len;
+}
+
+void HttpServer::sendContent(const char* data, size_t len) {
+  HttpConn* c = _cur;
+  if (!c || !c->responded || c->chunkEnded || c->source) return;
+  queueBody(c, data, len);
+}
+
+size_t HttpServer::streamFile(File& file, const String& type, int code) {
+  HttpConn* c = _cur;
+  if (!c || c->responded || !file) return 0;
+  size_t len = file.size();
+  writeHead(c, code, type.c_str(), len);
+  c->file = file;
+  if (!c->fileBuf) c->fileBuf = new uint8_t[FILE_CHUNK];
+  return len;
+}
+
+void HttpServer::sendChunked(int code, const char* type, HttpBodySource* body) {
+  HttpConn* c = _cur;
+  if (!c || c->responded) {
+    delete body;
+    return;
+  }
+  writeHead(c, code, type, CONTENT_LENGTH_UNKNOWN);
+  c->source = body;
+}
+
+// ------------------------------------------------------------
+// Event streams
+// ------------------------------------------------------------
+
+int HttpServer::beginStream(const char* type) {
+  HttpConn* c = _cur;
+  if (!c || c->responded) return -1;
+
+  String h = "HTTP/1.1 200 OK\r\nContent-Type: ";
+  h += type;
+  h += "\r\nCache-Control: no-cache\r\nConnection: keep-alive\r\n";
+  h += c->headers;
+  h += "\r\n";
+  queue(c, h.c_str(), h.length());
+  c->responded = true;
+  c->state = HttpConn::STREAM;
+
+  for (int i = 0; i < HTTP_MAX_CLIENTS; i++) {
+    if (_conns[i] == c) return c->gen * HTTP_MAX_CLIENTS + i;
+  }
+  return -1;
+}
+
+HttpConn* HttpServer::stream(int id) const {
+  if (id < 0) return nullptr;
+  HttpConn* c = _conns[id % HTTP_MAX_CLIENTS];
+  if (!c || c->gen != (uint16_t)(id / HTTP_MAX_CLIENTS) || c->state != HttpConn::STREAM) return nullptr;
+  return c;
+}
+
+bool HttpServer::push(int id, const String& data) {
+  HttpConn* c = stream(id);
+  if (!c) return false;
+
+  if (c->pending() + data.length() > HTTP_STREAM_QUEUE_MAX) {
+    close(id % HTTP_MAX_CLIENTS);
+    return false;
+  }
+  queue(c, data.c_str(), data.length());
+  if (!pump(c)) {
+    close(id % HTTP_MAX_CLIENTS);
+    return false;
+  }
+  return true;
+}
+
+// ------------------------------------------------------------
+// Output
+// ------------------------------------------------------------
+
+void HttpServer::queue(HttpConn* c, const char* data, size_t len) {
+  if (c->outPos && c->outPos == c->out.length()) {
+    c->out = String();
+    c->outPos = 0;
+  } else if (c->outPos > HTTP_OUT_HIGH_WATER) {
+    c->out.remove(0, c->outPos);
+    c->outPos = 0;
+  }
+  c->out.concat(data, len);
+}
+
+// Body bytes, framed as a chunk where the response is chunked; an empty
+// call ends a chunked body.
+void HttpServer::queueBody(HttpConn* c, const char* data, size_t len) {
+  if (!c->chunked) {
+    queue(c, data, len);
+    return;
+  }
+  char size[12];
+  snprintf(size, sizeof(size), "%x\r\n", (unsigned)len);
+  queue(c, size, strlen(size));
+  if (len) queue(c, data, len);
+  queue(c, "\r\n", 2);
+  if (!len) c->chunkEnded = true;
+}
+
+// Writes what the socket takes: queued bytes, then flash body, then file,
+// then pieces pulled from a body source. false if the connection is broken
+// (or the body source gave up).
+bool HttpServer::pump(HttpConn* c) {
+  for (;;) {
+    const char* p;
+    size_t n;
+    if (c->outPos < c->out.length()) {
+      p = c->out.c_str() + c->outPos;
+      n = c->out.length() - c->outPos;
+    } else if (c->flashLen) {
+      p = c->flash;
+      n = c->flashLen;
+    } else if (c->filePos < c->fileLen) {
+      p = (const char*)c->fileBuf + c->filePos;
+      n = c->fileLen - c->filePos;
+    } else if (c->file) {
+      c->fileLen = c->file.read(c->fileBuf, FILE_CHUNK);
+      c->filePos = 0;
+      if (!c->fileLen) c->file.close();
+      continue;
+    } else if (c->source) {
+      if (!fill(c)) return false;
+      if (!c->pending()) return true;  // nothing this time; asked again next pass
+      continue;
+    } else {
+      if (c->out.length()) {
+        c->out = String();
+        c->outPos = 0;
+      }
+      return true;
+    }
+
+    ssize_t k = ::send(c->fd, p, n, MSG_DONTWAIT | MSG_NOSIGNAL);
+    if (k < 0) return errno == EAGAIN || errno == EWOULDBLOCK;
+    c->lastMs = millis();
+
+    if (c->outPos < c->out.length()) c->outPos += k;
+    else if (c->flashLen) { c->flash += k; c->flashLen -= k; }
+    else c->filePos += k;
+
+    if ((size_t)k < n) return true;  // socket buffer full
+  }
+}
+
+// Queues the next piece of the body source; the last one is followed by
+// the end of the body. false if the source gave up.
+bool HttpServer::fill(HttpConn* c) {
+  c->piece.remove(0);  // keeps the buffer for the next piece
+  StringSink sink(c->piece);
+  if (!c->source->fill(sink)) return false;
+  if (c->piece.length()) queueBody(c, c->piece.c_str(), c->piece.length());
+  if (c->source->done()) {
+    delete c->source;
+    c->source = nullptr;
+    c->piece = String();
+    if (c->chunked) queueBody(c, "", 0);
+  }
+  return true;
+}
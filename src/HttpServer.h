@@ -0,0 +1,246 @@
+/**
+ * @file HttpServer.h
+ * @brief Non-blocking HTTP/1.1 server for the web UI (several connections, keep-alive).
+ *
+ * The framework WebServer serves one client at a time and blocks in its
+ * reads and writes: one slow upload or download held up every other
+ * request. HttpServer keeps up to @ref HTTP_MAX_CLIENTS connections, each
+ * with its own state, and handleClient() makes one non-blocking pass over
+ * all of them:
+ * - request heads and bodies are read as they arrive; uploads reach the
+ *   upload handler piece by piece while other connections are served;
+ * - responses are queued and written as the socket accepts them. A
+ *   connection is not read while its response is pending (backpressure),
+ *   and files and flash data are sent from their source, not copied;
+ * - connections stay open for further requests (keep-alive) and are closed
+ *   after @ref HTTP_IDLE_MS without progress.
+ *
+ * Handlers keep the WebServer API (on(), arg(), send(), sendContent(),
+ * upload(), streamFile()), so routes moved over unchanged. Bodies too large
+ * to queue whole are pulled from an HttpBodySource as the socket drains
+ * (sendChunked()), so a slow reader never holds up the handler. Only POSIX
+ * socket calls are used (lwIP provides the same ones), so with Arduino
+ * String/File/millis() supplied by a host shim the same handlers run on
+ * Linux (test/host: checks and load test).
+ */
+
+#pragma once
+#include <Arduino.h>
+#include <FS.h>
+#include <functional>
+#include <vector>
+
+/** @brief Open connections, including event streams. Further clients wait in the listen backlog. */
+static constexpr int HTTP_MAX_CLIENTS = 8;
+
+/** @brief Read buffer per connection; also the longest request head. */
+static constexpr size_t HTTP_IN_BUF = 2048;
+
+/** @brief Connections without progress for this long are closed (ms); event streams excepted. */
+static constexpr uint32_t HTTP_IDLE_MS = 5000;
+
+/** @brief Sent bytes kept at the front of the output queue before it is compacted. */
+static constexpr size_t HTTP_OUT_HIGH_WATER = 4096;
+
+/** @brief Body bytes an HttpBodySource should write per fill() (one TCP segment). */
+static constexpr size_t HTTP_FILL_BYTES = 1436;
+
+/**
+ * @brief Largest request body held in RAM (JSON and form bodies, and each
+ *        non-file multipart field); longer ones get 413.
+ *
+ * Files and raw bodies for an upload handler are streamed and not limited.
+ */
+static constexpr size_t HTTP_BODY_MAX = 8192;
+
+/** @brief Event stream data that may queue for a slow client before it is dropped. */
+static constexpr size_t HTTP_STREAM_QUEUE_MAX = 2048;
+
+/** @brief Upload data per upload handler call (one TCP segment). */
+static constexpr size_t HTTP_UPLOAD_BUFLEN = 1436;
+
+static constexpr size_t CONTENT_LENGTH_UNKNOWN = (size_t)-1;
+static constexpr size_t CONTENT_LENGTH_NOT_SET = (size_t)-2;
+
+enum HTTPMethod : uint8_t { HTTP_ANY, HTTP_GET, HTTP_HEAD, HTTP_POST, HTTP_PUT, HTTP_PATCH, HTTP_DELETE, HTTP_OPTIONS };
+
+enum HTTPUploadStatus : uint8_t { UPLOAD_FILE_START, UPLOAD_FILE_WRITE, UPLOAD_FILE_END, UPLOAD_FILE_ABORTED };
+
+/** @brief One file of a multipart upload (or a raw body), handed to the upload handler in pieces. */
+struct HTTPUpload {
+  HTTPUploadStatus status;
+  String filename;
+  String name;
+  String type;
+  size_t totalSize;    /**< @brief Bytes so far. */
+  size_t currentSize;  /**< @brief Bytes in @ref buf (UPLOAD_FILE_WRITE). */
+  uint8_t buf[HTTP_UPLOAD_BUFLEN];
+};
+
+struct HttpConn;
+
+/**
+ * @brief Response body produced piece by piece for sendChunked().
+ *
+ * The server calls fill() whenever everything written so far has gone out,
+ * so only one piece is ever queued, however slow the client reads.
+ */
+class HttpBodySource {
+public:
+  virtual ~HttpBodySource() {}
+
+  /**
+   * @brief Write the next piece (about @ref HTTP_FILL_BYTES) to @p out.
+   * @return false if the body cannot be completed; the connection is then
+   *         closed, so the client sees a truncated response.
+   */
+  virtual bool fill(Print& out) = 0;
+
+  /** @brief True once the last piece was written. */
+  virtual bool done() const = 0;
+};
+
+/**
+ * @brief HTTP server on one port. All calls from one task.
+ */
+class HttpServer {
+public:
+  typedef std::function<void(void)> THandlerFunction;
+
+  explicit HttpServer(uint16_t port = 80) : _port(port) {}
+  ~HttpServer() { stop(); }
+
+  /** @brief Start listening. Call once the network is up. */
+  bool begin();
+
+  /** @brief Close all connections and the listening socket. */
+  void stop();
+
+  /** @brief One pass: accept, read, run handlers, write. Never waits for a client. */
+  void handleClient();
+
+  /** @brief Route @p uri (exact match); HTTP_ANY matches every method. */
+  void on(const String& uri, HTTPMethod method, THandlerFunction fn);
+
+  /**
+   * @brief Route whose request body goes to @p upload piece by piece, before @p fn.
+   *
+   * Multipart bodies are split into their files (other fields become args).
+   * Any other body is passed on as is, with an empty filename (WebServer's
+   * raw body). Only one such body is read at a time.
+   */
+  void on(const String& uri, HTTPMethod method, THandlerFunction fn, THandlerFunction upload);
+
+  /** @brief Handler for requests no route matches (default: 404). */
+  void onNotFound(THandlerFunction fn) { _notFound = fn; }
+
+  // ---- Request being handled ----
+
+  /** @brief Query or form argument; @c "plain" is a non-form request body. */
+  String arg(const String& name) const;
+  bool hasArg(const String& name) const;
+  String uri() const;
+  HTTPMethod method() const;
+
+  /** @brief Request header value (name case-insensitive), empty if absent. */
+  String header(const char* name) const;
+
+  /** @brief Current upload piece (inside the upload handler). */
+  HTTPUpload& upload() { return _upload; }
+
+  // ---- Response ----
+
+  void sendHeader(const String& name, const String& value, bool first = false);
+
+  /** @brief Length for the next send(); CONTENT_LENGTH_UNKNOWN starts a chunked response. */
+  void setContentLength(size_t len);
+
+  void send(int code, const char* type = nullptr, const String& body = String());
+  void send(int code, const String& type, const String& body) { send(code, type.c_str(), body); }
+
+  /** @brief Response with a body in flash; sent from there, not copied. */
+  void send_P(int code, const char* type, const char* body, size_t len);
+
+  /**
+   * @brief Body data after send() with CONTENT_LENGTH_UNKNOWN; an empty call ends it.
+   *
+   * The data is queued whole; use sendChunked() for large bodies.
+   */
+  void sendContent(const String& data) { sendContent(data.c_str(), data.length()); }
+  void sendContent(const char* data, size_t len);
+
+  /**
+   * @brief Respond with the contents of @p file.
+   *
+   * The server keeps the file open and reads it as the socket drains;
+   * the handler must not close it.
+   */
+  size_t streamFile(File& file, const String& type, int code = 200);
+
+  /**
+   * @brief Chunked response whose body is pulled from @p body as the socket drains.
+   *
+   * The server owns @p body from here on and deletes it when the response
+   * is complete or the connection closes.
+   */
+  void sendChunked(int code, const char* type, HttpBodySource* body);
+
+  // ---- Event streams ----
+
+  /**
+   * @brief Answer the current request with an open-ended stream.
+   *
+   * The response has no length and the connection stays open after the
+   * handler; data goes out through push(). Idle timeouts do not apply.
+   * @return Stream id, or -1 outside a handler or after a response.
+   */
+  int beginStream(const char* type);
+
+  /**
+   * @brief Queue @p data on stream @p id.
+   * @return false if the stream is closed, or was just dropped because the
+   *         client fell more than @ref HTTP_STREAM_QUEUE_MAX bytes behind.
+   */
+  bool push(int id, const String& data);
+
+  /** @brief True while stream @p id is open. */
+  bool streamOpen(int id) const { return stream(id) != nullptr; }
+
+private:
+  struct Route {
+    String uri;
+    HTTPMethod method;
+    THandlerFunction fn;
+    THandlerFunction upload;
+  };
+
+  void accept();
+  void close(int slot);
+  void process(HttpConn* c);
+  bool parseHead(HttpConn* c);
+  bool readBody(HttpConn* c);
+  bool multipart(HttpConn* c);
+  void uploadPiece(HttpConn* c, const char* data, size_t len);
+  void uploadEvent(HttpConn* c, HTTPUploadStatus status);
+  void dispatch(HttpConn* c);
+  void fail(HttpConn* c, int code, const char* msg);
+  void finish(HttpConn* c);
+  void writeHead(HttpConn* c, int code, const char* type, size_t len);
+  void queue(HttpConn* c, const char* data, size_t len);
+  void queueBody(HttpConn* c, const char* data, size_t len);
+  bool pump(HttpConn* c);
+  bool fill(HttpConn* c);
+  HttpConn* stream(int id) const;
+
+  uint16_t _port;
+  int _listen = -1;
+  HttpConn* _conns[HTTP_MAX_CLIENTS] = {nullptr};
+  uint16_t _gen = 0;
+
+  std::vector<Route> _routes;
+  THandlerFunction _notFound;
+
+  HttpConn* _cur = nullptr;        // connection whose handler is running
+  HttpConn* _uploading = nullptr;  // one streamed body at a time
+  HTTPUpload _upload;
+};
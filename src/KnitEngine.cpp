@@ -0,0 +1,108 @@
+/**
+ * @file KnitEngine.cpp
+ * @brief Knitting command handling.
+ */
+
+#include "KnitEngine.h"
+
+uint32_t KnitEngine::post(KnitCommand cmd, int32_t arg, uint32_t us) {
+  uint32_t ticket = _nextTicket.fetch_add(1, std::memory_order_relaxed) + 1;
+  if (ticket == 0) ticket = _nextTicket.fetch_add(1, std::memory_order_relaxed) + 1;
+  KnitRequest r{(uint8_t)cmd, arg, ticket, us ? us : (uint32_t)micros()};
+  if (!_queue.push(r)) return 0;
+
+  TaskHandle_t owner = _owner;
+  if (owner && owner != xTaskGetCurrentTaskHandle()) xTaskNotifyGive(owner);
+  return ticket;
+}
+
+bool KnitEngine::process() {
+  uint32_t before = _version;
+  KnitRequest r;
+  while (_queue.pop(r)) apply(r);
+  return _version != before;
+}
+
+void KnitEngine::apply(const KnitRequest& r) {
+  switch (r.cmd) {
+    case KNIT_STEP: step(r.arg < 0 ? -1 : +1); break;
+    case KNIT_CONFIRM: confirm(); break;
+    case KNIT_PULSE: pulse(); break;
+    default: break;
+  }
+  _ticket = r.ticket;
+  _version++;
+
+  uint32_t waited = micros() - r.us;
+  if (waited > _maxLatencyUs) _maxLatencyUs = waited;
+}
+
+int KnitEngine::wrap(int r) const {
+  if (_h <= 0) return 0;
+  while (r < 0) r += _h;
+  while (r >= _h) r -= _h;
+  return r;
+}
+
+// Map "step +1/-1" to internal row index change based on direction
+// rowFromBottom=false: +1 means go down (row index +1)
+// rowFromBottom=true:  +1 means go up in index (row index -1) because counting starts from bottom
+void KnitEngine::step(int step) {
+  setWarn(false);
+
+  int dir = _cfg.rowFromBottom ? -1 : +1;
+  _row = wrap(_row + step * dir);
+  _stepDir = step * dir;
+  _dirty |= DIRTY_LED_FRAME | DIRTY_OLED;
+}
+
+void KnitEngine::setWarn(bool on) {
+  if (on != _warn) _dirty |= DIRTY_WARN;
+  _warn = on;
+}
+
+void KnitEngine::confirm() {
+  _confirmed.set(_row);
+  _changes.words.set(_row / 32);
+  setWarn(false);
+  _dirty |= DIRTY_LED_FRAME;  // confirmed color
+
+  if (_cfg.autoAdvance) {
+    step(+1);  // wraps + respects direction
+  }
+}
+
+void KnitEngine::pulse() {
+  _pulses++;
+  _dirty |= DIRTY_OLED;
+
+  // Blink warning if carriage moved but current row not confirmed
+  bool warn = _cfg.blinkWarning && !_confirmed.get(_row);
+
+  step(+1);  // carriage acts like "UP" (next row in chosen direction)
+  setWarn(warn);
+}
+
+void KnitEngine::setHeight(int h) {
+  _h = h;
+  _confirmed.resize(h);
+  _changes.words.resize(_confirmed.words());
+  _row = wrap(_row);
+  _version++;
+  _dirty |= DIRTY_LED_FRAME | DIRTY_OLED;
+}
+
+void KnitEngine::restore(int row, uint32_t pulses) {
+  _row = wrap(row);
+  _pulses = pulses;
+  _version++;
+  _dirty |= DIRTY_LED_FRAME | DIRTY_OLED;
+}
+
+void KnitEngine::clearConfirmed() {
+  _confirmed.clearAll();
+  _changes.words.clearAll();
+  _changes.cleared = true;
+  _version++;
+  _dirty |= DIRTY_LED_FRAME;
+}
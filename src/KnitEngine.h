@@ -0,0 +1,156 @@
+/**
+ * @file KnitEngine.h
+ * @brief Knitting state machine: active row, confirmations, pulses, warning.
+ *
+ * The engine is the only code that changes knitting progress. Buttons, the
+ * carriage sensor and web handlers post commands to its queue from any task;
+ * the knitting task applies them in order in process(). Every change bumps
+ * version(), so observers (outputs, snapshot, journal) only need to compare
+ * one number.
+ */
+
+#pragma once
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include "AppConfig.h"
+#include "RowFlags.h"
+#include "MpmcQueue.h"
+
+/** @brief Commands understood by the engine. */
+enum KnitCommand : uint8_t {
+  KNIT_STEP = 1,     /**< @brief Step by @c arg (+1/-1) in the configured direction. */
+  KNIT_CONFIRM = 2,  /**< @brief Confirm the active row (auto-advance if enabled). */
+  KNIT_PULSE = 3,    /**< @brief Carriage pass: count it, warn if unconfirmed, step. */
+};
+
+/** @brief Outputs that need an update (bit mask). */
+enum OutputDirty : uint8_t {
+  DIRTY_LED_FRAME = 1 << 0,       /**< @brief Pixels of the active row (row, colors, rows). */
+  DIRTY_LED_BRIGHTNESS = 1 << 1,  /**< @brief Strip brightness. */
+  DIRTY_OLED = 1 << 2,            /**< @brief Row counter and pulse total. */
+  DIRTY_WARN = 1 << 3,            /**< @brief Blink warning switched on or off. */
+  DIRTY_LED_LAYOUT = 1 << 4,      /**< @brief Knitted rows, LED pitch or viewport (LED table). */
+  DIRTY_ALL = 0x1F,
+};
+
+struct KnitRequest {
+  uint8_t cmd;
+  int32_t arg;
+  uint32_t ticket;
+  uint32_t us;  /**< @brief micros() when the input happened (sensor edge, button, request). */
+};
+
+/** @brief Queued commands (power of two). */
+static constexpr uint32_t KNIT_QUEUE_LEN = 32;
+
+/**
+ * @brief Single-owner knitting state fed by a lock-free command queue.
+ *
+ * post() may be called from any task; everything else belongs to the
+ * knitting task. Row direction, auto-advance and blink warning are read from
+ * the @ref AppConfig passed to the constructor (the knitting task's copy).
+ */
+class KnitEngine {
+public:
+  explicit KnitEngine(const AppConfig& cfg) : _cfg(cfg) {}
+
+  KnitEngine(const KnitEngine&) = delete;
+  KnitEngine& operator=(const KnitEngine&) = delete;
+
+  // ---- any task ----
+
+  /**
+   * @brief Queue a command.
+   * @return ticket, reported by lastTicket() once handled; 0 if the queue is full.
+   */
+  uint32_t post(KnitCommand cmd, int32_t arg = 0, uint32_t us = 0);
+
+  /** @brief Task woken by post(). */
+  void setOwner(TaskHandle_t task) { _owner = task; }
+
+  // ---- knitting task ----
+
+  /** @brief Apply all queued commands. @return true if the state changed. */
+  bool process();
+
+  /** @brief Knitted height changed: keep confirmations and the row in range. */
+  void setHeight(int h);
+
+  /** @brief Start from restored progress (boot). */
+  void restore(int row, uint32_t pulses);
+
+  void clearConfirmed();
+
+  int activeRow() const { return _row; }
+  uint32_t totalPulses() const { return _pulses; }
+  bool warn() const { return _warn; }
+  int height() const { return _h; }
+  const RowFlags& confirmed() const { return _confirmed; }
+  RowFlags& confirmed() { return _confirmed; }
+
+  /** @brief Confirmation changes since the journal last took them. */
+  struct ConfirmChanges {
+    RowFlags words;        /**< @brief Flag @c i: confirmed().word(i) changed. */
+    bool cleared = false;  /**< @brief clearConfirmed() ran (earlier word flags dropped). */
+  };
+
+  /** @brief Pending confirmation changes; the taker clears what it has recorded. */
+  ConfirmChanges& confirmChanges() { return _changes; }
+  bool activeConfirmed() const { return _confirmed.get(_row); }
+
+  /** @brief Row a pulse or Up would move to. */
+  int nextRow() const { return wrap(_row + (_cfg.rowFromBottom ? -1 : +1)); }
+
+  /** @brief Row number as shown to the user (1-based, follows rowFromBottom). */
+  int shownRow() const { return _cfg.rowFromBottom ? (_h - _row) : (_row + 1); }
+
+  /** @brief Incremented on every state change. */
+  uint32_t version() const { return _version; }
+
+  /** @brief Ticket of the last handled command. */
+  uint32_t lastTicket() const { return _ticket; }
+
+  /** @brief Outputs changed since the last call (@ref OutputDirty), cleared by the call. */
+  uint8_t takeDirty() {
+    uint8_t d = _dirty;
+    _dirty = 0;
+    return d;
+  }
+
+  /** @brief Longest time between an input and its handling (us). */
+  uint32_t maxLatencyUs() const { return _maxLatencyUs; }
+
+  /** @brief Direction of the last step (+1/-1, 0 if none), cleared by the call. */
+  int takeStepDir() {
+    int d = _stepDir;
+    _stepDir = 0;
+    return d;
+  }
+
+private:
+  void apply(const KnitRequest& r);
+  void step(int step);
+  void setWarn(bool on);
+  void confirm();
+  void pulse();
+  int wrap(int r) const;
+
+  const AppConfig& _cfg;
+  MpmcQueue<KnitRequest, KNIT_QUEUE_LEN> _queue;
+  std::atomic<uint32_t> _nextTicket{0};
+  TaskHandle_t volatile _owner = nullptr;
+
+  int _row = 0;
+  int _h = 0;
+  uint32_t _pulses = 0;
+  bool _warn = false;
+  RowFlags _confirmed;
+  ConfirmChanges _changes;
+
+  uint32_t _version = 0;
+  uint8_t _dirty = 0;
+  uint32_t _ticket = 0;
+  uint32_t _maxLatencyUs = 0;
+  int _stepDir = 0;
+};
@@ -0,0 +1,93 @@
+/**
+ * @file KnitLink.cpp
+ * @brief Knitting task <-> web task channels.
+ */
+
+#include "KnitLink.h"
+
+void KnitSettings::from(const AppConfig& c) {
+  colorActive = c.colorActive;
+  colorConfirmed = c.colorConfirmed;
+  brightness = c.brightness;
+  colorCorrection = c.colorCorrection;
+  rowFromBottom = c.rowFromBottom;
+  autoAdvance = c.autoAdvance;
+  blinkWarning = c.blinkWarning;
+  mirrorH = c.mirrorH;
+  mirrorV = c.mirrorV;
+  invert = c.invert;
+  tileX = c.tileX;
+  tileY = c.tileY;
+  needleOffset = c.needleOffset;
+  needlePitch = c.needlePitch;
+  ledPitch = c.ledPitch;
+  viewCenter = c.viewCenter;
+}
+
+void KnitSettings::applyTo(AppConfig& c) const {
+  c.colorActive = colorActive;
+  c.colorConfirmed = colorConfirmed;
+  c.brightness = brightness;
+  c.colorCorrection = colorCorrection;
+  c.rowFromBottom = rowFromBottom;
+  c.autoAdvance = autoAdvance;
+  c.blinkWarning = blinkWarning;
+  c.mirrorH = mirrorH;
+  c.mirrorV = mirrorV;
+  c.invert = invert;
+  c.tileX = tileX;
+  c.tileY = tileY;
+  c.needleOffset = needleOffset;
+  c.needlePitch = needlePitch;
+  c.ledPitch = ledPitch;
+  c.viewCenter = viewCenter;
+}
+
+bool KnitLink::begin() {
+  _lock = xSemaphoreCreateMutex();
+  _settingsSeen = _settings.version();  // never apply the empty initial value
+  return _lock != nullptr;
+}
+
+void KnitLink::publishSettings(const AppConfig& cfg) {
+  KnitSettings s;
+  s.from(cfg);
+  _settings.store(s);
+  if (_knitTask) xTaskNotifyGive(_knitTask);
+}
+
+bool KnitLink::takeSettings(AppConfig& cfg) {
+  uint32_t version;
+  if (_settings.version() == _settingsSeen) return false;
+  KnitSettings s = _settings.load(&version);
+  s.applyTo(cfg);
+  _settingsSeen = version;
+  return true;
+}
+
+void KnitLink::lockPattern() {
+  xSemaphoreTake(_lock, portMAX_DELAY);
+}
+
+// Wakes the knitting task if a pattern change is waiting for it.
+void KnitLink::unlockPattern() {
+  bool wake = (_gen != _genSeen);
+  xSemaphoreGive(_lock);
+  if (wake && _knitTask) xTaskNotifyGive(_knitTask);
+}
+
+uint32_t KnitLink::patternChanged(const String& file, bool clearConfirmed) {
+  _file = file;
+  _clear = _clear || clearConfirmed;
+  return ++_gen;
+}
+
+bool KnitLink::takePatternChange(String& file, bool& clearConfirmed, uint32_t& gen) {
+  if (_gen == _genSeen) return false;
+  file = _file;
+  clearConfirmed = _clear;
+  gen = _gen;
+  _clear = false;
+  _genSeen = _gen;
+  return true;
+}
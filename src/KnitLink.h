@@ -0,0 +1,140 @@
+/**
+ * @file KnitLink.h
+ * @brief State exchange between the knitting task and the web task.
+ *
+ * The knitting task (inputs, row state, LEDs) and the web task (HttpServer,
+ * file and flash work) run on different cores and never share mutable
+ * structs directly:
+ *
+ * - knitting -> web: a @ref KnitSnapshot published through a Seqlock after
+ *   every pass; handlers read a consistent copy without blocking anyone.
+ * - web -> knitting: @ref KnitSettings through a second Seqlock and pattern
+ *   changes under the pattern lock (row commands go to the KnitEngine queue).
+ *   The knitting task only ever try-locks, so a slow request can delay an
+ *   LED update but never a carriage pulse.
+ */
+
+#pragma once
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+#include "AppConfig.h"
+#include "Seqlock.h"
+
+/** @brief Knitting state as seen by the web task. */
+struct KnitSnapshot {
+  int32_t activeRow = 0;
+  int32_t patternRow = 0;     /**< @brief Stored pattern row shown at @c activeRow. */
+  uint32_t totalPulses = 0;
+  int32_t w = 0;              /**< @brief Knitted width (after view transforms). */
+  int32_t h = 0;              /**< @brief Knitted height (after view transforms). */
+  int32_t baseH = 0;          /**< @brief Height of the stored pattern (before tiling). */
+  bool warn = false;
+  uint32_t version = 0;       /**< @brief KnitEngine::version() of this state. */
+  uint32_t ticket = 0;        /**< @brief Last row command handled. */
+  uint32_t patternGen = 0;    /**< @brief Last pattern change applied. */
+  uint32_t maxCommandUs = 0;  /**< @brief KnitEngine::maxLatencyUs(). */
+
+  /** @brief True once KnitEngine command @p t was handled. */
+  bool hasTicket(uint32_t t) const { return (int32_t)(ticket - t) >= 0; }
+
+  /** @brief True once pattern change @p gen was applied. */
+  bool hasPattern(uint32_t gen) const { return (int32_t)(patternGen - gen) >= 0; }
+};
+
+/** @brief The AppConfig fields the knitting task uses (plain data, for the Seqlock). */
+struct KnitSettings {
+  uint32_t colorActive = 0;
+  uint32_t colorConfirmed = 0;
+  uint8_t brightness = 0;
+  uint32_t colorCorrection = 0;
+  bool rowFromBottom = false;
+  bool autoAdvance = false;
+  bool blinkWarning = false;
+  bool mirrorH = false;
+  bool mirrorV = false;
+  bool invert = false;
+  uint8_t tileX = 1;
+  uint8_t tileY = 1;
+  int16_t needleOffset = 0;
+  uint16_t needlePitch = 0;
+  uint16_t ledPitch = 0;
+  int16_t viewCenter = 0;
+
+  void from(const AppConfig& c);
+  void applyTo(AppConfig& c) const;
+};
+
+/**
+ * @brief Longest a response is held back for the knitting task to pick up a change (ms).
+ *
+ * The handler does not wait: its HttpBodySource checks the snapshot on each
+ * server pass and answers from whatever state it has after this long.
+ */
+static constexpr uint32_t KNIT_WAIT_MS = 200;
+
+/**
+ * @brief Channels between the knitting task and the web task.
+ */
+class KnitLink {
+public:
+  /** @brief Create the lock; call once before the tasks start. */
+  bool begin();
+
+  /** @brief Task to wake when settings or the pattern change. */
+  void setKnitTask(TaskHandle_t t) { _knitTask = t; }
+
+  // ---- web task ----
+
+  /** @brief Publish changed settings. */
+  void publishSettings(const AppConfig& cfg);
+
+  /** @brief Take the pattern lock (blocks); required to modify the knitted pattern or its file. */
+  void lockPattern();
+  void unlockPattern();
+
+  /**
+   * @brief Tell the knitting task to re-select its rows from @p file.
+   *
+   * Call with the pattern lock held, after the pattern or file was changed.
+   * @return the change number, see KnitSnapshot::hasPattern().
+   */
+  uint32_t patternChanged(const String& file, bool clearConfirmed);
+
+  /** @brief Number of the last patternChanged() call; web task only. */
+  uint32_t lastPatternChange() const { return _gen; }
+
+  /** @brief Latest knitting state. */
+  KnitSnapshot state() const { return _state.load(); }
+
+  // ---- knitting task ----
+
+  /** @brief Apply new settings to @p cfg. @return true if there were any. */
+  bool takeSettings(AppConfig& cfg);
+
+  /** @brief Try the pattern lock without waiting. */
+  bool tryLockPattern() { return xSemaphoreTake(_lock, 0) == pdTRUE; }
+
+  /**
+   * @brief Pending pattern change (call with the pattern lock held).
+   * @return true once per change, with the file and whether to clear confirmations.
+   */
+  bool takePatternChange(String& file, bool& clearConfirmed, uint32_t& gen);
+
+  void publish(const KnitSnapshot& s) { _state.store(s); }
+
+private:
+  SemaphoreHandle_t _lock = nullptr;
+  TaskHandle_t _knitTask = nullptr;
+
+  Seqlock<KnitSnapshot> _state;
+  Seqlock<KnitSettings> _settings;
+  uint32_t _settingsSeen = 0;
+
+  // Guarded by the pattern lock
+  String _file;
+  bool _clear = false;
+  uint32_t _gen = 0;
+  uint32_t _genSeen = 0;
+};
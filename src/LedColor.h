@@ -0,0 +1,62 @@
+/**
+ * @file LedColor.h
+ * @brief Color pipeline from configured colors to strip bytes.
+ *
+ * Colors in the config are perceptual (as picked in the web UI), LEDs are
+ * linear. Each channel goes through a gamma table generated at compile time,
+ * with 16-bit entries so low brightness keeps its steps, and then the
+ * per-channel correction and the brightness are applied in one rounding
+ * step. Frames are always built from the configured colors, so a brightness
+ * change never compounds rounding the way rescaling the strip buffer did.
+ */
+
+#pragma once
+#include <Arduino.h>
+
+namespace ledlut {
+
+template <int... I> struct Seq {};
+template <int N, int... I> struct MakeSeq : MakeSeq<N - 1, N - 1, I...> {};
+template <int... I> struct MakeSeq<0, I...> { typedef Seq<I...> type; };
+
+// x^2.2 = x^2 * x^(1/5); the fifth root by Newton's method from 1 (0 < x <= 1).
+constexpr double root5(double x, double y, int n) {
+  return n == 0 ? y : root5(x, (4 * y + x / (y * y * y * y)) / 5, n - 1);
+}
+constexpr double pow22(double x) { return x <= 0 ? 0 : x * x * root5(x, 1.0, 40); }
+constexpr uint16_t gamma16(int i) { return (uint16_t)(pow22(i / 255.0) * 65535.0 + 0.5); }
+
+template <class S> struct GammaTable;
+template <int... I> struct GammaTable<Seq<I...>> {
+  static constexpr uint16_t v[sizeof...(I)] = {gamma16(I)...};
+};
+template <int... I> constexpr uint16_t GammaTable<Seq<I...>>::v[sizeof...(I)];
+
+}  // namespace ledlut
+
+/** @brief Gamma 2.2, 8-bit in, 16-bit linear out (built by the compiler, lives in flash). */
+typedef ledlut::GammaTable<ledlut::MakeSeq<256>::type> LedGamma;
+
+static_assert(LedGamma::v[0] == 0 && LedGamma::v[255] == 65535, "gamma table ends");
+
+/**
+ * @brief One output channel: gamma, then @p correction and @p brightness (both 255 = full).
+ */
+inline uint8_t ledChannel(uint8_t c, uint8_t correction, uint8_t brightness) {
+  // 65535 * 255 * 255 plus half the divisor still fits in 32 bits.
+  uint32_t v = (uint32_t)LedGamma::v[c] * correction * brightness;
+  return (uint8_t)((v + 65535u * 255u / 2) / (65535u * 255u));
+}
+
+/**
+ * @brief Strip value for config color @p rgb (0xRRGGBB, white in the top byte for RGBW).
+ *
+ * @p correction is 0xRRGGBB per-channel scaling for LEDs whose primaries are
+ * not balanced (0xFFFFFF = none). Returns the same 0xWWRRGGBB layout.
+ */
+inline uint32_t ledPixel(uint32_t rgb, uint8_t brightness, uint32_t correction) {
+  return ((uint32_t)ledChannel((uint8_t)(rgb >> 24), 255, brightness) << 24) |
+         ((uint32_t)ledChannel((uint8_t)(rgb >> 16), (uint8_t)(correction >> 16), brightness) << 16) |
+         ((uint32_t)ledChannel((uint8_t)(rgb >> 8), (uint8_t)(correction >> 8), brightness) << 8) |
+         (uint32_t)ledChannel((uint8_t)rgb, (uint8_t)correction, brightness);
+}
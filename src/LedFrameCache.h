@@ -0,0 +1,127 @@
+/**
+ * @file LedFrameCache.h
+ * @brief Pre-rendered NeoPixel frames for pattern rows.
+ *
+ * A frame is the strip's raw pixel buffer (channel order, gamma and
+ * brightness already applied), so showing a cached row is one memcpy into the driver.
+ * Two slots are kept: the frame on the strip and the one expected next, which
+ * the knitting task renders right after a show so the following step or
+ * pulse finds it ready.
+ */
+
+#pragma once
+#include <Arduino.h>
+#include <Adafruit_NeoPixel.h>
+#include <vector>
+#include "RowSource.h"
+#include "LedLayout.h"
+
+/**
+ * @brief Two-slot cache of rendered row frames.
+ *
+ * A slot is keyed by row and final pixel value; confirmation, colors,
+ * brightness and correction only change that value, so they simply miss. Anything else that changes the
+ * pixels (pattern, view transforms, width, LED map) must call invalidate().
+ */
+class LedFrameCache {
+public:
+  /**
+   * @brief Frame layout: the pixels of @p map, NeoPixel @p type (RGB or RGBW).
+   *
+   * Frames read the map's column table when rendered; call invalidate()
+   * after rebuilding it.
+   */
+  void begin(const LedMap& map, neoPixelType type) {
+    _map = &map;
+    uint16_t leds = (uint16_t)map.pixels();
+    _wOff = (type >> 6) & 3;
+    _rOff = (type >> 4) & 3;
+    _gOff = (type >> 2) & 3;
+    _bOff = type & 3;
+    _bpp = (_wOff == _rOff) ? 3 : 4;
+    _leds = leds;
+    for (Slot& s : _slots) {
+      s.bytes.assign((size_t)leds * _bpp, 0);
+      s.valid = false;
+    }
+  }
+
+  /** @brief Bytes per frame. */
+  size_t bytes() const { return (size_t)_leds * _bpp; }
+
+  uint8_t bytesPerPixel() const { return _bpp; }
+
+  /** @brief Drop all frames (rows or their layout changed). */
+  void invalidate() {
+    for (Slot& s : _slots) s.valid = false;
+  }
+
+  /**
+   * @brief Frame for @p row lit with @p pixel, rendered now only if it is not cached.
+   *
+   * @p pixel is the final 0xWWRRGGBB strip value (see ledPixel()).
+   */
+  const uint8_t* frame(RowSource& p, int row, uint32_t pixel) {
+    int i = find(row, pixel);
+    if (i < 0) {
+      i = 1 - _shown;
+      render(_slots[i], p, row, pixel);
+    }
+    _shown = i;
+    return _slots[i].bytes.data();
+  }
+
+  /** @brief Render @p row into the slot not on the strip, unless already cached. */
+  void prepare(RowSource& p, int row, uint32_t pixel) {
+    if (find(row, pixel) >= 0) return;
+    render(_slots[1 - _shown], p, row, pixel);
+  }
+
+private:
+  struct Slot {
+    std::vector<uint8_t> bytes;
+    bool valid = false;
+    int row = 0;
+    uint32_t pixel = 0;
+  };
+
+  int find(int row, uint32_t pixel) const {
+    for (int i = 0; i < 2; i++) {
+      const Slot& s = _slots[i];
+      if (s.valid && s.row == row && s.pixel == pixel) return i;
+    }
+    return -1;
+  }
+
+  // One pass over the LED -> column table; the layout (segments, pitch,
+  // viewport, LED0 = needle #1 end) is already folded into it.
+  void render(Slot& s, RowSource& p, int row, uint32_t pixel) {
+    uint8_t px[4] = {0, 0, 0, 0};
+    px[_rOff] = (uint8_t)(pixel >> 16);
+    px[_gOff] = (uint8_t)(pixel >> 8);
+    px[_bOff] = (uint8_t)pixel;
+    if (_bpp == 4) px[_wOff] = (uint8_t)(pixel >> 24);
+
+    std::fill(s.bytes.begin(), s.bytes.end(), 0);
+    const int w = p.width();  // guards against a table built for another width
+    const uint32_t* words = p.row(row);
+    const int16_t* cols = _map->cols();
+    uint8_t* out = s.bytes.data();
+    for (int i = 0; i < _leds; i++, out += _bpp) {
+      int c = cols[i];
+      if (c < 0 || c >= w) continue;
+      if ((words[c / PATTERN_WORD_BITS] >> (c % PATTERN_WORD_BITS)) & 1u) memcpy(out, px, _bpp);
+    }
+
+    s.valid = true;
+    s.row = row;
+    s.pixel = pixel;
+  }
+
+  const LedMap* _map = nullptr;
+  Slot _slots[2];
+  int _shown = 0;
+  int _leds = 0;
+  uint8_t _bpp = 3;
+  uint8_t _rOff = 1, _gOff = 0, _bOff = 2, _wOff = 1;
+};
@@ -0,0 +1,111 @@
+/**
+ * @file LedLayout.cpp
+ * @brief Segment list parsing and LED -> needle table construction.
+ */
+
+#include "LedLayout.h"
+
+bool parseLedSegments(const String& spec, LedSegment* out, int& n) {
+  n = 0;
+  int total = 0;
+  uint8_t pins[LED_MAX_OUTPUTS];
+  int nPins = 0;
+
+  int start = 0;
+  while (start <= (int)spec.length()) {
+    int end = spec.indexOf(',', start);
+    if (end < 0) end = spec.length();
+    String part = spec.substring(start, end);
+    part.trim();
+    start = end + 1;
+
+    int colon = part.indexOf(':');
+    if (colon <= 0 || n >= LED_MAX_SEGMENTS) return false;
+
+    LedSegment s;
+    if (part.endsWith("r") || part.endsWith("R")) {
+      s.reversed = true;
+      part.remove(part.length() - 1);
+    }
+    String pinStr = part.substring(0, colon);
+    String countStr = part.substring(colon + 1);
+    for (unsigned i = 0; i < pinStr.length(); i++) if (!isdigit(pinStr[i])) return false;
+    for (unsigned i = 0; i < countStr.length(); i++) if (!isdigit(countStr[i])) return false;
+    if (pinStr.isEmpty() || countStr.isEmpty()) return false;
+
+    long pin = pinStr.toInt();
+    long count = countStr.toInt();
+    if (pin > 39 || count < 1 || total + count > LED_MAX_PIXELS) return false;
+    s.pin = (uint8_t)pin;
+    s.count = (uint16_t)count;
+    total += count;
+
+    bool known = false;
+    for (int i = 0; i < nPins; i++) known = known || pins[i] == s.pin;
+    if (!known) {
+      if (nPins >= LED_MAX_OUTPUTS) return false;
+      pins[nPins++] = s.pin;
+    }
+
+    out[n++] = s;
+    if (end >= (int)spec.length()) break;
+  }
+  return n > 0;
+}
+
+bool LedMap::setSegments(const LedSegment* seg, int n) {
+  _pos.clear();
+  _outputs = 0;
+  if (n <= 0) {
+    _col.clear();
+    return false;
+  }
+
+  // Position of each segment's first LED along the bed
+  int base[LED_MAX_SEGMENTS];
+  int at = 0;
+  for (int i = 0; i < n; i++) {
+    base[i] = at;
+    at += seg[i].count;
+  }
+
+  // Frame order: per pin in first-appearance order, segments in list order
+  for (int i = 0; i < n; i++) {
+    bool seen = false;
+    for (int o = 0; o < _outputs; o++) seen = seen || _out[o].pin == seg[i].pin;
+    if (seen) continue;
+
+    LedOutputRange& r = _out[_outputs++];
+    r.pin = seg[i].pin;
+    r.first = (uint16_t)_pos.size();
+    for (int j = i; j < n; j++) {
+      if (seg[j].pin != r.pin) continue;
+      for (int k = 0; k < seg[j].count; k++) {
+        int p = seg[j].reversed ? (seg[j].count - 1 - k) : k;
+        _pos.push_back((uint16_t)(base[j] + p));
+      }
+    }
+    r.count = (uint16_t)(_pos.size() - r.first);
+  }
+
+  _col.assign(_pos.size(), -1);
+  return true;
+}
+
+void LedMap::build(int width, uint16_t needlePitch, uint16_t ledPitch, int16_t viewCenter) {
+  if (needlePitch == 0) needlePitch = 1;
+  if (ledPitch == 0) ledPitch = 1;
+
+  // Needle (0 = #1) shown by the LED nearest needle #1
+  int first = 0;
+  if (viewCenter > 0) {
+    int span = (int)((uint32_t)_pos.size() * ledPitch / needlePitch);
+    first = (viewCenter - 1) - span / 2;
+  }
+
+  for (size_t i = 0; i < _pos.size(); i++) {
+    int needle = first + (int)(((uint32_t)_pos[i] * ledPitch + needlePitch / 2) / needlePitch);
+    int c = (width - 1) - needle;
+    _col[i] = (needle >= 0 && c >= 0) ? (int16_t)c : (int16_t)-1;
+  }
+}
@@ -0,0 +1,81 @@
+/**
+ * @file LedLayout.h
+ * @brief Strip segments and the lookup table from LEDs to needles.
+ *
+ * The strip along the bed may be made of several segments, on one data pin
+ * (chained) or on separate pins (sent in parallel), each wired from either
+ * end. LED spacing need not match the needle pitch, and on a bed wider than
+ * the strip a viewport picks the needles it shows. All of that is folded
+ * into one table, built when the layout or the knitted width changes, that
+ * gives the pattern column for every pixel of the frame; rendering is a
+ * single walk over it.
+ */
+
+#pragma once
+#include <Arduino.h>
+#include <vector>
+
+/** @brief Most segments in a layout. */
+static constexpr int LED_MAX_SEGMENTS = 8;
+
+/** @brief Most data pins (one LedOutput each). */
+static constexpr int LED_MAX_OUTPUTS = 4;
+
+/** @brief Most LEDs over all segments. */
+static constexpr int LED_MAX_PIXELS = 1024;
+
+/** @brief One physical strip piece, in order along the bed starting at needle #1. */
+struct LedSegment {
+  uint8_t pin = 0;
+  uint16_t count = 0;
+  bool reversed = false;  /**< @brief Data enters at the end away from needle #1. */
+};
+
+/**
+ * @brief Parse a segment list like @c "25:100,26:100r" (pin:count, @c r = reversed).
+ * @return false on a syntax error or if a limit above is exceeded.
+ */
+bool parseLedSegments(const String& spec, LedSegment* out, int& n);
+
+/** @brief Pixels of the frame that go to one data pin. */
+struct LedOutputRange {
+  uint8_t pin = 0;
+  uint16_t first = 0;  /**< @brief First pixel in the frame. */
+  uint16_t count = 0;
+};
+
+/**
+ * @brief Frame layout for a set of segments plus the pixel -> column table.
+ *
+ * Frame pixels are grouped by pin (first appearance order), each group in
+ * data order, so every output sends one contiguous slice.
+ */
+class LedMap {
+public:
+  /** @brief Set the segments (boot). @return false if there are none. */
+  bool setSegments(const LedSegment* seg, int n);
+
+  /**
+   * @brief Rebuild the column table.
+   *
+   * @param width        knitted width (columns; needle #1 is column @p width - 1)
+   * @param needlePitch  needle spacing (0.01 mm)
+   * @param ledPitch     LED spacing (0.01 mm)
+   * @param viewCenter   needle (1-based) under the middle of the strip; 0 = strip starts at needle #1
+   */
+  void build(int width, uint16_t needlePitch, uint16_t ledPitch, int16_t viewCenter);
+
+  int pixels() const { return (int)_col.size(); }
+
+  /** @brief Pattern column per frame pixel, -1 if the pixel stays dark. */
+  const int16_t* cols() const { return _col.data(); }
+
+  int outputs() const { return _outputs; }
+  const LedOutputRange& output(int i) const { return _out[i]; }
+
+private:
+  std::vector<uint16_t> _pos;  // distance from the needle #1 end, in LEDs
+  std::vector<int16_t> _col;
+  LedOutputRange _out[LED_MAX_OUTPUTS];
+  int _outputs = 0;
+};
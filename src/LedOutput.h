@@ -0,0 +1,123 @@
+/**
+ * @file LedOutput.h
+ * @brief Transports that put a raw pixel frame on the LED strip.
+ *
+ * @ref LedView renders frames; an output only moves bytes. show() returns as
+ * soon as the frame is handed over, and the caller can follow completion
+ * through a fence (sent()) or a callback (onSent()). Implementations:
+ * @ref RmtLedOutput (background transfer through the RMT peripheral),
+ * @ref NeoPixelOutput (Adafruit library, blocking) and
+ * @ref RecordingLedOutput (keeps frames in memory, for host builds).
+ */
+
+#pragma once
+#include <Arduino.h>
+#include <Adafruit_NeoPixel.h>
+#include <atomic>
+#include <vector>
+
+/**
+ * @brief Raw frame transport for a strip.
+ */
+class LedOutput {
+public:
+  /** @brief Completion callback; may run in interrupt context. */
+  typedef void (*SentFn)(void* arg, uint32_t fence);
+
+  virtual ~LedOutput() {}
+
+  /** @brief Set up the hardware. @return false if it is not available. */
+  virtual bool begin() = 0;
+
+  /**
+   * @brief Send @p len bytes of pixel data (strip byte order).
+   *
+   * Returns once the frame is handed over; @p frame may be reused right away.
+   * @return fence of this frame, for sent().
+   */
+  virtual uint32_t show(const uint8_t* frame, size_t len) = 0;
+
+  /** @brief True once frame @p fence (and every frame before it) is on the strip. */
+  bool sent(uint32_t fence) const {
+    return (int32_t)(_sent.load(std::memory_order_acquire) - fence) >= 0;
+  }
+
+  /** @brief Call @p fn after each frame went out. Set before the first show(). */
+  void onSent(SentFn fn, void* arg) {
+    _sentFn = fn;
+    _sentArg = arg;
+  }
+
+protected:
+  uint32_t nextFence() { return ++_queued; }
+
+  // Called by the implementation (possibly from its ISR) when @p fence is out.
+  void IRAM_ATTR complete(uint32_t fence) {
+    _sent.store(fence, std::memory_order_release);
+    if (_sentFn) _sentFn(_sentArg, fence);
+  }
+
+private:
+  uint32_t _queued = 0;
+  std::atomic<uint32_t> _sent{0};
+  SentFn _sentFn = nullptr;
+  void* _sentArg = nullptr;
+};
+
+/**
+ * @brief Adafruit_NeoPixel transport: show() bit-bangs the frame and returns when done.
+ *
+ * Kept as the fallback when the RMT driver cannot be installed.
+ */
+class NeoPixelOutput : public LedOutput {
+public:
+  NeoPixelOutput(uint16_t ledCount, int pin, neoPixelType type)
+    : _strip(ledCount, pin, type) {}
+
+  bool begin() override {
+    _strip.begin();
+    return true;
+  }
+
+  uint32_t show(const uint8_t* frame, size_t len) override {
+    memcpy(_strip.getPixels(), frame, len);
+    _strip.show();
+    uint32_t fence = nextFence();
+    complete(fence);
+    return fence;
+  }
+
+private:
+  Adafruit_NeoPixel _strip;
+};
+
+/**
+ * @brief Keeps every frame in memory instead of driving hardware.
+ *
+ * With @c deferred set, frames stay pending until finish(), like an
+ * asynchronous transfer still in flight.
+ */
+class RecordingLedOutput : public LedOutput {
+public:
+  bool begin() override { return true; }
+
+  uint32_t show(const uint8_t* frame, size_t len) override {
+    frames.emplace_back(frame, frame + len);
+    uint32_t fence = nextFence();
+    if (deferred) _pending = fence;
+    else complete(fence);
+    return fence;
+  }
+
+  /** @brief Complete all pending frames (deferred mode). */
+  void finish() {
+    if (_pending) complete(_pending);
+    _pending = 0;
+  }
+
+  std::vector<std::vector<uint8_t>> frames;
+  bool deferred = false;
+
+private:
+  uint32_t _pending = 0;
+};
@@ -2,62 +2,88 @@
  * @file LedView.h
  * @brief NeoPixel row renderer for the current knitting row.
  *
- * Maps pattern columns to LEDs so that LED0 is the rightmost needle (#1).
- * Only pixels set to 1 are illuminated.
+ * Maps pattern columns to LEDs through the layout table (by default LED0
+ * is the rightmost needle, #1). Only pixels set to 1 are illuminated.
  */
 
 #pragma once
 #include <Arduino.h>
-#include <Adafruit_NeoPixel.h>
-#include "Pattern.h"
+#include <vector>
+#include "RowSource.h"
+#include "LedLayout.h"
+#include "LedFrameCache.h"
+#include "LedColor.h"
+#include "LedOutput.h"
 #include "AppConfig.h"
 
 /**
  * @brief NeoPixel strip renderer for a single pattern row.
+ *
+ * Rows go through a @ref LedFrameCache: frames carry gamma, color
+ * correction, brightness and the strip byte order, so a cached row goes out as-is, one
+ * slice per data pin (@ref LedMap). Outputs return from show() immediately,
+ * so segments on separate pins are sent in parallel.
  */
 class LedView {
 public:
-  LedView(uint16_t ledCount, int pin, neoPixelType type)
-    : _strip(ledCount, pin, type) {}
-
-  void begin(uint8_t brightness) {
-    _strip.begin();
-    _strip.setBrightness(brightness);
-    _strip.clear();
-    _strip.show();
-  }
+  explicit LedView(neoPixelType type) : _type(type) {}
+
+  /** @brief Strip segments (boot, before begin()). @return false if there are none. */
+  bool setSegments(const LedSegment* seg, int n) { return _map.setSegments(seg, n); }
+
+  /** @brief Data pins of the layout; begin() takes one output per entry. */
+  int outputs() const { return _map.outputs(); }
+  const LedOutputRange& output(int i) const { return _map.output(i); }
 
-  void setBrightness(uint8_t b) {
-    _strip.setBrightness(b);
-    _strip.show();
+  void begin(LedOutput* const* outs, uint8_t brightness) {
+    for (int i = 0; i < _map.outputs(); i++) _outs[i] = outs[i];
+    _frames.begin(_map, _type);
+    _blank.assign(_frames.bytes(), 0);
+    _brightness = brightness;
+    send(_blank.data());
   }
 
-  // LED0 is RIGHTMOST = needle #1.
-  // Internal col 0 is LEFT, so mapping: col->led = (w-1-col)
-  void showRow(const Pattern& p, int row, bool confirmed, const AppConfig& cfg) {
-    _strip.clear();
+  // Takes effect with the next showRow(); setting it alone does not push the strip.
+  void setBrightness(uint8_t b) { _brightness = b; }
 
-    int w = p.w;
-    int leds = _strip.numPixels();
-    int use = min(w, leds);
-    uint32_t col = confirmed ? cfg.colorConfirmed : cfg.colorActive;
+  /** @brief Rows, width, pitch or viewport changed: rebuild the LED table, drop cached frames. */
+  void setView(int width, const AppConfig& cfg) {
+    _map.build(width, cfg.needlePitch, cfg.ledPitch, cfg.viewCenter);
+    _frames.invalidate();
+  }
 
-    for (int c = 0; c < use; c++) {
-      if (!p.px[row][c]) continue;
-      int li = (w - 1) - c;
-      if (li >= 0 && li < leds) _strip.setPixelColor(li, col);
-    }
-    _strip.show();
+  void showRow(RowSource& p, int row, bool confirmed, const AppConfig& cfg) {
+    send(_frames.frame(p, row, rowPixel(confirmed, cfg)));
   }
 
-  void blinkRow(const Pattern& p, int row, bool confirmed, const AppConfig& cfg, bool on) {
+  void blinkRow(RowSource& p, int row, bool confirmed, const AppConfig& cfg, bool on) {
     if (on) showRow(p, row, confirmed, cfg);
-    else {
-      _strip.clear();
-      _strip.show();
-    }
+    else send(_blank.data());
+  }
+
+  /** @brief Render @p row ahead of time so the next showRow() of it is a copy. */
+  void prepareRow(RowSource& p, int row, bool confirmed, const AppConfig& cfg) {
+    _frames.prepare(p, row, rowPixel(confirmed, cfg));
   }
 
 private:
-  Adafruit_NeoPixel _strip;
+  // Recomputed from the configured colors every time: nothing is rescaled in place.
+  uint32_t rowPixel(bool confirmed, const AppConfig& cfg) const {
+    return ledPixel(confirmed ? cfg.colorConfirmed : cfg.colorActive, _brightness, cfg.colorCorrection);
+  }
+
+  void send(const uint8_t* frame) {
+    const size_t bpp = _frames.bytesPerPixel();
+    for (int i = 0; i < _map.outputs(); i++) {
+      const LedOutputRange& r = _map.output(i);
+      _outs[i]->show(frame + r.first * bpp, r.count * bpp);
+    }
+  }
+
+  neoPixelType _type;
+  LedMap _map;
+  LedOutput* _outs[LED_MAX_OUTPUTS] = {};
+  LedFrameCache _frames;
+  std::vector<uint8_t> _blank;
+  uint8_t _brightness = 255;
 };
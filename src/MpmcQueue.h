@@ -0,0 +1,79 @@
+/**
+ * @file MpmcQueue.h
+ * @brief Bounded lock-free multi-producer / multi-consumer queue.
+ *
+ * Dmitry Vyukov's array queue: every cell carries a sequence number that
+ * tells producers and consumers whose turn it is, so a push or pop costs one
+ * compare-and-swap on the shared position and never waits on another task.
+ * A full queue rejects the push instead of blocking.
+ */
+
+#pragma once
+#include <Arduino.h>
+#include <atomic>
+
+/**
+ * @brief Queue of up to @p N items (@p N a power of two).
+ */
+template <class T, uint32_t N>
+class MpmcQueue {
+  static_assert(N >= 2 && (N & (N - 1)) == 0, "MpmcQueue size must be a power of two");
+
+public:
+  MpmcQueue() {
+    for (uint32_t i = 0; i < N; i++) _cells[i].seq.store(i, std::memory_order_relaxed);
+  }
+
+  MpmcQueue(const MpmcQueue&) = delete;
+  MpmcQueue& operator=(const MpmcQueue&) = delete;
+
+  /** @brief Any task. @return false (item dropped) if the queue is full. */
+  bool push(const T& v) {
+    uint32_t pos = _enqueue.load(std::memory_order_relaxed);
+    for (;;) {
+      Cell& c = _cells[pos & (N - 1)];
+      int32_t dif = (int32_t)(c.seq.load(std::memory_order_acquire) - pos);
+      if (dif == 0) {
+        if (_enqueue.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+          c.data = v;
+          c.seq.store(pos + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (dif < 0) {
+        return false;  // a lap behind: full
+      } else {
+        pos = _enqueue.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  /** @brief Any task. @return false if the queue is empty. */
+  bool pop(T& v) {
+    uint32_t pos = _dequeue.load(std::memory_order_relaxed);
+    for (;;) {
+      Cell& c = _cells[pos & (N - 1)];
+      int32_t dif = (int32_t)(c.seq.load(std::memory_order_acquire) - (pos + 1));
+      if (dif == 0) {
+        if (_dequeue.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+          v = c.data;
+          c.seq.store(pos + N, std::memory_order_release);
+          return true;
+        }
+      } else if (dif < 0) {
+        return false;  // not written yet: empty
+      } else {
+        pos = _dequeue.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+private:
+  struct Cell {
+    std::atomic<uint32_t> seq;
+    T data;
+  };
+
+  Cell _cells[N];
+  std::atomic<uint32_t> _enqueue{0};
+  std::atomic<uint32_t> _dequeue{0};
+};
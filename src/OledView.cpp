@@ -0,0 +1,128 @@
+/**
+ * @file OledView.cpp
+ * @brief OLED drawing task with tile-level partial updates.
+ */
+
+#include "OledView.h"
+
+static constexpr uint32_t OLED_TASK_STACK = 4096;
+
+// Each text line owns a 16 px band (two tile rows); baselines as before.
+static constexpr int LINE_BAND_PX = 16;
+static const int LINE_BASELINE[2] = {14, 30};
+
+bool OledView::begin(UBaseType_t prio, BaseType_t core) {
+  _d.setBusClock(OLED_BUS_HZ);
+  _d.begin();
+
+  _lock = xSemaphoreCreateMutex();
+  if (!_lock) return false;
+  return xTaskCreatePinnedToCore(taskMain, "oled", OLED_TASK_STACK, this, prio, &_task, core) == pdPASS;
+}
+
+void OledView::post(const Request& r) {
+  if (!_lock) return;
+  xSemaphoreTake(_lock, portMAX_DELAY);
+  _next = r;
+  _pending = true;
+  xSemaphoreGive(_lock);
+  xTaskNotifyGive(_task);
+}
+
+void OledView::showIp(const String& ip) {
+  Request r;
+  r.screen = SCREEN_IP;
+  snprintf(r.ip, sizeof(r.ip), "%s", ip.c_str());
+  post(r);
+}
+
+void OledView::showKnitStatus(int row1based, int rowsTotal, uint32_t tot) {
+  Request r;
+  r.screen = SCREEN_STATUS;
+  r.row = row1based;
+  r.rows = rowsTotal;
+  r.tot = tot;
+  post(r);
+}
+
+void OledView::taskMain(void* arg) {
+  OledView* self = (OledView*)arg;
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+    Request r;
+    bool pending;
+    xSemaphoreTake(self->_lock, portMAX_DELAY);
+    r = self->_next;
+    pending = self->_pending;
+    self->_pending = false;
+    xSemaphoreGive(self->_lock);
+
+    if (!pending) continue;
+    if (r.screen == SCREEN_IP) self->drawIp(r.ip);
+    else if (r.screen == SCREEN_STATUS) self->drawStatus(r);
+  }
+}
+
+void OledView::drawIp(const char* ip) {
+  _d.clearBuffer();
+  _d.setFont(u8g2_font_8x13_tf);
+  _d.drawStr(0, 14, "Connected");
+  _d.setFont(u8g2_font_6x12_tf);
+  _d.drawStr(0, 30, ip);
+  _d.sendBuffer();
+  _shown = SCREEN_IP;
+}
+
+// Big readable status line:
+// Row:07/24, Tot:53
+void OledView::drawStatus(const Request& r) {
+  char buf1[32];
+  snprintf(buf1, sizeof(buf1), "Row:%02d/%02d", r.row, r.rows);
+
+  char buf2[32];
+  snprintf(buf2, sizeof(buf2), "Tot:%lu", (unsigned long)r.tot);
+
+  // Coming from another screen: redraw everything and send the full buffer
+  bool full = (_shown != SCREEN_STATUS);
+  if (full) _d.clearBuffer();
+
+  // Big-ish font that fits 128x32 nicely:
+  // 8x13 for first line, 9x18 for second would be tight;
+  // This combo is very readable:
+  drawLine(0, buf1, u8g2_font_8x13_tf, full);
+  drawLine(1, buf2, u8g2_font_8x13B_tf, full);
+
+  if (full) _d.sendBuffer();
+  _shown = SCREEN_STATUS;
+}
+
+// Both fonts are 8 px monospace, so character i is exactly tile column i:
+// only the changed columns are cleared, redrawn and sent.
+void OledView::drawLine(int line, const char* text, const uint8_t* font, bool full) {
+  char padded[OLED_COLS + 1];
+  snprintf(padded, sizeof(padded), "%-*s", OLED_COLS, text);
+
+  char* shown = _lines[line];
+  int first = 0;
+  int last = OLED_COLS - 1;
+  if (!full) {
+    while (first < OLED_COLS && padded[first] == shown[first]) first++;
+    if (first == OLED_COLS) return;
+    while (padded[last] == shown[last]) last--;
+  }
+
+  const int top = line * LINE_BAND_PX;
+  _d.setDrawColor(0);
+  _d.drawBox(first * 8, top, (last - first + 1) * 8, LINE_BAND_PX);
+  _d.setDrawColor(1);
+
+  char part[OLED_COLS + 1];
+  memcpy(part, padded + first, last - first + 1);
+  part[last - first + 1] = 0;
+  _d.setFont(font);
+  _d.drawStr(first * 8, LINE_BASELINE[line], part);
+
+  if (!full) _d.updateDisplayArea(first, top / 8, last - first + 1, LINE_BAND_PX / 8);
+  memcpy(shown, padded, sizeof(padded));
+}
@@ -3,12 +3,24 @@
  * @brief OLED UI rendering (status/IP/row counters).
  *
  * Uses U8g2 fonts suited for 128x32 OLED.
- * Keeps rendering small and fast for ESP32.
+ * Drawing and the I2C transfer run in their own task: show*() only hand the
+ * values over, so the knitting task never waits for the bus. Status updates
+ * resend just the 8x8 tiles whose characters changed (a new pulse total is
+ * typically one or two tiles instead of the 512-byte framebuffer).
  */
 
 #pragma once
 #include <Arduino.h>
 #include <U8g2lib.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+
+/** @brief I2C clock for the display (fast mode). */
+static constexpr uint32_t OLED_BUS_HZ = 400000;
+
+/** @brief Characters per text line (128 px / 8 px monospace font = one tile each). */
+static constexpr int OLED_COLS = 16;
 
 /**
  * @brief Simple OLED view for KnittLED.
@@ -17,39 +29,45 @@ class OledView {
 public:
   explicit OledView(U8G2& d) : _d(d) {}
 
-  void begin() { _d.begin(); }
+  /** @brief Init the display and start the drawing task. Call after Wire.begin(). */
+  bool begin(UBaseType_t prio, BaseType_t core);
 
-  void showIp(const String& ip) {
-    _d.clearBuffer();
-    _d.setFont(u8g2_font_8x13_tf);
-    _d.drawStr(0, 14, "Connected");
-    _d.setFont(u8g2_font_6x12_tf);
-    _d.drawStr(0, 30, ip.c_str());
-    _d.sendBuffer();
-  }
+  /** @brief Two-line "Connected"/IP screen (full redraw). Any task. */
+  void showIp(const String& ip);
 
-  // Big readable status line:
-  // Row:07/24, Tot:53
-  void showKnitStatus(int row1based, int rowsTotal, uint32_t tot) {
-    char buf1[32];
-    snprintf(buf1, sizeof(buf1), "Row:%02d/%02d", row1based, rowsTotal);
+  /**
+   * @brief Row and pulse counters: Row:07/24, Tot:53. Any task.
+   *
+   * Only the latest values are drawn if several arrive while the bus is busy.
+   */
+  void showKnitStatus(int row1based, int rowsTotal, uint32_t tot);
 
-    char buf2[32];
-    snprintf(buf2, sizeof(buf2), "Tot:%lu", (unsigned long)tot);
-
-    _d.clearBuffer();
-    // Big-ish font that fits 128x32 nicely:
-    // 8x13 for first line, 9x18 for second would be tight;
-    // This combo is very readable:
-    _d.setFont(u8g2_font_8x13_tf);
-    _d.drawStr(0, 14, buf1);
+private:
+  enum Screen : uint8_t { SCREEN_NONE, SCREEN_IP, SCREEN_STATUS };
 
-    _d.setFont(u8g2_font_8x13B_tf);
-    _d.drawStr(0, 30, buf2);
+  struct Request {
+    Screen screen = SCREEN_NONE;
+    int row = 0;
+    int rows = 0;
+    uint32_t tot = 0;
+    char ip[40] = {0};
+  };
 
-    _d.sendBuffer();
-  }
+  static void taskMain(void* arg);
+  void post(const Request& r);
+  void drawIp(const char* ip);
+  void drawStatus(const Request& r);
+  void drawLine(int line, const char* text, const uint8_t* font, bool full);
 
-private:
   U8G2& _d;
+  SemaphoreHandle_t _lock = nullptr;
+  TaskHandle_t _task = nullptr;
+
+  // Guarded by _lock
+  Request _next;
+  bool _pending = false;
+
+  // Drawing task only
+  Screen _shown = SCREEN_NONE;
+  char _lines[2][OLED_COLS + 1];
 };
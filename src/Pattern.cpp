@@ -7,99 +7,891 @@
  */
 
 #include "Pattern.h"
+#include "RowSource.h"
+#include "RowFlags.h"
+#include <algorithm>
+#include <utility>
 
-static String esc(const String& s) {
-  String out;
-  out.reserve(s.length());
-  for (char c : s) {
-    switch (c) {
-      case '\\': out += "\\\\"; break;
-      case '"':  out += "\\\""; break;
-      default: out += c; break;
+// ------------------------------------------------------------
+// Packed row storage
+// ------------------------------------------------------------
+
+bool Pattern::assign(const Pattern& o) {
+  if (this == &o) return true;
+  if (!o.valid()) return false;
+  Pattern tmp{Empty()};
+  if (!tmp.alloc(o.w, o.h)) return false;
+  for (int r = 0; r < o.h; r++) memcpy(tmp.row(r), o.row(r), o._stride * sizeof(uint32_t));
+  tmp.name = o.name;
+  swap(tmp);
+  return true;
+}
+
+void Pattern::swap(Pattern& o) noexcept {
+  std::swap(name, o.name);
+  std::swap(w, o.w);
+  std::swap(h, o.h);
+  std::swap(_stride, o._stride);
+  std::swap(_cap, o._cap);
+  std::swap(_bits, o._bits);
+  std::swap(_order, o._order);
+}
+
+// Fresh zeroed storage for nw x nh with rows in slot order.
+bool Pattern::alloc(int nw, int nh) {
+  int stride = patternWordsPerRow(nw);
+  uint32_t* bits = (uint32_t*)calloc((size_t)nh * stride, sizeof(uint32_t));
+  uint16_t* order = (uint16_t*)malloc(nh * sizeof(uint16_t));
+  if (!bits || !order) {
+    free(bits);
+    free(order);
+    return false;
+  }
+  for (int i = 0; i < nh; i++) order[i] = i;
+
+  free(_bits);
+  free(_order);
+  _bits = bits;
+  _order = order;
+  _stride = stride;
+  _cap = nh;
+  w = nw;
+  h = nh;
+  return true;
+}
+
+// Grow the slot pool to at least n rows. New slots join the free tail
+// of _order (entries [h, _cap) are always the unused slots).
+bool Pattern::reserve(int n) {
+  if (n <= _cap) return true;
+  int cap = max(n, min(MAX_H, _cap + _cap / 2));
+
+  uint32_t* bits = (uint32_t*)realloc(_bits, (size_t)cap * _stride * sizeof(uint32_t));
+  if (!bits) return false;
+  _bits = bits;
+  uint16_t* order = (uint16_t*)realloc(_order, cap * sizeof(uint16_t));
+  if (!order) return false;
+  _order = order;
+
+  for (int i = _cap; i < cap; i++) _order[i] = i;
+  _cap = cap;
+  return true;
+}
+
+void Pattern::clearRow(int r) {
+  memset(row(r), 0, _stride * sizeof(uint32_t));
+}
+
+bool Pattern::resize(int nw, int nh) {
+  if (nw < 1 || nw > MAX_W || nh < 1 || nh > MAX_H) return false;
+  if (!_bits) return alloc(nw, nh);
+  if (nw == w && nh == h) return true;
+
+  if (nw == w) {
+    // Height only: rows are added or dropped at the end, nothing moves.
+    if (!reserve(nh)) return false;
+    for (int r = h; r < nh; r++) clearRow(r);
+    h = nh;
+    return true;
+  }
+
+  Pattern tmp{Empty()};
+  if (!tmp.alloc(nw, nh)) return false;
+  // Keep the overlapping area; trailing bits past the new width are masked off.
+  int rows = min(nh, h);
+  int words = min(tmp._stride, _stride);
+  uint32_t tailMask = tmp.lastWordMask();
+  for (int r = 0; r < rows; r++) {
+    uint32_t* dst = tmp.row(r);
+    memcpy(dst, row(r), words * sizeof(uint32_t));
+    dst[tmp._stride - 1] &= tailMask;
+  }
+  tmp.name = name;
+  swap(tmp);
+  return true;
+}
+
+void Pattern::clear() {
+  if (_bits) memset(_bits, 0, (size_t)_cap * _stride * sizeof(uint32_t));
+}
+
+bool Pattern::insertRows(int at, int n) {
+  if (at < 0 || at > h || n < 1 || h + n > MAX_H) return false;
+  if (!reserve(h + n)) return false;
+  for (int r = h; r < h + n; r++) clearRow(r);
+  std::rotate(_order + at, _order + h, _order + h + n);
+  h += n;
+  return true;
+}
+
+bool Pattern::removeRows(int at, int n) {
+  if (at < 0 || n < 1 || at + n > h || n >= h) return false;
+  std::rotate(_order + at, _order + at + n, _order + h);
+  h -= n;
+  return true;
+}
+
+bool Pattern::repeatRows(int at, int n, int times) {
+  if (at < 0 || n < 1 || at + n > h || times < 1) return false;
+  if ((long)n * (times - 1) > MAX_H - h) return false;
+  int extra = n * (times - 1);
+  if (extra == 0) return true;
+  if (!insertRows(at + n, extra)) return false;
+  for (int k = 0; k < extra; k++) memcpy(row(at + n + k), row(at + k % n), _stride * sizeof(uint32_t));
+  return true;
+}
+
+bool Pattern::moveRows(int from, int n, int to) {
+  if (from < 0 || n < 1 || from + n > h || to < 0 || to + n > h) return false;
+  if (to < from) std::rotate(_order + to, _order + from, _order + from + n);
+  else if (to > from) std::rotate(_order + from, _order + from + n, _order + to + n);
+  return true;
+}
+
+// ------------------------------------------------------------
+// Streaming JSON writer
+// ------------------------------------------------------------
+
+namespace {
+
+// Batches small writes into one sink call per buffer. Remembers short
+// writes so callers can tell a full file system from success.
+class JsonEmitter {
+public:
+  explicit JsonEmitter(Print& out) : _out(out) {}
+
+  void put(char c) {
+    if (_n == sizeof(_buf)) flush();
+    _buf[_n++] = c;
+  }
+
+  void put(const char* s) {
+    while (*s) put(*s++);
+  }
+
+  void putInt(long v) {
+    char tmp[12];
+    snprintf(tmp, sizeof(tmp), "%ld", v);
+    put(tmp);
+  }
+
+  void putEscaped(const String& s) {
+    for (char c : s) {
+      switch (c) {
+        case '\\': put("\\\\"); break;
+        case '"':  put("\\\""); break;
+        default:
+          if ((uint8_t)c < 0x20) {
+            char tmp[7];
+            snprintf(tmp, sizeof(tmp), "\\u%04x", (unsigned)(uint8_t)c);
+            put(tmp);
+          } else {
+            put(c);
+          }
+          break;
+      }
     }
   }
-  return out;
+
+  void put(const char* s, size_t n) {
+    if (_n + n > sizeof(_buf)) flush();
+    memcpy(_buf + _n, s, n);
+    _n += n;
+  }
+
+  // Expand a packed row four stitches per step from a nibble table.
+  void putRow(const uint32_t* words, int w) {
+    static const char NIBBLE[16][4] = {
+      {'0','0','0','0'}, {'1','0','0','0'}, {'0','1','0','0'}, {'1','1','0','0'},
+      {'0','0','1','0'}, {'1','0','1','0'}, {'0','1','1','0'}, {'1','1','1','0'},
+      {'0','0','0','1'}, {'1','0','0','1'}, {'0','1','0','1'}, {'1','1','0','1'},
+      {'0','0','1','1'}, {'1','0','1','1'}, {'0','1','1','1'}, {'1','1','1','1'},
+    };
+    put('"');
+    for (int c = 0; c < w; c += 4) {
+      uint32_t nib = (words[c / PATTERN_WORD_BITS] >> (c % PATTERN_WORD_BITS)) & 0xFu;
+      put(NIBBLE[nib], min(4, w - c));
+    }
+    put('"');
+  }
+
+  void flush() {
+    if (_n == 0) return;
+    size_t wrote = _out.write(_buf, _n);
+    if (wrote != _n) _failed = true;
+    _total += wrote;
+    _n = 0;
+  }
+
+  size_t finish() {
+    flush();
+    return _failed ? 0 : _total;
+  }
+
+private:
+  Print& _out;
+  uint8_t _buf[64];
+  size_t _n = 0;
+  size_t _total = 0;
+  bool _failed = false;
+};
+
+// Print sink that appends to a String.
+class StringSink : public Print {
+public:
+  explicit StringSink(String& s) : _s(s) {}
+  size_t write(uint8_t c) override { return _s.concat((char)c) ? 1 : 0; }
+  size_t write(const uint8_t* b, size_t n) override {
+    return _s.concat((const char*)b, n) ? n : 0;
+  }
+
+private:
+  String& _s;
+};
+
+}  // namespace
+
+// Everything before the first row; rows then follow every w + 3 bytes.
+static void putHeader(JsonEmitter& e, const String& name, int w, int h) {
+  e.put("{\"name\":\"");
+  e.putEscaped(name);
+  e.put("\",\"w\":");
+  e.putInt(w);
+  e.put(",\"h\":");
+  e.putInt(h);
+  e.put(",\"pixels\":[");
+}
+
+size_t writePatternJson(Print& out, RowSource& rows, const String& name, int first, int last) {
+  const int w = rows.width();
+  const int h = rows.height();
+  JsonEmitter e(out);
+  if (first == 0) putHeader(e, name, w, h);
+  for (int r = first; r < last; r++) {
+    if (r) e.put(',');
+    e.putRow(rows.row(r), w);
+  }
+  if (last == h) e.put("]}");
+  return e.finish();
+}
+
+size_t writePatternJson(Print& out, RowSource& rows, const String& name) {
+  return writePatternJson(out, rows, name, 0, rows.height());
+}
+
+size_t writePatternJson(Print& out, const Pattern& p) {
+  PatternRowSource rows(p);
+  return writePatternJson(out, rows, p.name);
+}
+
+String patternJsonHeader(const Pattern& p) {
+  String head;
+  StringSink sink(head);
+  JsonEmitter e(sink);
+  putHeader(e, p.name, p.w, p.h);
+  e.finish();
+  return head;
+}
+
+size_t writePatternJsonRow(Print& out, const uint32_t* words, int w) {
+  JsonEmitter e(out);
+  e.putRow(words, w);
+  return e.finish();
 }
 
 String patternToJson(const Pattern& p) {
   String json;
-  json.reserve(2200);
-  json += "{";
-  json += "\"name\":\"" + esc(p.name) + "\",";
-  json += "\"w\":" + String(p.w) + ",";
-  json += "\"h\":" + String(p.h) + ",";
-  json += "\"pixels\":[";
-  for (int r = 0; r < p.h; r++) {
-    String row;
-    row.reserve(p.w);
-    for (int c = 0; c < p.w; c++) row += (p.px[r][c] ? '1' : '0');
-    json += "\"";
-    json += row;
-    json += "\"";
-    if (r != p.h - 1) json += ",";
-  }
-  json += "]}";
+  json.reserve(64 + p.name.length() + p.h * (p.w + 3));
+  StringSink sink(json);
+  writePatternJson(sink, p);
   return json;
 }
 
-bool jsonToPattern(const String& json, Pattern& out) {
-  auto findInt = [&](const char* key, int& value) -> bool {
-    String k = String("\"") + key + "\":";
-    int i = json.indexOf(k);
-    if (i < 0) return false;
-    i += k.length();
-    int j = i;
-    while (j < (int)json.length() && (isdigit(json[j]) || json[j] == '-')) j++;
-    value = json.substring(i, j).toInt();
+// ------------------------------------------------------------
+// Single-pass JSON readers
+// ------------------------------------------------------------
+//
+// Bytes are looked at once and pixel rows written straight into the
+// destination Pattern. Apart from the row storage itself (and the name
+// String) nothing is allocated: no per-key scans, no substrings. Unknown
+// keys are skipped, so envelopes and future fields parse.
+//
+// PatternJsonReader is pushed bytes (file reads, HTTP body chunks) and keeps
+// its place in an explicit container stack; the patch reader pulls from
+// a memory range.
+
+namespace {
+
+// Parser position outside a token.
+enum : uint8_t {
+  EXPECT_VALUE,
+  EXPECT_VALUE_OR_END,  // after '['
+  EXPECT_KEY,
+  EXPECT_KEY_OR_END,    // after '{'
+  EXPECT_COLON,
+  EXPECT_NEXT,          // ',' or the closing bracket
+};
+
+enum : uint8_t { TOKEN_NONE, TOKEN_STRING, TOKEN_ROW, TOKEN_SCALAR };
+
+// Where a string or number goes.
+enum : uint8_t { SLOT_SKIP, SLOT_KEY, SLOT_FILE, SLOT_NAME, SLOT_W, SLOT_H };
+
+// Role of an open container, or'ed with CONTAINER_OBJECT for objects.
+enum : uint8_t { ROLE_SKIP, ROLE_ENVELOPE, ROLE_PATTERN, ROLE_PIXELS, CONTAINER_OBJECT = 0x80 };
+
+inline bool isJsonSpace(int c) {
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+// Ends a number or literal.
+inline bool isJsonDelim(int c) {
+  return c == ',' || c == '}' || c == ']' || isJsonSpace(c);
+}
+
+}  // namespace
+
+bool PatternJsonReader::feed(const uint8_t* data, size_t n) {
+  for (size_t i = 0; i < n && !_failed && !_closed; i++) {
+    if (!step(data[i])) _failed = true;
+  }
+  return !_failed;
+}
+
+bool PatternJsonReader::step(int c) {
+  switch (_token) {
+    case TOKEN_STRING:
+      return stringByte(c);
+    case TOKEN_ROW:
+      if (c == '"') {
+        _token = TOKEN_NONE;
+        return endRow();
+      }
+      // Width unknown until the first row ends: bounded by MAX_W.
+      if (_col >= (_w ? _w : MAX_W)) return false;
+      if (c == '1') _row[_col / PATTERN_WORD_BITS] |= 1u << (_col % PATTERN_WORD_BITS);
+      _col++;
+      return true;
+    case TOKEN_SCALAR:
+      if (!isJsonDelim(c)) return scalarByte(c);
+      _token = TOKEN_NONE;
+      if (!endScalar()) return false;
+      break;  // the delimiter itself is structure
+    default:
+      break;
+  }
+
+  if (isJsonSpace(c)) return true;
+  switch (_expect) {
+    case EXPECT_VALUE:
+      return beginValue(c);
+    case EXPECT_VALUE_OR_END:
+      return c == ']' ? endContainer(c) : beginValue(c);
+    case EXPECT_KEY_OR_END:
+      if (c == '}') return endContainer(c);
+      // fall through
+    case EXPECT_KEY:
+      if (c != '"') return false;
+      _token = TOKEN_STRING;
+      _slot = SLOT_KEY;
+      _textLen = 0;
+      _esc = 0;
+      return true;
+    case EXPECT_COLON:
+      if (c != ':') return false;
+      _expect = EXPECT_VALUE;
+      return true;
+    case EXPECT_NEXT:
+      if (c == '}' || c == ']') return endContainer(c);
+      if (c != ',') return false;
+      _expect = (_stack[_depth - 1] & CONTAINER_OBJECT) ? EXPECT_KEY : EXPECT_VALUE;
+      return true;
+  }
+  return false;
+}
+
+// First byte of a value; where it goes follows from the enclosing
+// container and the key.
+bool PatternJsonReader::beginValue(int c) {
+  if (c == ',' || c == '}' || c == ']' || c == ':') return false;
+
+  uint8_t role = _depth ? (_stack[_depth - 1] & ~CONTAINER_OBJECT) : ROLE_SKIP;
+  uint8_t slot = SLOT_SKIP;
+  uint8_t open = ROLE_SKIP;  // role of a container opened here
+
+  if (_depth == 0) {
+    if (c != '{') return false;
+    open = _envelope ? ROLE_ENVELOPE : ROLE_PATTERN;
+  } else if (role == ROLE_ENVELOPE) {
+    if (!strcmp(_key, "file")) {
+      if (c != '"') return false;
+      slot = SLOT_FILE;
+    } else if (!strcmp(_key, "pattern")) {
+      if (c != '{') return false;
+      open = ROLE_PATTERN;
+    }
+  } else if (role == ROLE_PATTERN) {
+    if (!strcmp(_key, "w") || !strcmp(_key, "h")) {
+      if (c == '"' || c == '{' || c == '[') return false;
+      slot = _key[0] == 'w' ? SLOT_W : SLOT_H;
+    } else if (!strcmp(_key, "name")) {
+      if (c != '"') return false;
+      slot = SLOT_NAME;
+    } else if (!strcmp(_key, "pixels")) {
+      if (c != '[' || !beginPixels()) return false;
+      open = ROLE_PIXELS;
+    }
+  } else if (role == ROLE_PIXELS) {
+    if (c != '"') return false;
+    memset(_row, 0, sizeof(_row));
+    _col = 0;
+    _token = TOKEN_ROW;
     return true;
-  };
-
-  auto findString = [&](const char* key, String& value) -> bool {
-    String k = String("\"") + key + "\":\"";
-    int i = json.indexOf(k);
-    if (i < 0) return false;
-    i += k.length();
-    int j = json.indexOf("\"", i);
-    if (j < 0) return false;
-    value = json.substring(i, j);
+  }
+
+  if (c == '{' || c == '[') {
+    if (_depth >= MAX_DEPTH + 2) return false;
+    bool obj = (c == '{');
+    _stack[_depth++] = open | (obj ? CONTAINER_OBJECT : 0);
+    _expect = obj ? EXPECT_KEY_OR_END : EXPECT_VALUE_OR_END;
+    return true;
+  }
+
+  _slot = slot;
+  if (c == '"') {
+    _token = TOKEN_STRING;
+    _textLen = 0;
+    _esc = 0;
+    if (slot == SLOT_FILE) _file = "";
     return true;
-  };
+  }
+  _token = TOKEN_SCALAR;
+  _num = 0;
+  _neg = (c == '-');
+  _digits = false;
+  return _neg || scalarByte(c);
+}
+
+bool PatternJsonReader::endValue() {
+  _expect = EXPECT_NEXT;
+  return true;
+}
+
+bool PatternJsonReader::endContainer(int c) {
+  uint8_t top = _stack[_depth - 1];
+  if (c != ((top & CONTAINER_OBJECT) ? '}' : ']')) return false;
+  _depth--;
+  if ((top & ~CONTAINER_OBJECT) == ROLE_PATTERN) {
+    if (!finish()) return false;
+    _patternDone = true;
+  }
+  if (_depth == 0) {
+    _closed = true;
+    return true;
+  }
+  return endValue();
+}
+
+bool PatternJsonReader::stringByte(int c) {
+  if (_esc == 0) {
+    if (c == '"') {
+      _token = TOKEN_NONE;
+      return endString();
+    }
+    if (c == '\\') {
+      _esc = 1;
+      return true;
+    }
+    return textByte(c);
+  }
+
+  if (_esc == 1) {
+    switch (c) {
+      case 'n': c = '\n'; break;
+      case 't': c = '\t'; break;
+      case 'r': c = '\r'; break;
+      case 'b': c = '\b'; break;
+      case 'f': c = '\f'; break;
+      case 'u': _esc = 2; _cp = 0; return true;
+      default: break;  // \" \\ \/ map to themselves
+    }
+    _esc = 0;
+    return textByte(c);
+  }
+
+  // \uXXXX: _esc counts the hex digits read (2..5).
+  if (c >= '0' && c <= '9') _cp = _cp * 16 + (c - '0');
+  else if (c >= 'a' && c <= 'f') _cp = _cp * 16 + (c - 'a' + 10);
+  else if (c >= 'A' && c <= 'F') _cp = _cp * 16 + (c - 'A' + 10);
+  else return false;
+  if (++_esc < 6) return true;
+  _esc = 0;
+
+  // Encode as UTF-8 (BMP only; surrogate halves pass through as-is).
+  if (_cp < 0x80) return textByte(_cp);
+  if (_cp < 0x800) return textByte(0xC0 | (_cp >> 6)) && textByte(0x80 | (_cp & 0x3F));
+  return textByte(0xE0 | (_cp >> 12)) && textByte(0x80 | ((_cp >> 6) & 0x3F)) && textByte(0x80 | (_cp & 0x3F));
+}
 
-  int w = 0, h = 0;
-  if (!findInt("w", w)) return false;
-  if (!findInt("h", h)) return false;
-  if (w < 1 || w > MAX_W) return false;
-  if (h < 1 || h > MAX_H) return false;
+// Keys and names longer than their buffers are truncated.
+bool PatternJsonReader::textByte(uint8_t b) {
+  if (_slot == SLOT_SKIP) return true;
+  if (_slot == SLOT_FILE) {
+    if (_file.length() >= 255) return false;
+    _file += (char)b;
+    return true;
+  }
+  size_t cap = (_slot == SLOT_KEY) ? sizeof(_key) : sizeof(_text);
+  if (_textLen + 1u < cap) _text[_textLen++] = (char)b;
+  return true;
+}
 
-  Pattern p;
-  p.w = w;
-  p.h = h;
-  findString("name", p.name);
+bool PatternJsonReader::endString() {
+  _text[_textLen] = 0;
+  if (_slot == SLOT_KEY) {
+    memcpy(_key, _text, _textLen + 1);
+    _expect = EXPECT_COLON;
+    return true;
+  }
+  if (_slot == SLOT_NAME) {
+    _out.name = _text;
+    _named = true;
+  }
+  return endValue();
+}
 
-  int pixKey = json.indexOf("\"pixels\":[");
-  if (pixKey < 0) return false;
-  int i = json.indexOf("[", pixKey);
-  int end = json.indexOf("]", i);
-  if (i < 0 || end < 0) return false;
+// Numbers for "w" / "h" are integers; other numbers and literals are skipped.
+bool PatternJsonReader::scalarByte(int c) {
+  if (_slot == SLOT_SKIP) return true;
+  if (c < '0' || c > '9') return false;
+  if (_num < 100000000L) _num = _num * 10 + (c - '0');
+  _digits = true;
+  return true;
+}
 
-  int r = 0;
-  int pos = i + 1;
-  while (r < h) {
-    int q1 = json.indexOf("\"", pos);
-    if (q1 < 0 || q1 > end) break;
-    int q2 = json.indexOf("\"", q1 + 1);
-    if (q2 < 0 || q2 > end) break;
+bool PatternJsonReader::endScalar() {
+  if (_slot == SLOT_W || _slot == SLOT_H) {
+    if (!_digits) return false;
+    int v = (int)(_neg ? -_num : _num);
+    if (_slot == SLOT_W) _declW = v;
+    else _declH = v;
+  }
+  return endValue();
+}
 
-    String row = json.substring(q1 + 1, q2);
-    if ((int)row.length() != w) return false;
+bool PatternJsonReader::beginPixels() {
+  if (_declW > MAX_W) return false;  // rows would not fit _row (nor the pattern)
+  _rows = 0;
+  _w = _declW;
+  if (_declW > 0 && _declH > 0) {
+    // Usual case: size came first, so rows land in place.
+    if (!_out.resize(_declW, _declH)) return false;
+    _out.clear();
+    _cap = _declH;
+  }
+  return true;
+}
 
-    for (int c = 0; c < w; c++) p.px[r][c] = (row[c] == '1');
+// Make room for row index r while the final height is still unknown.
+bool PatternJsonReader::reserveRow(int r) {
+  if (r < _cap) return true;
+  if (r >= MAX_H) return false;
+  int cap = _cap ? min(_cap * 2, MAX_H) : 32;
+  if (!_out.resize(_w, cap)) return false;
+  _cap = cap;
+  return true;
+}
 
-    r++;
-    pos = q2 + 1;
+// A "0101..." row string ended; its stitches are in _row.
+bool PatternJsonReader::endRow() {
+  if (_w == 0) {
+    // Width unknown: the first row defines it.
+    if (_col < 1) return false;
+    _w = _col;
+    if (!reserveRow(0)) return false;
+    _out.clear();
+    memcpy(_out.row(0), _row, _out.wordsPerRow() * sizeof(uint32_t));
+    _rows = 1;
+    return endValue();
   }
 
-  if (r != h) return false;
-  out = p;
+  if (_col != _w) return false;
+  if (_declH > 0 && _cap == _declH && _rows >= _declH) return endValue();  // extra rows are ignored
+  if (!reserveRow(_rows)) return false;
+  memcpy(_out.row(_rows), _row, _out.wordsPerRow() * sizeof(uint32_t));
+  _rows++;
+  return endValue();
+}
+
+bool PatternJsonReader::finish() {
+  if (_declW < 1 || _declW > MAX_W) return false;
+  if (_declH < 1 || _declH > MAX_H) return false;
+  if (_w != _declW || _rows != _declH) return false;
+  if (_out.h != _declH && !_out.resize(_declW, _declH)) return false;
+  if (!_named) _out.name = "default";
+  return true;
+}
+
+namespace {
+
+struct MemSource {
+  const char* p;
+  const char* end;
+  int get() { return p < end ? (uint8_t)*p++ : -1; }
+};
+
+// Byte-level JSON scanning for the patch reader.
+template <class Source>
+class JsonLexer {
+protected:
+  static constexpr int MAX_DEPTH = 16;
+
+  explicit JsonLexer(Source& src) : _src(src) {}
+
+  Source& _src;
+  int _peek = -2;
+
+  int raw() {
+    if (_peek != -2) { int c = _peek; _peek = -2; return c; }
+    return _src.get();
+  }
+
+  // Next non-whitespace byte.
+  int next() {
+    int c;
+    do { c = raw(); } while (c == ' ' || c == '\t' || c == '\r' || c == '\n');
+    return c;
+  }
+
+  bool readInt(int& v) {
+    int c = next();
+    bool neg = (c == '-');
+    if (neg) c = raw();
+    if (c < '0' || c > '9') return false;
+    long acc = 0;
+    while (c >= '0' && c <= '9') {
+      if (acc < 100000000L) acc = acc * 10 + (c - '0');
+      c = raw();
+    }
+    _peek = c;
+    v = (int)(neg ? -acc : acc);
+    return true;
+  }
+
+  // Reads the rest of a string whose opening quote was consumed.
+  // Writes up to cap-1 bytes (NUL-terminated); longer strings are truncated.
+  bool readString(char* dst, size_t cap) {
+    size_t n = 0;
+    for (;;) {
+      int c = raw();
+      if (c < 0) return false;
+      if (c == '"') break;
+      if (c == '\\') {
+        c = raw();
+        switch (c) {
+          case 'n': c = '\n'; break;
+          case 't': c = '\t'; break;
+          case 'r': c = '\r'; break;
+          case 'b': c = '\b'; break;
+          case 'f': c = '\f'; break;
+          case 'u': {
+            uint32_t cp = 0;
+            for (int i = 0; i < 4; i++) {
+              int x = raw();
+              if (x >= '0' && x <= '9') cp = cp * 16 + (x - '0');
+              else if (x >= 'a' && x <= 'f') cp = cp * 16 + (x - 'a' + 10);
+              else if (x >= 'A' && x <= 'F') cp = cp * 16 + (x - 'A' + 10);
+              else return false;
+            }
+            // Encode as UTF-8 (BMP only; surrogate halves pass through as-is).
+            uint8_t u[3];
+            size_t k;
+            if (cp < 0x80) { u[0] = cp; k = 1; }
+            else if (cp < 0x800) { u[0] = 0xC0 | (cp >> 6); u[1] = 0x80 | (cp & 0x3F); k = 2; }
+            else { u[0] = 0xE0 | (cp >> 12); u[1] = 0x80 | ((cp >> 6) & 0x3F); u[2] = 0x80 | (cp & 0x3F); k = 3; }
+            for (size_t i = 0; i < k; i++) if (dst && n + 1 < cap) dst[n++] = (char)u[i];
+            continue;
+          }
+          case -1: return false;
+          default: break;  // \" \\ \/ map to themselves
+        }
+      }
+      if (dst && n + 1 < cap) dst[n++] = (char)c;
+    }
+    if (dst) dst[n] = 0;
+    return true;
+  }
+
+  bool skipValue(int c, int depth) {
+    if (depth > MAX_DEPTH) return false;
+    if (c == '"') return readString(nullptr, 0);
+    if (c == '{' || c == '[') {
+      int close = (c == '{') ? '}' : ']';
+      c = next();
+      if (c == close) return true;
+      for (;;) {
+        if (close == '}') {
+          if (c != '"' || !readString(nullptr, 0)) return false;
+          if (next() != ':') return false;
+          c = next();
+        }
+        if (!skipValue(c, depth + 1)) return false;
+        c = next();
+        if (c == close) return true;
+        if (c != ',') return false;
+        c = next();
+      }
+    }
+    // number / true / false / null
+    if (c < 0) return false;
+    for (;;) {
+      int d = raw();
+      if (d < 0 || d == ',' || d == '}' || d == ']' || d == ' ' || d == '\t' || d == '\r' || d == '\n') {
+        _peek = d;
+        return true;
+      }
+    }
+  }
+};
+
+// Reads {"cells":[[r,c,v],...],"rows":[{"r":r0,"pixels":["0101",...]}]}.
+// Run once with apply=false to validate the whole patch, then again to
+// write it, so a rejected patch leaves the pattern untouched.
+class PatternPatchReader : public JsonLexer<MemSource> {
+public:
+  PatternPatchReader(MemSource& src, Pattern& p, bool apply, RowFlags* dirty)
+      : JsonLexer<MemSource>(src), _p(p), _apply(apply), _dirty(dirty) {}
+
+  bool parse() {
+    if (next() != '{') return false;
+    int c = next();
+    if (c == '}') return true;
+    for (;;) {
+      if (c != '"') return false;
+      char key[8];
+      if (!readString(key, sizeof(key))) return false;
+      if (next() != ':') return false;
+
+      bool ok;
+      int v;
+      if (!strcmp(key, "w")) ok = readInt(v) && v == _p.w;
+      else if (!strcmp(key, "h")) ok = readInt(v) && v == _p.h;
+      else if (!strcmp(key, "cells")) ok = readList([this](int c) { return readCell(c); });
+      else if (!strcmp(key, "rows")) ok = readList([this](int c) { return readRange(c); });
+      else ok = skipValue(next(), 0);
+      if (!ok) return false;
+
+      c = next();
+      if (c == '}') return true;
+      if (c != ',') return false;
+      c = next();
+    }
+  }
+
+private:
+  Pattern& _p;
+  bool _apply;
+  RowFlags* _dirty;
+
+  void touch(int r) {
+    if (_apply && _dirty) _dirty->set(r);
+  }
+
+  // [item, item, ...]; item() gets the first byte of each element.
+  template <class Item>
+  bool readList(Item item) {
+    if (next() != '[') return false;
+    int c = next();
+    if (c == ']') return true;
+    for (;;) {
+      if (!item(c)) return false;
+      c = next();
+      if (c == ']') return true;
+      if (c != ',') return false;
+      c = next();
+    }
+  }
+
+  // [row, col, 0|1]
+  bool readCell(int c) {
+    int r, col, v;
+    if (c != '[') return false;
+    if (!readInt(r) || next() != ',') return false;
+    if (!readInt(col) || next() != ',') return false;
+    if (!readInt(v) || next() != ']') return false;
+    if (r < 0 || r >= _p.h || col < 0 || col >= _p.w || (v != 0 && v != 1)) return false;
+    if (_apply) _p.set(r, col, v);
+    touch(r);
+    return true;
+  }
+
+  // {"r":first,"pixels":[...]} replaces consecutive rows; "r" comes first.
+  bool readRange(int c) {
+    if (c != '{') return false;
+    int r = -1;
+    c = next();
+    for (;;) {
+      if (c != '"') return false;
+      char key[8];
+      if (!readString(key, sizeof(key))) return false;
+      if (next() != ':') return false;
+
+      bool ok;
+      if (!strcmp(key, "r")) ok = readInt(r) && r >= 0 && r < _p.h;
+      else if (!strcmp(key, "pixels")) ok = r >= 0 && readList([this, &r](int c) { return readRow(c, r++); });
+      else ok = skipValue(next(), 0);
+      if (!ok) return false;
+
+      c = next();
+      if (c == '}') return true;
+      if (c != ',') return false;
+      c = next();
+    }
+  }
+
+  // "0101..." of exactly w stitches into row r.
+  bool readRow(int c, int r) {
+    if (c != '"' || r >= _p.h) return false;
+    uint32_t tmp[(MAX_W + PATTERN_WORD_BITS - 1) / PATTERN_WORD_BITS] = {};
+    int col = 0;
+    for (;;) {
+      c = raw();
+      if (c < 0) return false;
+      if (c == '"') break;
+      if (col >= _p.w) return false;
+      if (c == '1') tmp[col / PATTERN_WORD_BITS] |= 1u << (col % PATTERN_WORD_BITS);
+      col++;
+    }
+    if (col != _p.w) return false;
+    if (_apply) memcpy(_p.row(r), tmp, _p.wordsPerRow() * sizeof(uint32_t));
+    touch(r);
+    return true;
+  }
+};
+
+}  // namespace
+
+bool jsonToPattern(const char* json, size_t len, Pattern& out) {
+  PatternJsonReader reader(out);
+  reader.feed((const uint8_t*)json, len);
+  return reader.done();
+}
+
+bool jsonToPattern(Stream& in, Pattern& out) {
+  PatternJsonReader reader(out);
+  uint8_t buf[64];
+  while (!reader.done()) {
+    size_t n = in.readBytes(buf, sizeof(buf));
+    if (n == 0 || !reader.feed(buf, n)) break;
+  }
+  return reader.done();
+}
+
+bool applyPatternPatch(const char* json, size_t len, Pattern& p, RowFlags* dirty) {
+  for (int pass = 0; pass < 2; pass++) {
+    MemSource src{json, json + len};
+    PatternPatchReader reader(src, p, pass == 1, dirty);
+    if (!reader.parse()) return false;
+  }
   return true;
 }
@@ -4,31 +4,296 @@
  *
  * Patterns are stored as a compact JSON file in LittleFS.
  * The file format is project-specific (not an industry standard).
+ *
+ * In RAM each row is bit-packed into 32-bit words (one bit per stitch),
+ * so a 200-needle row costs 28 bytes instead of 200 bools.
  */
 
 #pragma once
 #include <Arduino.h>
 
-static constexpr int MAX_W = 12;
-static constexpr int MAX_H = 24;
+/** @brief Maximum pattern width (needles). */
+static constexpr int MAX_W = 256;
+/** @brief Maximum pattern height (rows). */
+static constexpr int MAX_H = 4096;
+
+/** @brief Bits per packed row word. */
+static constexpr int PATTERN_WORD_BITS = 32;
+
+/** @brief Number of 32-bit words needed to hold @p w stitches. */
+static inline int patternWordsPerRow(int w) {
+  return (w + PATTERN_WORD_BITS - 1) / PATTERN_WORD_BITS;
+}
 
 /**
  * @brief Knitting pattern grid.
  *
  * Row index 0 is the top row in storage.
- * Columns are stored left-to-right.
+ * Columns are stored left-to-right: column @c c lives in word @c c/32,
+ * bit @c c%32 (LSB first). Bits past @ref w in the last word are always 0,
+ * so whole words can be compared, counted or copied without masking.
+ *
+ * @ref w and @ref h are read-only views of the current size; change them
+ * through resize() or the row operations so the row storage follows.
+ *
+ * Rows live in a pool of slots reached through a row order table, so
+ * inserting, deleting or moving rows shuffles 2-byte table entries instead
+ * of copying stitches. Rows are only contiguous per row, not across rows.
  */
 struct Pattern {
   String name = "default";
   int w = 12;
   int h = 24;
-  bool px[MAX_H][MAX_W]{};
+
+  /** @brief 12 x 24, all 0 (empty and !valid() if memory is exhausted). */
+  Pattern() {
+    if (!resize(w, h)) w = h = 0;
+  }
+  /** @brief Copy of @p o; empty and !valid() if memory is exhausted. */
+  Pattern(const Pattern& o) : w(0), h(0) { assign(o); }
+  /** @brief Takes over @p o's rows; @p o is left empty. */
+  Pattern(Pattern&& o) noexcept : w(0), h(0) { swap(o); }
+  ~Pattern() { free(_bits); free(_order); }
+
+  /** @brief Copy @p o. False if memory is exhausted (pattern unchanged). */
+  bool assign(const Pattern& o);
+
+  /** @brief Same as assign(); test valid() or use assign() where memory may run out. */
+  Pattern& operator=(const Pattern& o) {
+    assign(o);
+    return *this;
+  }
+  Pattern& operator=(Pattern&& o) noexcept { swap(o); return *this; }
+
+  /**
+   * @brief True if the pattern has row storage.
+   *
+   * False only after an allocation failed in a constructor (or for a
+   * moved-from pattern); w and h are 0 then. resize() makes it valid again.
+   */
+  bool valid() const { return _bits != nullptr; }
+
+  /** @brief Exchange contents with @p o without copying rows. */
+  void swap(Pattern& o) noexcept;
+
+  /**
+   * @brief Change the size; stitches inside the overlap are kept, new ones are 0.
+   *
+   * A height-only change adds or drops rows at the bottom without copying.
+   *
+   * @return false if @p nw/@p nh are out of range or memory is exhausted
+   *         (the pattern is left unchanged).
+   */
+  bool resize(int nw, int nh);
+
+  /** @brief Clear all stitches (size unchanged). */
+  void clear();
+
+  /**
+   * @name Row operations
+   * Each returns false (pattern unchanged) if the range is invalid, the
+   * height would leave 1..@ref MAX_H or memory is exhausted.
+   */
+  ///@{
+  /** @brief Insert @p n empty rows before row @p at (@p at == h appends). */
+  bool insertRows(int at, int n);
+  /** @brief Delete rows [@p at, @p at + @p n); at least one row stays. */
+  bool removeRows(int at, int n);
+  /** @brief Insert a copy of rows [@p at, @p at + @p n) right after them. */
+  bool duplicateRows(int at, int n) { return repeatRows(at, n, 2); }
+  /** @brief Make rows [@p at, @p at + @p n) appear @p times times in a row. */
+  bool repeatRows(int at, int n, int times);
+  /** @brief Move rows [@p from, @p from + @p n) so the block starts at row @p to. */
+  bool moveRows(int from, int n, int to);
+  ///@}
+
+  /** @brief Words per packed row (stride of row()). */
+  int wordsPerRow() const { return _stride; }
+
+  /** @brief Packed words of row @p r (no bounds check). */
+  const uint32_t* row(int r) const { return _bits + _order[r] * _stride; }
+  /** @brief Mutable packed words of row @p r. Keep bits past @ref w at 0. */
+  uint32_t* row(int r) { return _bits + _order[r] * _stride; }
+
+  /** @brief Mask of valid bits in the last word of a row. */
+  uint32_t lastWordMask() const {
+    int rem = w % PATTERN_WORD_BITS;
+    return rem ? ((1u << rem) - 1u) : 0xFFFFFFFFu;
+  }
+
+  bool get(int r, int c) const {
+    return (row(r)[c / PATTERN_WORD_BITS] >> (c % PATTERN_WORD_BITS)) & 1u;
+  }
+
+  void set(int r, int c, bool v) {
+    uint32_t& word = row(r)[c / PATTERN_WORD_BITS];
+    uint32_t bit = 1u << (c % PATTERN_WORD_BITS);
+    if (v) word |= bit;
+    else word &= ~bit;
+  }
+
+private:
+  struct Empty {};
+  explicit Pattern(Empty) : w(0), h(0) {}  // no storage yet (alloc() follows)
+
+  bool alloc(int nw, int nh);
+  bool reserve(int n);
+  void clearRow(int r);
+
+  int _stride = 0;
+  int _cap = 0;                  // row slots allocated
+  uint32_t* _bits = nullptr;     // _cap slots of _stride words
+  uint16_t* _order = nullptr;    // row -> slot; entries [h, _cap) are free slots
 };
 
-/** @brief Serialize pattern to JSON string. */
+class RowSource;
+class RowFlags;
+
+/**
+ * @brief Stream pattern JSON to any Print sink (File, HTTP response, ...).
+ *
+ * Rows are expanded one at a time through a 64-byte buffer, so memory use
+ * does not depend on the pattern size.
+ *
+ * @return bytes written, or 0 if the sink accepted fewer bytes than offered.
+ */
+size_t writePatternJson(Print& out, const Pattern& p);
+
+/** @brief Same as above, pulling rows from any RowSource (e.g. a PatternWindow). */
+size_t writePatternJson(Print& out, RowSource& rows, const String& name);
+
+/**
+ * @brief Rows [@p first, @p last) of the output above, with the header when
+ *        @p first is 0 and the closing brackets when @p last is the height.
+ *
+ * Consecutive ranges add up to the whole document, so a response can be
+ * produced a few rows at a time.
+ */
+size_t writePatternJson(Print& out, RowSource& rows, const String& name, int first, int last);
+
+/**
+ * @brief The part of writePatternJson() output that precedes the first row.
+ *
+ * Row @c r of such a file starts at <tt>header.length() + r * (w + 3)</tt>
+ * (quoted row plus separator), so single rows can be rewritten in place.
+ */
+String patternJsonHeader(const Pattern& p);
+
+/** @brief Write one row as a quoted "0101..." string (exactly @p w + 2 bytes). */
+size_t writePatternJsonRow(Print& out, const uint32_t* words, int w);
+
+/** @brief Serialize pattern to JSON string (small patterns / debugging). */
 String patternToJson(const Pattern& p);
 /**
- *  * @brief Parse pattern JSON into @p out.
- *  * @return true on success, false if JSON is invalid or out of bounds.
- *  */
-bool jsonToPattern(const String& json, Pattern& out);
+ * @brief Parse pattern JSON from a memory range into @p out.
+ *
+ * Single pass, keys in any order, unknown keys skipped. Rows are written
+ * straight into @p out; its previous contents are undefined on failure,
+ * so parse into a scratch Pattern when the old one must survive.
+ *
+ * @return true on success, false if JSON is invalid or out of bounds.
+ */
+bool jsonToPattern(const char* json, size_t len, Pattern& out);
+
+/** @brief Parse pattern JSON read from @p in (e.g. a LittleFS File). */
+bool jsonToPattern(Stream& in, Pattern& out);
+
+/** @brief Parse pattern JSON held in a String. */
+inline bool jsonToPattern(const String& json, Pattern& out) {
+  return jsonToPattern(json.c_str(), json.length(), out);
+}
+
+/**
+ * @brief Incremental pattern JSON parser behind jsonToPattern().
+ *
+ * Bytes are pushed in pieces of any size, e.g. HTTP body chunks as they
+ * arrive, so a body never has to be held as text. Rows are written into the
+ * target Pattern as their strings end. With @p envelope the top level is
+ * @c {"file":"...","pattern":{...}} (the POST /api/pattern body) instead
+ * of the pattern object itself.
+ */
+class PatternJsonReader {
+public:
+  PatternJsonReader(Pattern& out, bool envelope = false) : _out(out), _envelope(envelope) {}
+
+  /**
+   * @brief Consume the next @p n bytes.
+   * @return false once the data is invalid or out of bounds; later calls
+   *         fail too. Bytes after the closing brace are ignored.
+   */
+  bool feed(const uint8_t* data, size_t n);
+
+  /** @brief True when the top-level object closed and held a valid pattern. */
+  bool done() const { return !_failed && _closed && _patternDone; }
+
+  /** @brief "file" of the envelope (empty if absent). */
+  const String& file() const { return _file; }
+
+private:
+  static constexpr int MAX_DEPTH = 16;
+
+  bool step(int c);
+  bool beginValue(int c);
+  bool endValue();
+  bool endContainer(int c);
+  bool stringByte(int c);
+  bool textByte(uint8_t b);
+  bool endString();
+  bool scalarByte(int c);
+  bool endScalar();
+  bool beginPixels();
+  bool reserveRow(int r);
+  bool endRow();
+  bool finish();
+
+  Pattern& _out;
+  bool _envelope;
+  String _file;
+
+  // Open containers: role | CONTAINER_OBJECT.
+  uint8_t _stack[MAX_DEPTH + 2];
+  int _depth = 0;
+  uint8_t _expect = 0;  // what may come next outside a token
+  uint8_t _token = 0;   // token being read
+  uint8_t _slot = 0;    // where the token's value goes
+  char _key[8];         // last object key (truncated)
+  char _text[64];       // key or name being read
+  uint8_t _textLen = 0;
+  uint8_t _esc = 0;     // escape state inside a string
+  uint32_t _cp = 0;     // \\u code point being read
+  long _num = 0;
+  bool _neg = false;
+  bool _digits = false;
+
+  int _declW = 0;  // "w" / "h" as given in the document
+  int _declH = 0;
+  int _w = 0;      // row width actually in use while reading pixels
+  int _rows = 0;
+  int _cap = 0;    // rows allocated in _out
+  int _col = 0;
+  uint32_t _row[(MAX_W + PATTERN_WORD_BITS - 1) / PATTERN_WORD_BITS];
+  bool _named = false;
+  bool _patternDone = false;
+  bool _closed = false;
+  bool _failed = false;
+};
+
+/**
+ * @brief Apply an edit patch to @p p in place (same size, no reallocation).
+ *
+ * @code
+ * {"w":12,"h":24,
+ *  "cells":[[row,col,0|1],...],
+ *  "rows":[{"r":first,"pixels":["0101...",...]},...]}
+ * @endcode
+ *
+ * @c cells sets single stitches, each @c rows entry replaces consecutive rows
+ * starting at @c r. @c w / @c h are optional guards against a stale editor.
+ * Unknown keys are skipped. The patch is validated completely before the
+ * first stitch is written.
+ *
+ * @param dirty if given (sized to @p p.h), rows touched by the patch are set.
+ * @return false if the JSON is invalid, out of bounds or the guards do not
+ *         match; @p p is then unchanged.
+ */
+bool applyPatternPatch(const char* json, size_t len, Pattern& p, RowFlags* dirty = nullptr);
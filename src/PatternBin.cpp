@@ -0,0 +1,514 @@
+/**
+ * @file PatternBin.cpp
+ * @brief Implementation of the binary pattern format (.kpb).
+ *
+ * Writing streams through a small buffer while accumulating the CRC, so it
+ * works with any Print sink. Reading either consumes the whole file
+ * sequentially (with CRC check) or seeks to single rows. The wire format
+ * for the browser shares the packed row codec.
+ */
+
+#include "PatternBin.h"
+#include "RowKernels.h"
+#include "RowFlags.h"
+#include "RowSource.h"
+
+static const uint8_t MAGIC[4] = { 'K', 'L', 'P', 'B' };
+static constexpr uint8_t VERSION = 1;
+static constexpr int HEADER_FIXED = 11;
+static constexpr int MAX_NAME = 63;
+
+// ------------------------------------------------------------
+// CRC-32 (IEEE 802.3, reflected), nibble table
+// ------------------------------------------------------------
+
+uint32_t patternCrc32(uint32_t crc, const uint8_t* data, size_t n) {
+  static const uint32_t T[16] = {
+    0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+    0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C,
+  };
+  crc = ~crc;
+  while (n--) {
+    crc ^= *data++;
+    crc = (crc >> 4) ^ T[crc & 15];
+    crc = (crc >> 4) ^ T[crc & 15];
+  }
+  return ~crc;
+}
+
+bool isPatternBin(const uint8_t* head, size_t n) {
+  return n >= 4 && memcmp(head, MAGIC, 4) == 0;
+}
+
+// ------------------------------------------------------------
+// Row codecs
+// ------------------------------------------------------------
+
+// First column >= from whose bit differs from v, or w.
+static int nextChange(const uint32_t* words, int w, int from, bool v) {
+  const uint32_t flip = v ? 0xFFFFFFFFu : 0u;
+  int wi = from / PATTERN_WORD_BITS;
+  uint32_t m = (words[wi] ^ flip) & (0xFFFFFFFFu << (from % PATTERN_WORD_BITS));
+  const int nw = patternWordsPerRow(w);
+  while (!m) {
+    if (++wi >= nw) return w;
+    m = words[wi] ^ flip;
+  }
+  int c = wi * PATTERN_WORD_BITS + __builtin_ctz(m);
+  return c < w ? c : w;
+}
+
+static int putVarint(uint8_t* dst, uint32_t v) {
+  int n = 0;
+  do {
+    uint8_t b = v & 0x7F;
+    v >>= 7;
+    dst[n++] = b | (v ? 0x80 : 0);
+  } while (v);
+  return n;
+}
+
+// RLE-encode one row into dst; returns length (at most ~w bytes).
+static int encodeRle(const uint32_t* words, int w, uint8_t* dst) {
+  int n = 0;
+  int c = 0;
+  bool v = false;
+  while (c < w) {
+    int e = nextChange(words, w, c, v);
+    n += putVarint(dst + n, (uint32_t)(e - c));
+    c = e;
+    v = !v;
+  }
+  return n;
+}
+
+static int encodePacked(const uint32_t* words, int w, uint8_t* dst) {
+  int bytes = (w + 7) / 8;
+  for (int k = 0; k < bytes; k++) dst[k] = (uint8_t)(words[k / 4] >> (8 * (k % 4)));
+  return bytes;
+}
+
+static void decodePacked(const uint8_t* src, int w, uint32_t* words) {
+  rowClear(words, w);
+  int bytes = (w + 7) / 8;
+  for (int k = 0; k < bytes; k++) words[k / 4] |= (uint32_t)src[k] << (8 * (k % 4));
+  rowMaskTail(words, w);
+}
+
+// Decodes one RLE record, pulling bytes from next() (returns -1 at end).
+// Records are self-delimiting: decoding stops once the runs cover w.
+template <class NextByte>
+static bool decodeRle(NextByte next, int w, uint32_t* words) {
+  rowClear(words, w);
+  int c = 0;
+  bool v = false;
+  while (c < w) {
+    uint32_t run = 0;
+    int shift = 0;
+    for (;;) {
+      int b = next();
+      if (b < 0 || shift > 28) return false;
+      run |= (uint32_t)(b & 0x7F) << shift;
+      shift += 7;
+      if (!(b & 0x80)) break;
+    }
+    if (run > (uint32_t)(w - c)) return false;
+    if (v) rowSetRange(words, c, c + run);
+    c += run;
+    v = !v;
+  }
+  return true;
+}
+
+// Largest record: RLE worst case is one varint (<= 2 bytes for w <= 256) per stitch.
+static constexpr int MAX_RECORD = 2 * MAX_W + 2;
+
+// ------------------------------------------------------------
+// Writer
+// ------------------------------------------------------------
+
+namespace {
+
+class BinEmitter {
+public:
+  explicit BinEmitter(Print& out, bool crc = true) : _out(out), _withCrc(crc) {}
+
+  void put(const uint8_t* b, size_t n) {
+    if (_withCrc) _crc = patternCrc32(_crc, b, n);
+    while (n) {
+      size_t k = min(n, sizeof(_buf) - _n);
+      memcpy(_buf + _n, b, k);
+      _n += k;
+      b += k;
+      n -= k;
+      if (_n == sizeof(_buf)) flush();
+    }
+  }
+
+  void put8(uint8_t v) { put(&v, 1); }
+  void put16(uint16_t v) { uint8_t b[2] = { (uint8_t)v, (uint8_t)(v >> 8) }; put(b, 2); }
+  void put32(uint32_t v) {
+    uint8_t b[4] = { (uint8_t)v, (uint8_t)(v >> 8), (uint8_t)(v >> 16), (uint8_t)(v >> 24) };
+    put(b, 4);
+  }
+
+  // Appends the CRC (if kept) and flushes.
+  size_t finish() {
+    if (_withCrc) {
+      uint32_t crc = _crc;
+      put32(crc);
+    }
+    flush();
+    return _failed ? 0 : _total;
+  }
+
+private:
+  void flush() {
+    if (!_n) return;
+    size_t wrote = _out.write(_buf, _n);
+    if (wrote != _n) _failed = true;
+    _total += wrote;
+    _n = 0;
+  }
+
+  Print& _out;
+  uint8_t _buf[128];
+  size_t _n = 0;
+  size_t _total = 0;
+  uint32_t _crc = 0;
+  bool _withCrc;
+  bool _failed = false;
+};
+
+}  // namespace
+
+size_t writePatternBin(Print& out, const Pattern& p) {
+  uint8_t rec[MAX_RECORD];
+  const int packedBytes = (p.w + 7) / 8;
+
+  // Pick the smaller encoding (RLE pays for its offset table).
+  size_t rleTotal = 4u * (p.h + 1);
+  for (int r = 0; r < p.h; r++) rleTotal += encodeRle(p.row(r), p.w, rec);
+  const bool rle = rleTotal < (size_t)p.h * packedBytes;
+
+  int nameLen = min((int)p.name.length(), MAX_NAME);
+
+  BinEmitter e(out);
+  e.put(MAGIC, 4);
+  e.put8(VERSION);
+  e.put8(rle ? PATTERN_BIN_RLE : PATTERN_BIN_PACKED);
+  e.put16(p.w);
+  e.put16(p.h);
+  e.put8(nameLen);
+  e.put((const uint8_t*)p.name.c_str(), nameLen);
+
+  if (rle) {
+    uint32_t off = HEADER_FIXED + nameLen + 4u * (p.h + 1);
+    e.put32(off);
+    for (int r = 0; r < p.h; r++) {
+      off += encodeRle(p.row(r), p.w, rec);
+      e.put32(off);
+    }
+    for (int r = 0; r < p.h; r++) e.put(rec, encodeRle(p.row(r), p.w, rec));
+  } else {
+    for (int r = 0; r < p.h; r++) e.put(rec, encodePacked(p.row(r), p.w, rec));
+  }
+  return e.finish();
+}
+
+// ------------------------------------------------------------
+// Readers
+// ------------------------------------------------------------
+
+static uint16_t le16(const uint8_t* b) { return b[0] | (b[1] << 8); }
+static uint32_t le32(const uint8_t* b) {
+  return (uint32_t)b[0] | ((uint32_t)b[1] << 8) | ((uint32_t)b[2] << 16) | ((uint32_t)b[3] << 24);
+}
+
+// Parses the fixed header + name from a sequential reader.
+template <class ReadFn>
+static bool parseHeader(ReadFn read, PatternBinHeader& hdr) {
+  uint8_t fixed[HEADER_FIXED];
+  if (!read(fixed, HEADER_FIXED)) return false;
+  if (!isPatternBin(fixed, 4) || fixed[4] != VERSION) return false;
+  if (fixed[5] != PATTERN_BIN_PACKED && fixed[5] != PATTERN_BIN_RLE) return false;
+
+  hdr.encoding = fixed[5];
+  hdr.w = le16(fixed + 6);
+  hdr.h = le16(fixed + 8);
+  if (hdr.w < 1 || hdr.w > MAX_W || hdr.h < 1 || hdr.h > MAX_FILE_H) return false;
+
+  int nameLen = fixed[10];
+  if (nameLen > MAX_NAME) return false;
+  char name[MAX_NAME + 1];
+  if (!read((uint8_t*)name, nameLen)) return false;
+  name[nameLen] = 0;
+  hdr.name = name;
+
+  uint32_t after = HEADER_FIXED + nameLen;
+  if (hdr.encoding == PATTERN_BIN_RLE) {
+    hdr.tableOffset = after;
+    hdr.dataOffset = after + 4u * (hdr.h + 1);
+  } else {
+    hdr.tableOffset = 0;
+    hdr.dataOffset = after;
+  }
+  return true;
+}
+
+namespace {
+
+// Buffered sequential reader that keeps a running CRC of consumed bytes.
+struct BinSource {
+  Stream& in;
+  uint8_t buf[128];
+  size_t len = 0;
+  size_t pos = 0;
+  uint32_t crc = 0;
+  uint32_t consumed = 0;
+
+  explicit BinSource(Stream& s) : in(s) {}
+
+  int get() {
+    if (pos == len) {
+      crc = patternCrc32(crc, buf, len);
+      len = in.readBytes((char*)buf, sizeof(buf));
+      pos = 0;
+      if (len == 0) return -1;
+    }
+    consumed++;
+    return buf[pos++];
+  }
+
+  bool read(uint8_t* b, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+      int c = get();
+      if (c < 0) return false;
+      b[i] = (uint8_t)c;
+    }
+    return true;
+  }
+
+  // CRC of everything consumed so far.
+  uint32_t crcSoFar() const { return patternCrc32(crc, buf, pos); }
+};
+
+}  // namespace
+
+// Reads the row records and the CRC after the header; row(r) gives the
+// words to decode row r into.
+template <class RowFn>
+static bool readBinBody(BinSource& src, const PatternBinHeader& hdr, RowFn row) {
+  if (hdr.encoding == PATTERN_BIN_PACKED) {
+    uint8_t rec[(MAX_W + 7) / 8];
+    const int bytes = hdr.packedRowBytes();
+    for (int r = 0; r < hdr.h; r++) {
+      if (!src.read(rec, bytes)) return false;
+      decodePacked(rec, hdr.w, row(r));
+    }
+  } else {
+    // Records are self-delimiting, so a sequential load only needs the
+    // table's first and last entries to check the record area's bounds.
+    uint8_t b4[4];
+    uint32_t first = 0, last = 0;
+    for (int i = 0; i <= hdr.h; i++) {
+      if (!src.read(b4, 4)) return false;
+      uint32_t off = le32(b4);
+      if (i == 0) first = off;
+      else if (off < last) return false;
+      last = off;
+    }
+    if (first != hdr.dataOffset) return false;
+
+    auto next = [&]() -> int { return src.get(); };
+    for (int r = 0; r < hdr.h; r++) {
+      if (!decodeRle(next, hdr.w, row(r))) return false;
+    }
+    if (src.consumed != last) return false;
+  }
+
+  uint32_t crc = src.crcSoFar();
+  uint8_t c4[4];
+  if (!src.read(c4, 4)) return false;
+  return le32(c4) == crc;
+}
+
+bool readPatternBin(Stream& in, Pattern& out) {
+  BinSource src(in);
+  auto read = [&](uint8_t* b, size_t n) -> bool { return src.read(b, n); };
+
+  PatternBinHeader hdr;
+  if (!parseHeader(read, hdr)) return false;
+  if (!out.resize(hdr.w, hdr.h)) return false;
+  out.name = hdr.name;
+  return readBinBody(src, hdr, [&](int r) { return out.row(r); });
+}
+
+// Every row goes through the same one-row buffer.
+bool verifyPatternBin(Stream& in, PatternBinHeader& hdr) {
+  BinSource src(in);
+  auto read = [&](uint8_t* b, size_t n) -> bool { return src.read(b, n); };
+
+  if (!parseHeader(read, hdr)) return false;
+  uint32_t words[(MAX_W + PATTERN_WORD_BITS - 1) / PATTERN_WORD_BITS];
+  return readBinBody(src, hdr, [&](int) { return words; });
+}
+
+bool readPatternBinHeader(fs::File& f, PatternBinHeader& hdr) {
+  if (!f.seek(0)) return false;
+  auto read = [&](uint8_t* b, size_t n) -> bool {
+    return n == 0 || f.read(b, n) == n;
+  };
+  return parseHeader(read, hdr);
+}
+
+bool readPatternBinRow(fs::File& f, const PatternBinHeader& hdr, int r, uint32_t* words) {
+  if (r < 0 || r >= hdr.h) return false;
+  uint8_t rec[MAX_RECORD];
+
+  if (hdr.encoding == PATTERN_BIN_PACKED) {
+    const int bytes = hdr.packedRowBytes();
+    if (!f.seek(hdr.dataOffset + (uint32_t)r * bytes)) return false;
+    if (f.read(rec, bytes) != (size_t)bytes) return false;
+    decodePacked(rec, hdr.w, words);
+    return true;
+  }
+
+  uint8_t b8[8];
+  if (!f.seek(hdr.tableOffset + 4u * r)) return false;
+  if (f.read(b8, 8) != 8) return false;
+  uint32_t a = le32(b8);
+  uint32_t b = le32(b8 + 4);
+  if (b < a || b - a > (uint32_t)MAX_RECORD) return false;
+  if (!f.seek(a)) return false;
+  size_t len = b - a;
+  if (f.read(rec, len) != len) return false;
+
+  size_t i = 0;
+  auto next = [&]() -> int { return i < len ? rec[i++] : -1; };
+  return decodeRle(next, hdr.w, words) && i == len;
+}
+
+bool writePatternBinRows(fs::File& f, const PatternBinHeader& hdr, const Pattern& p, const RowFlags& rows) {
+  if (hdr.encoding != PATTERN_BIN_PACKED || hdr.w != p.w || hdr.h != p.h) return false;
+  const int bytes = hdr.packedRowBytes();
+  const uint32_t end = hdr.dataOffset + (uint32_t)hdr.h * bytes;
+  if (f.size() != end + 4) return false;
+
+  uint8_t rec[(MAX_W + 7) / 8];
+  for (int r = 0; r < hdr.h; r++) {
+    if (!rows.get(r)) continue;
+    encodePacked(p.row(r), p.w, rec);
+    if (!f.seek(hdr.dataOffset + (uint32_t)r * bytes)) return false;
+    if (f.write(rec, bytes) != (size_t)bytes) return false;
+  }
+
+  // Re-read to update the CRC; only the 4-byte trailer is written.
+  if (!f.seek(0)) return false;
+  uint32_t crc = 0;
+  uint8_t buf[128];
+  for (uint32_t off = 0; off < end;) {
+    size_t k = min((uint32_t)sizeof(buf), end - off);
+    if (f.read(buf, k) != k) return false;
+    crc = patternCrc32(crc, buf, k);
+    off += k;
+  }
+  uint8_t c4[4] = { (uint8_t)crc, (uint8_t)(crc >> 8), (uint8_t)(crc >> 16), (uint8_t)(crc >> 24) };
+  return f.seek(end) && f.write(c4, 4) == 4;
+}
+
+// ------------------------------------------------------------
+// Wire format
+// ------------------------------------------------------------
+
+static const uint8_t WIRE_MAGIC[4] = { 'K', 'L', 'P', 'W' };
+static constexpr int WIRE_FIXED = 20;
+static constexpr int MAX_FILE = 255;
+
+size_t writePatternWire(Print& out, RowSource& rows, const String& name, const PatternWireInfo& info,
+                        int first, int last) {
+  const int w = rows.width();
+  const int h = rows.height();
+
+  BinEmitter e(out, false);
+  if (first == 0) {
+    int nameLen = min((int)name.length(), MAX_NAME);
+    int fileLen = min((int)info.file.length(), MAX_FILE);
+    e.put(WIRE_MAGIC, 4);
+    e.put8(VERSION);
+    e.put8(nameLen);
+    e.put8(fileLen);
+    e.put8(0);
+    e.put16(w);
+    e.put16(h);
+    e.put32((uint32_t)info.activeRow);
+    e.put32((uint32_t)info.patternRow);
+    e.put((const uint8_t*)name.c_str(), nameLen);
+    e.put((const uint8_t*)info.file.c_str(), fileLen);
+  }
+
+  uint8_t rec[(MAX_W + 7) / 8];
+  for (int r = first; r < last; r++) e.put(rec, encodePacked(rows.row(r), w, rec));
+  return e.finish();
+}
+
+size_t writePatternWire(Print& out, RowSource& rows, const String& name, const PatternWireInfo& info) {
+  return writePatternWire(out, rows, name, info, 0, rows.height());
+}
+
+bool PatternWireReader::parseHeader() {
+  const uint8_t* b = _head;
+  if (memcmp(b, WIRE_MAGIC, 4) != 0 || b[4] != VERSION) return false;
+  int nameLen = b[5];
+  int fileLen = b[6];
+  if (nameLen > MAX_NAME) return false;
+  if (_headNeed == WIRE_FIXED && nameLen + fileLen) {
+    _headNeed = WIRE_FIXED + nameLen + fileLen;  // fetch the strings first
+    return true;
+  }
+
+  int w = le16(b + 8);
+  int h = le16(b + 10);
+  if (w < 1 || w > MAX_W || h < 1 || h > MAX_H) return false;
+  if (!_p.resize(w, h)) return false;
+
+  _info.activeRow = (int32_t)le32(b + 12);
+  _info.patternRow = (int32_t)le32(b + 16);
+  _p.name = String();
+  _p.name.concat((const char*)b + WIRE_FIXED, nameLen);
+  _info.file = String();
+  _info.file.concat((const char*)b + WIRE_FIXED + nameLen, fileLen);
+  _headerDone = true;
+  return true;
+}
+
+bool PatternWireReader::feed(const uint8_t* data, size_t n) {
+  while (n && !_failed) {
+    if (!_headerDone) {
+      size_t k = min(n, _headNeed - _headLen);
+      memcpy(_head + _headLen, data, k);
+      _headLen += k;
+      data += k;
+      n -= k;
+      if (_headLen == _headNeed && !parseHeader()) _failed = true;
+      continue;
+    }
+
+    // Bytes past the last row make the upload invalid.
+    if (_row == _p.h) {
+      _failed = true;
+      break;
+    }
+    const int bytes = (_p.w + 7) / 8;
+    size_t k = min(n, (size_t)(bytes - _recLen));
+    memcpy(_rec + _recLen, data, k);
+    _recLen += k;
+    data += k;
+    n -= k;
+    if (_recLen == bytes) {
+      decodePacked(_rec, _p.w, _p.row(_row++));
+      _recLen = 0;
+    }
+  }
+  return !_failed;
+}
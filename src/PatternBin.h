@@ -0,0 +1,205 @@
+/**
+ * @file PatternBin.h
+ * @brief Compact binary pattern file format (.kpb).
+ *
+ * A bit-packed alternative to the JSON files, about 8x smaller for typical
+ * widths and seekable per row. All integers are little-endian.
+ *
+ * | Offset | Size | Field |
+ * |---|---|---|
+ * | 0 | 4 | magic `KLPB` |
+ * | 4 | 1 | version (1) |
+ * | 5 | 1 | row encoding: 0 = packed, 1 = RLE |
+ * | 6 | 2 | width `w` |
+ * | 8 | 2 | height `h` |
+ * | 10 | 1 | name length `n` (0..63) |
+ * | 11 | n | name (UTF-8, no terminator) |
+ * | 11+n | 4·(h+1) | RLE only: row offset table (absolute, last entry = end of rows) |
+ * | ... | ... | row records |
+ * | end-4 | 4 | CRC-32 (IEEE) of all preceding bytes |
+ *
+ * Packed rows are `ceil(w/8)` bytes, column @c c at byte @c c/8, bit @c c%8.
+ * RLE rows are alternating run lengths (LEB128 varints) starting with a run
+ * of 0s, summing to @c w. The writer picks RLE only when it is smaller.
+ */
+
+#pragma once
+#include <Arduino.h>
+#include <FS.h>
+#include "Pattern.h"
+
+class RowFlags;
+class RowSource;
+
+/**
+ * @brief Largest height a binary file may declare.
+ *
+ * The same as @ref MAX_H, so every stored file can be loaded for editing
+ * and sent back by the browser. Tall files are still knitted row by row
+ * through PatternWindow rather than loaded; longer pieces come from
+ * tiling (see PatternViews.h).
+ */
+static constexpr int MAX_FILE_H = MAX_H;
+
+/** @brief File extension used for binary pattern files. */
+static constexpr const char* PATTERN_BIN_EXT = ".kpb";
+
+/** @brief Row record encodings. */
+enum PatternBinEncoding : uint8_t {
+  PATTERN_BIN_PACKED = 0,
+  PATTERN_BIN_RLE = 1,
+};
+
+/**
+ * @brief Parsed header of a binary pattern file (what a row seek needs).
+ */
+struct PatternBinHeader {
+  uint16_t w = 0;
+  uint16_t h = 0;
+  uint8_t encoding = PATTERN_BIN_PACKED;
+  String name;
+  uint32_t tableOffset = 0;  /**< @brief RLE offset table position (0 if packed). */
+  uint32_t dataOffset = 0;   /**< @brief First row record. */
+
+  /** @brief Bytes per packed row record. */
+  int packedRowBytes() const { return (w + 7) / 8; }
+};
+
+/** @brief True if @p head (at least 4 bytes) starts with the binary magic. */
+bool isPatternBin(const uint8_t* head, size_t n);
+
+/** @brief Update a running CRC-32 (start with 0). */
+uint32_t patternCrc32(uint32_t crc, const uint8_t* data, size_t n);
+
+/**
+ * @brief Write @p p in binary form to @p out.
+ * @return bytes written, or 0 on a short write.
+ */
+size_t writePatternBin(Print& out, const Pattern& p);
+
+/**
+ * @brief Read a whole binary pattern sequentially and verify its CRC.
+ * @return false on bad magic/version/size, corrupt rows or CRC mismatch.
+ */
+bool readPatternBin(Stream& in, Pattern& out);
+
+/**
+ * @brief Check a whole binary pattern like readPatternBin() without loading it.
+ *
+ * Rows are decoded one at a time into a stack buffer, so files knitted
+ * through a PatternWindow are checked without being held in RAM.
+ * @param hdr Receives the header.
+ * @return false on bad magic/version/size, corrupt rows or CRC mismatch.
+ */
+bool verifyPatternBin(Stream& in, PatternBinHeader& hdr);
+
+/** @brief Read and validate just the header; leaves @p f after it. */
+bool readPatternBinHeader(fs::File& f, PatternBinHeader& hdr);
+
+/**
+ * @brief Seek to and decode row @p r into @p words (patternWordsPerRow(w) words).
+ *
+ * Costs one seek and one record read (plus one table read for RLE).
+ * The file CRC is not checked here; verify once with readPatternBin() or
+ * verifyPatternBin().
+ */
+bool readPatternBinRow(fs::File& f, const PatternBinHeader& hdr, int r, uint32_t* words);
+
+/**
+ * @brief Rewrite the rows flagged in @p rows in place and update the CRC.
+ *
+ * @p f must be open for update ("r+") and hold a packed file of @p p's size
+ * whose other rows already match @p p. RLE files have variable-length
+ * records and are refused; rewrite those with writePatternBin().
+ *
+ * @return false if the file does not qualify or a write failed.
+ */
+bool writePatternBinRows(fs::File& f, const PatternBinHeader& hdr, const Pattern& p, const RowFlags& rows);
+
+// ------------------------------------------------------------
+// Wire format (/api/pattern.bin)
+// ------------------------------------------------------------
+
+/**
+ * @brief Content-Type of the wire format.
+ *
+ * The browser editor loads and saves patterns in this form: the same packed
+ * rows as a .kpb file behind a fixed header, so the page can use the row
+ * bytes as a typed array without parsing. No CRC (TCP already checks).
+ * All integers are little-endian.
+ *
+ * | Offset | Size | Field |
+ * |---|---|---|
+ * | 0 | 4 | magic `KLPW` |
+ * | 4 | 1 | version (1) |
+ * | 5 | 1 | name length `n` (0..63) |
+ * | 6 | 1 | file length `f` (0..255) |
+ * | 7 | 1 | reserved (0) |
+ * | 8 | 2 | width `w` |
+ * | 10 | 2 | height `h` |
+ * | 12 | 4 | active row (signed; -1 in uploads) |
+ * | 16 | 4 | pattern row (signed; -1 in uploads) |
+ * | 20 | n | name (UTF-8) |
+ * | 20+n | f | file path |
+ * | 20+n+f | h·ceil(w/8) | packed rows, column @c c at byte @c c/8, bit @c c%8 |
+ */
+static constexpr const char* PATTERN_WIRE_TYPE = "application/x-knittled-pattern";
+
+/** @brief Wire header fields besides the pattern itself. */
+struct PatternWireInfo {
+  String file;
+  int32_t activeRow = -1;
+  int32_t patternRow = -1;
+};
+
+/**
+ * @brief Write @p rows in wire form to @p out.
+ * @return bytes written, or 0 on a short write.
+ */
+size_t writePatternWire(Print& out, RowSource& rows, const String& name, const PatternWireInfo& info);
+
+/**
+ * @brief Rows [@p first, @p last) of the output above, with the header when
+ *        @p first is 0; consecutive ranges add up to the whole body.
+ */
+size_t writePatternWire(Print& out, RowSource& rows, const String& name, const PatternWireInfo& info,
+                        int first, int last);
+
+/**
+ * @brief Incremental wire format decoder for uploads that arrive in pieces.
+ *
+ * Rows are decoded straight into a Pattern as they come in; nothing but the
+ * header and one partial row is buffered.
+ */
+class PatternWireReader {
+public:
+  /**
+   * @brief Consume the next @p n bytes.
+   * @return false once the data is invalid (bad header, size out of range,
+   *         out of memory or bytes past the last row); later calls fail too.
+   */
+  bool feed(const uint8_t* data, size_t n);
+
+  /** @brief True when a valid header and all rows have been read. */
+  bool done() const { return !_failed && _headerDone && _row == _p.h; }
+
+  /** @brief File path from the header. */
+  const String& file() const { return _info.file; }
+
+  /** @brief Decoded pattern (complete once done()). */
+  Pattern& pattern() { return _p; }
+
+private:
+  bool parseHeader();
+
+  Pattern _p;
+  PatternWireInfo _info;
+  uint8_t _head[20 + 63 + 255];
+  size_t _headLen = 0;
+  size_t _headNeed = 20;
+  uint8_t _rec[(MAX_W + 7) / 8];
+  int _recLen = 0;
+  int _row = 0;
+  bool _headerDone = false;
+  bool _failed = false;
+};
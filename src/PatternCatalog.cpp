@@ -0,0 +1,359 @@
+/**
+ * @file PatternCatalog.cpp
+ * @brief Pattern file index kept as an append-only log on LittleFS.
+ */
+
+#include "PatternCatalog.h"
+#include "PatternBin.h"
+#include <LittleFS.h>
+#include <algorithm>
+
+static constexpr const char* PATTERN_DIR = "/patterns";
+static constexpr uint16_t VERSION = 1;
+static constexpr int REC = 20;  // fixed part of a record
+static constexpr int MAX_PATH_LEN = 255;
+static constexpr int MAX_NAME = 63;
+
+enum : uint8_t {
+  REC_HEADER = 'H',  // w = version, mod = change counter
+  REC_UPDATE = 'U',  // whole entry
+  REC_DELETE = 'D',  // path, mod
+};
+
+static uint16_t le16(const uint8_t* b) { return b[0] | (b[1] << 8); }
+static uint32_t le32(const uint8_t* b) {
+  return (uint32_t)b[0] | ((uint32_t)b[1] << 8) | ((uint32_t)b[2] << 16) | ((uint32_t)b[3] << 24);
+}
+static void put16(uint8_t* b, uint16_t v) { b[0] = (uint8_t)v; b[1] = (uint8_t)(v >> 8); }
+static void put32(uint8_t* b, uint32_t v) {
+  for (int i = 0; i < 4; i++) b[i] = (uint8_t)(v >> (8 * i));
+}
+
+// Encodes one record into out (REC + MAX_PATH_LEN + MAX_NAME bytes); returns its length.
+static size_t encode(uint8_t type, const CatalogEntry& e, uint8_t* out) {
+  size_t p = min((size_t)e.path.length(), (size_t)MAX_PATH_LEN);
+  size_t n = min((size_t)e.name.length(), (size_t)MAX_NAME);
+  out[0] = type;
+  out[2] = (uint8_t)p;
+  out[3] = (uint8_t)n;
+  put16(out + 4, e.w);
+  put16(out + 6, e.h);
+  put32(out + 8, e.bytes);
+  put32(out + 12, e.mod);
+  put32(out + 16, e.hash);
+  memcpy(out + REC, e.path.c_str(), p);
+  memcpy(out + REC + p, e.name.c_str(), n);
+  RecordLog::seal(out, REC + p + n);
+  return REC + p + n;
+}
+
+// ------------------------------------------------------------
+// Content hash
+// ------------------------------------------------------------
+
+namespace {
+
+// CRC-32 over the size and the packed rows (bits past w are 0 in both
+// Pattern rows and decoded file rows), independent of name and format.
+struct ContentHash {
+  uint32_t crc = 0;
+
+  void begin(int w, int h) {
+    uint8_t b[4];
+    put16(b, (uint16_t)w);
+    put16(b + 2, (uint16_t)h);
+    crc = patternCrc32(0, b, 4);
+  }
+
+  void row(const uint32_t* words, int w) {
+    uint8_t b[4];
+    for (int k = 0; k < patternWordsPerRow(w); k++) {
+      put32(b, words[k]);
+      crc = patternCrc32(crc, b, 4);
+    }
+  }
+};
+
+}  // namespace
+
+static uint32_t hashPattern(const Pattern& p) {
+  ContentHash hash;
+  hash.begin(p.w, p.h);
+  for (int r = 0; r < p.h; r++) hash.row(p.row(r), p.w);
+  return hash.crc;
+}
+
+// Reads path for its entry. Binary files are read row by row, so tall ones
+// that never fit a Pattern are described too. Unreadable files get w = 0.
+static bool scanFile(const String& path, CatalogEntry& e) {
+  File f = LittleFS.open(path, "r");
+  if (!f) return false;
+  e.path = path;
+  e.bytes = f.size();
+  e.name = String();
+  e.w = e.h = 0;
+  e.hash = 0;
+
+  uint8_t head[4];
+  size_t n = f.read(head, sizeof(head));
+  PatternBinHeader hdr;
+  if (isPatternBin(head, n)) {
+    if (readPatternBinHeader(f, hdr)) {
+      uint32_t words[MAX_W / PATTERN_WORD_BITS];
+      ContentHash hash;
+      hash.begin(hdr.w, hdr.h);
+      int r = 0;
+      for (; r < hdr.h && readPatternBinRow(f, hdr, r, words); r++) hash.row(words, hdr.w);
+      if (r == hdr.h) {
+        e.name = hdr.name;
+        e.w = hdr.w;
+        e.h = hdr.h;
+        e.hash = hash.crc;
+      }
+    }
+  } else {
+    Pattern p;
+    f.seek(0);
+    if (jsonToPattern(f, p)) {
+      e.name = p.name;
+      e.w = p.w;
+      e.h = p.h;
+      e.hash = hashPattern(p);
+    }
+  }
+  f.close();
+  return true;
+}
+
+// ------------------------------------------------------------
+// Index
+// ------------------------------------------------------------
+
+int PatternCatalog::search(const String& path) const {
+  auto it = std::lower_bound(_entries.begin(), _entries.end(), path,
+                             [](const CatalogEntry& e, const String& p) { return strcmp(e.path.c_str(), p.c_str()) < 0; });
+  if (it == _entries.end() || it->path != path) return -1;
+  return (int)(it - _entries.begin());
+}
+
+void PatternCatalog::put(const CatalogEntry& e) {
+  auto it = std::lower_bound(_entries.begin(), _entries.end(), e.path,
+                             [](const CatalogEntry& a, const String& p) { return strcmp(a.path.c_str(), p.c_str()) < 0; });
+  if (it != _entries.end() && it->path == e.path) *it = e;
+  else _entries.insert(it, e);
+  changed();
+}
+
+void PatternCatalog::changed() {
+  _sorted = false;
+}
+
+void PatternCatalog::load() {
+  if (_loaded) return;
+  _loaded = true;
+
+  bool found = false;
+  uint8_t buf[REC + MAX_PATH_LEN + MAX_NAME];
+  auto tail = [](const uint8_t* head) { return head[3] > MAX_NAME ? -1 : head[2] + head[3]; };
+  bool whole = _log.replay(buf, REC, tail, [&](const uint8_t* rec, size_t) {
+    size_t p = rec[2];
+    size_t n = rec[3];
+    CatalogEntry e;
+    e.path.concat((const char*)rec + REC, p);
+    e.name.concat((const char*)rec + REC + p, n);
+    e.w = le16(rec + 4);
+    e.h = le16(rec + 6);
+    e.bytes = le32(rec + 8);
+    e.mod = le32(rec + 12);
+    e.hash = le32(rec + 16);
+
+    if (!found) {
+      if (rec[0] != REC_HEADER || e.w != VERSION) return false;
+      found = true;
+    } else if (rec[0] == REC_UPDATE) {
+      put(e);
+    } else if (rec[0] == REC_DELETE) {
+      int i = search(e.path);
+      if (i >= 0) _entries.erase(_entries.begin() + i);
+    } else {
+      return false;
+    }
+    _mod = max(_mod, e.mod);
+    return true;
+  });
+
+  // A damaged tail would hide later appends, so it is compacted away too.
+  bool changedFiles = reconcile();
+  if (!found || !whole || changedFiles || _log.due()) compact();
+  changed();
+}
+
+// One pass over the directory: files the log does not know (or knows with
+// another size) are scanned, entries without a file are dropped.
+bool PatternCatalog::reconcile() {
+  std::vector<String> present;
+  bool any = false;
+
+  File dir = LittleFS.open(PATTERN_DIR);
+  if (dir && dir.isDirectory()) {
+    File f = dir.openNextFile();
+    while (f) {
+      if (!f.isDirectory()) {
+        String base = f.name();
+        int s = base.lastIndexOf('/');
+        if (s >= 0) base = base.substring(s + 1);
+        String path = String(PATTERN_DIR) + "/" + base;
+        uint32_t bytes = f.size();
+        f.close();
+
+        present.push_back(path);
+        int i = search(path);
+        if (i < 0 || _entries[i].bytes != bytes) {
+          CatalogEntry e;
+          if (scanFile(path, e)) {
+            e.mod = ++_mod;
+            put(e);
+            any = true;
+          }
+        }
+      }
+      f = dir.openNextFile();
+    }
+  }
+
+  std::sort(present.begin(), present.end(), [](const String& a, const String& b) { return strcmp(a.c_str(), b.c_str()) < 0; });
+  for (size_t i = _entries.size(); i-- > 0;) {
+    const String& path = _entries[i].path;
+    if (!std::binary_search(present.begin(), present.end(), path,
+                            [](const String& a, const String& b) { return strcmp(a.c_str(), b.c_str()) < 0; })) {
+      _entries.erase(_entries.begin() + i);
+      any = true;
+    }
+  }
+  if (any) _mod++;
+  return any;
+}
+
+void PatternCatalog::append(uint8_t type, const CatalogEntry& e) {
+  uint8_t rec[REC + MAX_PATH_LEN + MAX_NAME];
+  _log.append(rec, encode(type, e, rec));
+  if (_log.due()) compact();
+}
+
+// Writes all entries as a new log and swaps it in.
+bool PatternCatalog::compact() {
+  return _log.compact([this](File& f) {
+    uint8_t rec[REC + MAX_PATH_LEN + MAX_NAME];
+    size_t bytes = 0;
+    CatalogEntry header;
+    header.w = VERSION;
+    header.mod = _mod;
+    bytes += f.write(rec, encode(REC_HEADER, header, rec));
+    for (const CatalogEntry& e : _entries) bytes += f.write(rec, encode(REC_UPDATE, e, rec));
+    return bytes;
+  });
+}
+
+// ------------------------------------------------------------
+// Public API
+// ------------------------------------------------------------
+
+void PatternCatalog::update(const String& path, const Pattern& p, uint32_t bytes) {
+  load();
+  CatalogEntry e;
+  e.path = path;
+  e.name = p.name;
+  e.w = p.w;
+  e.h = p.h;
+  e.bytes = bytes;
+  e.hash = hashPattern(p);
+  e.mod = ++_mod;
+  put(e);
+  append(REC_UPDATE, e);
+}
+
+void PatternCatalog::update(const String& path) {
+  load();
+  CatalogEntry e;
+  if (!scanFile(path, e)) {
+    remove(path);
+    return;
+  }
+  e.mod = ++_mod;
+  put(e);
+  append(REC_UPDATE, e);
+}
+
+void PatternCatalog::remove(const String& path) {
+  load();
+  int i = search(path);
+  if (i < 0) return;
+  _entries.erase(_entries.begin() + i);
+  changed();
+
+  CatalogEntry e;
+  e.path = path;
+  e.mod = ++_mod;
+  append(REC_DELETE, e);
+}
+
+int PatternCatalog::count() {
+  load();
+  return (int)_entries.size();
+}
+
+uint32_t PatternCatalog::mod() {
+  load();
+  return _mod;
+}
+
+int PatternCatalog::indexOf(const String& path) {
+  load();
+  return search(path);
+}
+
+const std::vector<uint16_t>& PatternCatalog::order(Sort sort) {
+  load();
+  if (!_sorted) {
+    const std::vector<CatalogEntry>& E = _entries;
+    std::vector<uint16_t> ids(E.size());
+    for (size_t i = 0; i < ids.size(); i++) ids[i] = (uint16_t)i;
+
+    // Ties fall back to the path (the entry index), so pages are stable.
+    _orders[SORT_PATH] = ids;
+    _orders[SORT_NAME] = ids;
+    std::sort(_orders[SORT_NAME].begin(), _orders[SORT_NAME].end(), [&E](uint16_t a, uint16_t b) {
+      int c = strcasecmp(E[a].name.c_str(), E[b].name.c_str());
+      return c ? c < 0 : a < b;
+    });
+    _orders[SORT_SIZE] = ids;
+    std::sort(_orders[SORT_SIZE].begin(), _orders[SORT_SIZE].end(), [&E](uint16_t a, uint16_t b) {
+      return E[a].bytes != E[b].bytes ? E[a].bytes < E[b].bytes : a < b;
+    });
+    _orders[SORT_MOD] = ids;
+    std::sort(_orders[SORT_MOD].begin(), _orders[SORT_MOD].end(), [&E](uint16_t a, uint16_t b) {
+      return E[a].mod != E[b].mod ? E[a].mod < E[b].mod : a < b;
+    });
+    _byHash = ids;
+    std::sort(_byHash.begin(), _byHash.end(), [&E](uint16_t a, uint16_t b) {
+      return E[a].hash != E[b].hash ? E[a].hash < E[b].hash : a < b;
+    });
+    _sorted = true;
+  }
+  return _orders[sort];
+}
+
+const CatalogEntry* PatternCatalog::duplicateOf(int i) {
+  order(SORT_PATH);  // sorts _byHash too
+  const CatalogEntry& e = _entries[i];
+  if (!e.valid()) return nullptr;
+
+  const std::vector<CatalogEntry>& E = _entries;
+  auto it = std::lower_bound(_byHash.begin(), _byHash.end(), e.hash,
+                             [&E](uint16_t a, uint32_t h) { return E[a].hash < h; });
+  for (; it != _byHash.end() && E[*it].hash == e.hash; ++it) {
+    const CatalogEntry& o = E[*it];
+    if ((int)*it != i && o.valid() && o.w == e.w && o.h == e.h) return &o;
+  }
+  return nullptr;
+}
@@ -0,0 +1,120 @@
+/**
+ * @file PatternCatalog.h
+ * @brief Persistent index of the stored pattern files for @c /api/files.
+ *
+ * Listing used to walk @c /patterns with openNextFile() on every request and
+ * could only return paths; the page had to load a file to learn its size.
+ * The catalog keeps one entry per file (pattern name, width and height, file
+ * size, change counter, content hash) in RAM, sorted by path, and on flash as an
+ * append-only RecordLog like StateJournal: every save, upload or delete
+ * appends one record. All integers are little-endian.
+ *
+ * | Offset | Size | Field |
+ * |---|---|---|
+ * | 0 | 1 | type (`H`eader, `U`pdate, `D`elete) |
+ * | 1 | 1 | check byte over the rest of the record |
+ * | 2 | 1 | path length @c p |
+ * | 3 | 1 | name length @c n |
+ * | 4 | 2 | width (header: version) |
+ * | 6 | 2 | height |
+ * | 8 | 4 | file size in bytes |
+ * | 12 | 4 | change counter (header: counter at compaction) |
+ * | 16 | 4 | content hash |
+ * | 20 | p | path |
+ * | 20+p | n | pattern name |
+ *
+ * At load the log is replayed up to the first damaged record and then
+ * checked against the directory once (names and sizes): new or changed
+ * files are scanned, vanished ones dropped. When the log grows past
+ * @ref PATTERN_CATALOG_COMPACT_BYTES (or twice the last snapshot) it is
+ * replaced by a snapshot (temporary file renamed over the log).
+ *
+ * The content hash covers size and stitches only, so the same pattern under
+ * another name or in the other file format counts as a duplicate.
+ */
+
+#pragma once
+#include <Arduino.h>
+#include <vector>
+#include "Pattern.h"
+#include "RecordLog.h"
+
+/** @brief Catalog log in LittleFS. */
+static constexpr const char* PATTERN_CATALOG_PATH = "/catalog.log";
+
+/** @brief Snapshot being written during compaction. */
+static constexpr const char* PATTERN_CATALOG_TMP = "/catalog.tmp";
+
+/** @brief Log size that triggers compaction into a snapshot. */
+static constexpr size_t PATTERN_CATALOG_COMPACT_BYTES = 4096;
+
+/** @brief One stored pattern file. */
+struct CatalogEntry {
+  String path;         /**< @brief Full path, e.g. @c /patterns/diamond.json. */
+  String name;         /**< @brief Pattern name (empty if the file is unreadable). */
+  uint16_t w = 0;      /**< @brief Width; 0 if the file is unreadable. */
+  uint16_t h = 0;
+  uint32_t bytes = 0;  /**< @brief File size. */
+  uint32_t mod = 0;    /**< @brief Catalog change counter at the last write. */
+  uint32_t hash = 0;   /**< @brief Content hash (size and stitches). */
+
+  bool valid() const { return w > 0; }
+};
+
+/**
+ * @brief Pattern file index. Loaded on first use; web task (and setup) only.
+ */
+class PatternCatalog {
+public:
+  /** @brief Orders for order(). */
+  enum Sort : uint8_t { SORT_PATH, SORT_NAME, SORT_SIZE, SORT_MOD, SORT_COUNT };
+
+  /** @brief Record @p path as just written with the contents of @p p (@p bytes long). */
+  void update(const String& path, const Pattern& p, uint32_t bytes);
+
+  /** @brief Record @p path after it changed some other way (upload); reads the file. */
+  void update(const String& path);
+
+  /** @brief Forget @p path (deleted). */
+  void remove(const String& path);
+
+  /** @brief Number of files. */
+  int count();
+
+  /** @brief Change counter: increases with every update/remove. */
+  uint32_t mod();
+
+  /**
+   * @brief Entry indexes in @p sort order (ascending).
+   *
+   * Orders are sorted once after a change and then reused, so paging
+   * through a list costs only the page.
+   */
+  const std::vector<uint16_t>& order(Sort sort);
+
+  /** @brief Entry @p i (0 <= i < count()). */
+  const CatalogEntry& entry(int i) { load(); return _entries[i]; }
+
+  /** @brief Index of the entry for @p path, or -1. */
+  int indexOf(const String& path);
+
+  /** @brief Another file with the same content as entry @p i, or nullptr. */
+  const CatalogEntry* duplicateOf(int i);
+
+private:
+  void load();
+  bool reconcile();
+  int search(const String& path) const;
+  void put(const CatalogEntry& e);
+  void append(uint8_t type, const CatalogEntry& e);
+  bool compact();
+  void changed();
+
+  std::vector<CatalogEntry> _entries;  // sorted by path
+  std::vector<uint16_t> _orders[SORT_COUNT];
+  std::vector<uint16_t> _byHash;
+  bool _sorted = false;
+  uint32_t _mod = 0;
+  RecordLog _log{PATTERN_CATALOG_PATH, PATTERN_CATALOG_TMP, PATTERN_CATALOG_COMPACT_BYTES};
+  bool _loaded = false;
+};
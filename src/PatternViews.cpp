@@ -0,0 +1,55 @@
+/**
+ * @file PatternViews.cpp
+ * @brief Row computation for the pattern transform views.
+ */
+
+#include "PatternViews.h"
+#include "RowKernels.h"
+
+const uint32_t* MirrorView::row(int r) {
+  const uint32_t* src = _base->row(baseRow(r));
+  if (!_h) return src;
+  rowReverse(_buf, src, width());
+  return _buf;
+}
+
+const uint32_t* InvertView::row(int r) {
+  const uint32_t* src = _base->row(r);
+  if (!_on) return src;
+  rowInvert(_buf, src, width());
+  return _buf;
+}
+
+const uint32_t* TileView::row(int r) {
+  const uint32_t* src = _base->row(baseRow(r));
+  if (_nx == 1) return src;
+  rowTile(_buf, src, _base->width(), width());
+  return _buf;
+}
+
+const uint32_t* OffsetView::row(int r) {
+  const uint32_t* src = _base->row(r);
+  const int w = width();
+  if (_off % w == 0) return src;
+  rowRotate(_buf, src, w, _off);
+  return _buf;
+}
+
+bool KnitView::configure(const AppConfig& cfg) {
+  if (cfg.mirrorH == _mh && cfg.mirrorV == _mv && cfg.invert == _inv &&
+      cfg.tileX == _tx && cfg.tileY == _ty && cfg.needleOffset == _off) {
+    return false;
+  }
+  _mh = cfg.mirrorH;
+  _mv = cfg.mirrorV;
+  _inv = cfg.invert;
+  _tx = cfg.tileX;
+  _ty = cfg.tileY;
+  _off = cfg.needleOffset;
+
+  _tile.set(_tx, _ty);
+  _mirror.set(_mh, _mv);
+  _invert.set(_inv);
+  _offset.set(_off);
+  return true;
+}
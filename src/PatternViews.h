@@ -0,0 +1,155 @@
+/**
+ * @file PatternViews.h
+ * @brief Zero-copy pattern transforms (mirror, invert, tile, offset).
+ *
+ * Each view is a RowSource stacked on another RowSource and computes its rows
+ * on the fly into a one-row buffer, so transforms cost no pattern-sized
+ * memory. Views that are switched off pass the base row through untouched.
+ */
+
+#pragma once
+#include <Arduino.h>
+#include "RowSource.h"
+#include "AppConfig.h"
+
+/**
+ * @brief Most rows the knitted (tiled) pattern may have.
+ *
+ * As many as the tallest .kpb file, so tiling never needs more per-row
+ * state (confirmations, journal records) than an untiled file.
+ */
+static constexpr int KNIT_MAX_ROWS = 65535;
+
+/** @brief True if @p baseH rows repeated @p ny times down fit @ref KNIT_MAX_ROWS. */
+static inline bool knitHeightFits(int baseH, int ny) {
+  return (long)baseH * ny <= KNIT_MAX_ROWS;
+}
+
+/**
+ * @brief Base class for a view over another RowSource.
+ */
+class RowView : public RowSource {
+public:
+  void setBase(RowSource* base) { _base = base; }
+  RowSource* base() const { return _base; }
+
+  /** @brief Row of the base source that row @p r of this view is built from. */
+  virtual int baseRow(int r) const { return r; }
+
+  int width() const override { return _base->width(); }
+  int height() const override { return _base->height(); }
+  void prefetch(int r, int dir) override { _base->prefetch(baseRow(r), dir); }
+
+protected:
+  RowSource* _base = nullptr;
+  uint32_t _buf[(MAX_W + PATTERN_WORD_BITS - 1) / PATTERN_WORD_BITS];
+};
+
+/**
+ * @brief Horizontal (left/right) and/or vertical (top/bottom) mirror.
+ */
+class MirrorView : public RowView {
+public:
+  void set(bool horizontal, bool vertical) { _h = horizontal; _v = vertical; }
+
+  int baseRow(int r) const override { return _v ? height() - 1 - r : r; }
+  const uint32_t* row(int r) override;
+  void prefetch(int r, int dir) override { _base->prefetch(baseRow(r), _v ? -dir : dir); }
+
+private:
+  bool _h = false;
+  bool _v = false;
+};
+
+/**
+ * @brief Negative: every stitch flipped.
+ */
+class InvertView : public RowView {
+public:
+  void set(bool on) { _on = on; }
+  const uint32_t* row(int r) override;
+
+private:
+  bool _on = false;
+};
+
+/**
+ * @brief Repeat the base @p nx times across and @p ny times down.
+ *
+ * The width is capped at @ref MAX_W needles (a partial tile at the end) and
+ * the height at @ref KNIT_MAX_ROWS (fewer repeats down). /api/config refuses
+ * such a tileY; the cap covers a pattern that grows or is swapped later.
+ */
+class TileView : public RowView {
+public:
+  void set(int nx, int ny) {
+    _nx = constrain(nx, 1, MAX_W);
+    _ny = constrain(ny, 1, 255);
+  }
+
+  int width() const override { return min(_base->width() * _nx, MAX_W); }
+  int height() const override { return _base->height() * tilesDown(); }
+  int baseRow(int r) const override { return r % _base->height(); }
+  const uint32_t* row(int r) override;
+
+private:
+  int tilesDown() const { return max(1, min(_ny, KNIT_MAX_ROWS / max(_base->height(), 1))); }
+
+  int _nx = 1;
+  int _ny = 1;
+};
+
+/**
+ * @brief Shift the pattern across the needles, wrapping around.
+ *
+ * A positive offset moves stitches away from needle #1 (towards lower
+ * column indices, since needle #1 is the rightmost column).
+ */
+class OffsetView : public RowView {
+public:
+  void set(int needles) { _off = needles; }
+  const uint32_t* row(int r) override;
+
+private:
+  int _off = 0;
+};
+
+/**
+ * @brief Fixed transform pipeline used for knitting: tile -> mirror -> invert -> offset.
+ *
+ * configure() copies the settings from AppConfig; the base is the loaded
+ * pattern or a PatternWindow.
+ */
+class KnitView : public RowSource {
+public:
+  KnitView() {
+    _mirror.setBase(&_tile);
+    _invert.setBase(&_mirror);
+    _offset.setBase(&_invert);
+  }
+
+  void setBase(RowSource* base) { _tile.setBase(base); }
+
+  /** @brief Apply transform settings; returns true if anything changed. */
+  bool configure(const AppConfig& cfg);
+
+  /** @brief Height of the underlying pattern (before tiling). */
+  int baseHeight() const { return _tile.base()->height(); }
+
+  /** @brief Row of the underlying pattern shown at knit row @p r. */
+  int baseRow(int r) const { return _tile.baseRow(_mirror.baseRow(r)); }
+
+  int width() const override { return _offset.width(); }
+  int height() const override { return _offset.height(); }
+  const uint32_t* row(int r) override { return _offset.row(r); }
+  void prefetch(int r, int dir) override { _offset.prefetch(r, dir); }
+
+private:
+  TileView _tile;
+  MirrorView _mirror;
+  InvertView _invert;
+  OffsetView _offset;
+
+  bool _mh = false, _mv = false, _inv = false;
+  int _tx = 1, _ty = 1, _off = 0;
+};
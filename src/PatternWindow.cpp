@@ -0,0 +1,65 @@
+/**
+ * @file PatternWindow.cpp
+ * @brief Implementation of the lazy row window over binary pattern files.
+ */
+
+#include "PatternWindow.h"
+
+bool PatternWindow::open(const String& path) {
+  close();
+
+  if (!LittleFS.exists(path)) return false;
+  _f = LittleFS.open(path, "r");
+  if (!_f) return false;
+  // Rows are read one by one later without their CRC, so the file is checked once here
+  if (!verifyPatternBin(_f, _hdr) || !readPatternBinHeader(_f, _hdr)) { close(); return false; }
+
+  _stride = patternWordsPerRow(_hdr.w);
+  _rows = (uint32_t*)calloc((size_t)PATTERN_WINDOW_ROWS * _stride, sizeof(uint32_t));
+  if (!_rows) { close(); return false; }
+
+  for (int i = 0; i < PATTERN_WINDOW_ROWS; i++) _tag[i] = -1;
+  _misses = 0;
+  return true;
+}
+
+void PatternWindow::close() {
+  if (_f) _f.close();
+  free(_rows);
+  _rows = nullptr;
+  _hdr = PatternBinHeader();
+  _stride = 0;
+}
+
+void PatternWindow::load(int r) {
+  uint32_t* dst = slot(r);
+  _tag[r & (PATTERN_WINDOW_ROWS - 1)] = r;
+  _misses++;
+  if (!readPatternBinRow(_f, _hdr, r, dst)) memset(dst, 0, _stride * sizeof(uint32_t));
+}
+
+const uint32_t* PatternWindow::row(int r) {
+  if (_tag[r & (PATTERN_WINDOW_ROWS - 1)] != r) load(r);
+  return slot(r);
+}
+
+void PatternWindow::prefetch(int r, int dir) {
+  if (!_rows || _hdr.h <= 0) return;
+  dir = (dir < 0) ? -1 : +1;
+  // Consecutive rows map to distinct slots, so the rows ahead never evict
+  // the current one (AHEAD < ROWS).
+  for (int k = 0; k <= PATTERN_WINDOW_AHEAD; k++) {
+    int rr = ((r + dir * k) % _hdr.h + _hdr.h) % _hdr.h;
+    if (_tag[rr & (PATTERN_WINDOW_ROWS - 1)] != rr) load(rr);
+  }
+}
+
+bool patternWantsWindow(const String& path) {
+  if (!path.endsWith(PATTERN_BIN_EXT) || !LittleFS.exists(path)) return false;
+  File f = LittleFS.open(path, "r");
+  if (!f) return false;
+  PatternBinHeader hdr;
+  bool big = readPatternBinHeader(f, hdr) && hdr.h > PATTERN_WINDOW_ROWS;
+  f.close();
+  return big;
+}
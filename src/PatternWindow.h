@@ -0,0 +1,81 @@
+/**
+ * @file PatternWindow.h
+ * @brief Row-windowed lazy access to large binary pattern files.
+ *
+ * Keeps a small direct-mapped cache of rows around the knitting position and
+ * fetches the rest on demand from the LittleFS file through the binary
+ * format's per-row index (see PatternBin.h). RAM use depends only on the
+ * width, never on the number of rows.
+ */
+
+#pragma once
+#include <Arduino.h>
+#include <LittleFS.h>
+#include "RowSource.h"
+#include "PatternBin.h"
+
+/** @brief Rows kept in RAM (power of two). */
+static constexpr int PATTERN_WINDOW_ROWS = 64;
+
+/** @brief Rows loaded ahead of the knitting position in the stepping direction. */
+static constexpr int PATTERN_WINDOW_AHEAD = 16;
+
+/**
+ * @brief RowSource backed by an open binary pattern file.
+ */
+class PatternWindow : public RowSource {
+public:
+  PatternWindow() {
+    for (int i = 0; i < PATTERN_WINDOW_ROWS; i++) _tag[i] = -1;
+  }
+  ~PatternWindow() { close(); }
+
+  PatternWindow(const PatternWindow&) = delete;
+  PatternWindow& operator=(const PatternWindow&) = delete;
+
+  /**
+   * @brief Open a binary pattern file (already normalized path).
+   *
+   * The whole file is read once to check its rows and CRC (see verifyPatternBin()).
+   * @return false if it is missing, not binary, corrupt, or memory is exhausted.
+   */
+  bool open(const String& path);
+
+  /** @brief Release the file and the row cache. */
+  void close();
+
+  bool isOpen() const { return _rows != nullptr; }
+
+  /** @brief Pattern name from the file header. */
+  const String& name() const { return _hdr.name; }
+
+  int width() const override { return _hdr.w; }
+  int height() const override { return _hdr.h; }
+
+  /** @brief Row @p r; a cache miss costs one seek + read. Read errors yield an empty row. */
+  const uint32_t* row(int r) override;
+
+  /** @brief Load the rows just ahead of @p r in direction @p dir (wrapping). */
+  void prefetch(int r, int dir) override;
+
+  /** @brief Cache misses since open() (for diagnostics). */
+  uint32_t misses() const { return _misses; }
+
+private:
+  uint32_t* slot(int r) { return _rows + (r & (PATTERN_WINDOW_ROWS - 1)) * _stride; }
+  void load(int r);
+
+  File _f;
+  PatternBinHeader _hdr;
+  int _stride = 0;
+  uint32_t* _rows = nullptr;
+  int32_t _tag[PATTERN_WINDOW_ROWS];
+  uint32_t _misses = 0;
+};
+
+/**
+ * @brief True if @p path is a binary pattern with more rows than the window.
+ *
+ * Such files are knitted through a PatternWindow instead of being loaded.
+ */
+bool patternWantsWindow(const String& path);
@@ -0,0 +1,25 @@
+/**
+ * @file RecordLog.cpp
+ * @brief Checked append-only record log on LittleFS.
+ */
+
+#include "RecordLog.h"
+
+bool replaceFile(const char* from, const char* to) {
+  if (LittleFS.rename(from, to)) return true;
+  LittleFS.remove(to);
+  return LittleFS.rename(from, to);
+}
+
+uint8_t RecordLog::checkByte(const uint8_t* rec, size_t len) {
+  uint8_t c = 0x5A ^ rec[0];
+  for (size_t i = 2; i < len; i++) c = (uint8_t)((c << 1) | (c >> 7)) ^ rec[i];
+  return c;
+}
+
+void RecordLog::append(const uint8_t* data, size_t n) {
+  File f = LittleFS.open(_path, "a");
+  if (!f) return;
+  _size += f.write(data, n);
+  f.close();
+}
@@ -0,0 +1,103 @@
+/**
+ * @file RecordLog.h
+ * @brief Checked append-only record log on LittleFS.
+ *
+ * Shared by StateJournal and PatternCatalog. Each record starts with a type
+ * byte and a check byte over the type and the rest of the record; the
+ * owner defines everything after that (fixed or variable length).
+ *
+ * Replay stops at the first torn or damaged record. When the log has grown
+ * past its threshold (or twice the last snapshot) the owner writes a
+ * snapshot to a temporary file, which is renamed over the log.
+ */
+
+#pragma once
+#include <Arduino.h>
+#include <LittleFS.h>
+
+/**
+ * @brief Rename @p from over @p to, removing @p to first where the file
+ *        system does not replace it.
+ */
+bool replaceFile(const char* from, const char* to);
+
+/**
+ * @brief One log file, its temporary snapshot file and its size bookkeeping.
+ */
+class RecordLog {
+public:
+  /** @param compactBytes log size that makes due() true. */
+  RecordLog(const char* path, const char* tmp, size_t compactBytes)
+      : _path(path), _tmp(tmp), _compactBytes(compactBytes) {}
+
+  /** @brief Set the check byte (@c rec[1]) of the @p len byte record @p rec. */
+  static void seal(uint8_t* rec, size_t len) { rec[1] = checkByte(rec, len); }
+
+  /**
+   * @brief Read the log up to the first torn or damaged record.
+   *
+   * For each record @p head bytes are read into @p rec, @p tail(rec) gives
+   * the number of bytes that follow (negative: invalid), then
+   * @p apply(rec, len) gets the checked record and returns false to stop.
+   *
+   * @return true if every byte of the file was replayed (or there is none).
+   */
+  template <class Tail, class Apply>
+  bool replay(uint8_t* rec, size_t head, Tail tail, Apply apply);
+
+  /** @brief Append @p n bytes of sealed records. */
+  void append(const uint8_t* data, size_t n);
+
+  /** @brief True when the log should be replaced by a snapshot. */
+  bool due() const { return _size >= max(_compactBytes, 2 * _snapshotSize); }
+
+  /**
+   * @brief Replace the log by a snapshot.
+   *
+   * @p write(File&) writes the snapshot records to the temporary file and
+   * returns the byte count.
+   */
+  template <class Write>
+  bool compact(Write write);
+
+private:
+  static uint8_t checkByte(const uint8_t* rec, size_t len);
+
+  const char* _path;
+  const char* _tmp;
+  size_t _compactBytes;
+  size_t _size = 0;          // bytes in the log file
+  size_t _snapshotSize = 0;  // bytes written by the last compaction
+};
+
+template <class Tail, class Apply>
+bool RecordLog::replay(uint8_t* rec, size_t head, Tail tail, Apply apply) {
+  _size = 0;
+  File f = LittleFS.open(_path, "r");
+  if (!f) return true;
+  size_t fileSize = f.size();
+
+  // A torn or corrupt record ends the replay; everything before it stands.
+  while (f.read(rec, head) == head) {
+    int more = tail((const uint8_t*)rec);
+    if (more < 0 || (more && f.read(rec + head, more) != (size_t)more)) break;
+    size_t len = head + more;
+    if (rec[1] != checkByte(rec, len) || !apply((const uint8_t*)rec, len)) break;
+    _size += len;
+  }
+  f.close();
+  return _size == fileSize;
+}
+
+template <class Write>
+bool RecordLog::compact(Write write) {
+  File f = LittleFS.open(_tmp, "w");
+  if (!f) return false;
+  size_t bytes = write(f);
+  f.close();
+
+  if (!replaceFile(_tmp, _path)) return false;
+  _size = bytes;
+  _snapshotSize = bytes;
+  return true;
+}
@@ -0,0 +1,99 @@
+/**
+ * @file RmtLedOutput.cpp
+ * @brief RMT driver setup and byte-to-pulse translation for WS2812.
+ */
+
+#include "RmtLedOutput.h"
+#include <esp_timer.h>
+
+// 80 MHz APB / 2 = 25 ns per tick.
+static constexpr uint8_t RMT_CLK_DIV = 2;
+static constexpr uint32_t RMT_NS_PER_TICK = 25;
+
+// WS2812 bit timing (ns).
+static constexpr uint32_t T0H_NS = 350;
+static constexpr uint32_t T0L_NS = 1000;
+static constexpr uint32_t T1H_NS = 1000;
+static constexpr uint32_t T1L_NS = 350;
+
+static rmt_item32_t makeItem(uint32_t highNs, uint32_t lowNs) {
+  rmt_item32_t it;
+  it.level0 = 1;
+  it.duration0 = highNs / RMT_NS_PER_TICK;
+  it.level1 = 0;
+  it.duration1 = lowNs / RMT_NS_PER_TICK;
+  return it;
+}
+
+static rmt_item32_t bit0Item;
+static rmt_item32_t bit1Item;
+
+// The driver has one end-of-transfer callback for all channels.
+static RmtLedOutput* channelOutputs[RMT_CHANNEL_MAX];
+
+bool RmtLedOutput::begin() {
+  bit0Item = makeItem(T0H_NS, T0L_NS);
+  bit1Item = makeItem(T1H_NS, T1L_NS);
+
+  rmt_config_t c = RMT_DEFAULT_CONFIG_TX((gpio_num_t)_pin, _ch);
+  c.clk_div = RMT_CLK_DIV;
+  if (rmt_config(&c) != ESP_OK) return false;
+  if (rmt_driver_install(_ch, 0, 0) != ESP_OK) return false;
+  if (rmt_translator_init(_ch, translate) != ESP_OK) {
+    rmt_driver_uninstall(_ch);
+    return false;
+  }
+  channelOutputs[_ch] = this;
+  rmt_register_tx_end_callback(onTxEnd, nullptr);
+  return true;
+}
+
+uint32_t RmtLedOutput::show(const uint8_t* frame, size_t len) {
+  if (_busy) rmt_wait_tx_done(_ch, portMAX_DELAY);
+
+  // Back-to-back frames need a low gap or the strip reads them as one.
+  int64_t idle = esp_timer_get_time() - _endUs;
+  if (idle < (int64_t)RMT_LED_LATCH_US) delayMicroseconds(RMT_LED_LATCH_US - (uint32_t)idle);
+
+  _buf.assign(frame, frame + len);
+  uint32_t fence = nextFence();
+  _fence = fence;
+  _busy = true;
+  if (rmt_write_sample(_ch, _buf.data(), _buf.size(), false) != ESP_OK) {
+    _busy = false;
+    complete(fence);  // dropped; don't leave waiters hanging
+  }
+  return fence;
+}
+
+// Runs in the RMT interrupt.
+void IRAM_ATTR RmtLedOutput::onTxEnd(rmt_channel_t channel, void*) {
+  RmtLedOutput* self = channelOutputs[channel];
+  if (!self) return;
+  self->_endUs = esp_timer_get_time();
+  self->_busy = false;
+  self->complete(self->_fence);
+}
+
+// Called by the driver as its buffer drains: MSB first, one item per bit.
+void IRAM_ATTR RmtLedOutput::translate(const void* src, rmt_item32_t* dest, size_t srcSize,
+                                       size_t wanted, size_t* translated, size_t* items) {
+  if (!src || !dest) {
+    *translated = 0;
+    *items = 0;
+    return;
+  }
+  const uint8_t* p = (const uint8_t*)src;
+  size_t size = 0;
+  size_t num = 0;
+  while (size < srcSize && num + 8 <= wanted) {
+    uint8_t b = *p++;
+    for (int i = 7; i >= 0; i--) {
+      *dest++ = ((b >> i) & 1) ? bit1Item : bit0Item;
+    }
+    num += 8;
+    size++;
+  }
+  *translated = size;
+  *items = num;
+}
@@ -0,0 +1,55 @@
+/**
+ * @file RmtLedOutput.h
+ * @brief WS2812 (800 kHz) output through the ESP32 RMT peripheral.
+ *
+ * The RMT driver turns frame bytes into pulses from its interrupt while the
+ * CPU keeps running, so show() only copies the frame and starts the
+ * transfer. Interrupts stay enabled, unlike the bit-banged NeoPixel path,
+ * which on a long strip blocks Wi-Fi and the carriage sensor for
+ * milliseconds.
+ */
+
+#pragma once
+#include <Arduino.h>
+#include <driver/rmt.h>
+#include <vector>
+#include "LedOutput.h"
+
+/** @brief Minimum low time between frames so the strip latches (us, WS2812B). */
+static constexpr uint32_t RMT_LED_LATCH_US = 300;
+
+/**
+ * @brief Asynchronous RMT transport; one instance per channel.
+ *
+ * Instances on different channels transmit at the same time.
+ */
+class RmtLedOutput : public LedOutput {
+public:
+  explicit RmtLedOutput(int pin, rmt_channel_t channel = RMT_CHANNEL_0)
+    : _pin(pin), _ch(channel) {}
+
+  RmtLedOutput(const RmtLedOutput&) = delete;
+  RmtLedOutput& operator=(const RmtLedOutput&) = delete;
+
+  /** @brief Install the RMT driver. @return false if the channel is unavailable. */
+  bool begin() override;
+
+  /**
+   * @brief Copy @p frame and start sending it.
+   *
+   * Waits only if the previous frame is still going out (its buffer is in use).
+   */
+  uint32_t show(const uint8_t* frame, size_t len) override;
+
+private:
+  static void onTxEnd(rmt_channel_t channel, void* arg);
+  static void translate(const void* src, rmt_item32_t* dest, size_t srcSize, size_t wanted,
+                        size_t* translated, size_t* items);
+
+  int _pin;
+  rmt_channel_t _ch;
+  std::vector<uint8_t> _buf;  // read by the driver while sending
+  volatile bool _busy = false;
+  volatile int64_t _endUs = 0;
+  uint32_t _fence = 0;
+};
@@ -0,0 +1,52 @@
+/**
+ * @file RowFlags.h
+ * @brief Growable bit set with one flag per pattern row.
+ *
+ * Used for per-row knitting state (row confirmed) so the cost follows the
+ * pattern height: 20,000 rows take 2.5 KB instead of a fixed bool array.
+ */
+
+#pragma once
+#include <Arduino.h>
+#include <vector>
+
+/**
+ * @brief One bit per row, sized at runtime.
+ */
+class RowFlags {
+public:
+  /** @brief Number of rows covered. */
+  int size() const { return _n; }
+
+  /** @brief Change the row count; existing flags are kept, new ones are false. */
+  void resize(int n) {
+    if (n < 0) n = 0;
+    _bits.resize((n + 31) / 32, 0);
+    // Drop flags past the new end so a later grow starts clean.
+    if (n % 32 && !_bits.empty()) _bits.back() &= (1u << (n % 32)) - 1u;
+    _n = n;
+  }
+
+  /** @brief Clear all flags. */
+  void clearAll() { std::fill(_bits.begin(), _bits.end(), 0u); }
+
+  bool get(int r) const {
+    if (r < 0 || r >= _n) return false;
+    return (_bits[r / 32] >> (r % 32)) & 1u;
+  }
+
+  void set(int r, bool v = true) {
+    if (r < 0 || r >= _n) return;
+    if (v) _bits[r / 32] |= 1u << (r % 32);
+    else _bits[r / 32] &= ~(1u << (r % 32));
+  }
+
+  /** @brief Backing words (flag @c r is bit @c r%32 of word @c r/32). */
+  int words() const { return (int)_bits.size(); }
+  uint32_t word(int i) const { return _bits[i]; }
+  void setWord(int i, uint32_t v) { _bits[i] = v; }
+
+private:
+  std::vector<uint32_t> _bits;
+  int _n = 0;
+};
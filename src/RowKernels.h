@@ -0,0 +1,176 @@
+/**
+ * @file RowKernels.h
+ * @brief Word-parallel operations on bit-packed pattern rows.
+ *
+ * Rows use the Pattern layout: column @c c is bit @c c%32 of word @c c/32,
+ * bits past the width are 0. Every kernel works 32 stitches at a time with
+ * shifts and masks (no per-stitch branches) and keeps the tail bits clear.
+ * @p w is the row width in stitches; buffers hold patternWordsPerRow(w) words.
+ */
+
+#pragma once
+#include <Arduino.h>
+#include "Pattern.h"
+
+/** @brief Mask of valid bits in the last word of a @p w-stitch row. */
+static inline uint32_t rowTailMask(int w) {
+  int rem = w % PATTERN_WORD_BITS;
+  return rem ? ((1u << rem) - 1u) : 0xFFFFFFFFu;
+}
+
+/** @brief Clear bits past the width in the last word. */
+static inline void rowMaskTail(uint32_t* d, int w) {
+  d[patternWordsPerRow(w) - 1] &= rowTailMask(w);
+}
+
+static inline void rowClear(uint32_t* d, int w) {
+  memset(d, 0, patternWordsPerRow(w) * sizeof(uint32_t));
+}
+
+static inline void rowCopy(uint32_t* d, const uint32_t* s, int w) {
+  memcpy(d, s, patternWordsPerRow(w) * sizeof(uint32_t));
+}
+
+/** @brief Set columns [@p a, @p b) to 1, one word mask per 32 columns. */
+static inline void rowSetRange(uint32_t* d, int a, int b) {
+  while (a < b) {
+    int wi = a / PATTERN_WORD_BITS;
+    int lo = a % PATTERN_WORD_BITS;
+    int hi = min(PATTERN_WORD_BITS, lo + (b - a));
+    uint32_t mask = (hi == PATTERN_WORD_BITS ? 0xFFFFFFFFu : ((1u << hi) - 1u)) & (0xFFFFFFFFu << lo);
+    d[wi] |= mask;
+    a += hi - lo;
+  }
+}
+
+/** @brief Reverse the bit order of a 32-bit word. */
+static inline uint32_t bitReverse32(uint32_t x) {
+  x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+  x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+  x = ((x >> 4) & 0x0F0F0F0Fu) | ((x & 0x0F0F0F0Fu) << 4);
+  return __builtin_bswap32(x);
+}
+
+/**
+ * @brief 32 bits of @p s starting at bit @p pos (0 beyond @p nw words).
+ *
+ * The high half uses a split shift so @c pos%32 == 0 needs no branch.
+ */
+static inline uint32_t rowBitsAt(const uint32_t* s, int nw, int pos) {
+  int wi = pos / PATTERN_WORD_BITS;
+  int sh = pos % PATTERN_WORD_BITS;
+  uint32_t lo = (wi < nw) ? s[wi] : 0;
+  uint32_t hi = (wi + 1 < nw) ? s[wi + 1] : 0;
+  return (lo >> sh) | ((hi << 1) << (31 - sh));
+}
+
+/** @brief Stitches set in the row. */
+static inline int rowPopcount(const uint32_t* s, int w) {
+  int n = 0;
+  for (int i = 0; i < patternWordsPerRow(w); i++) n += __builtin_popcount(s[i]);
+  return n;
+}
+
+/** @brief d = ~s (negative), tail kept clear. @p d may equal @p s. */
+static inline void rowInvert(uint32_t* d, const uint32_t* s, int w) {
+  const int nw = patternWordsPerRow(w);
+  for (int i = 0; i < nw; i++) d[i] = ~s[i];
+  d[nw - 1] &= rowTailMask(w);
+}
+
+/** @brief d = a & b (keep stitches set in both layers). */
+static inline void rowAnd(uint32_t* d, const uint32_t* a, const uint32_t* b, int w) {
+  for (int i = 0; i < patternWordsPerRow(w); i++) d[i] = a[i] & b[i];
+}
+
+/** @brief d = a | b (overlay two motifs). */
+static inline void rowOr(uint32_t* d, const uint32_t* a, const uint32_t* b, int w) {
+  for (int i = 0; i < patternWordsPerRow(w); i++) d[i] = a[i] | b[i];
+}
+
+/** @brief d = a ^ b (toggle @p a by mask @p b). */
+static inline void rowXor(uint32_t* d, const uint32_t* a, const uint32_t* b, int w) {
+  for (int i = 0; i < patternWordsPerRow(w); i++) d[i] = a[i] ^ b[i];
+}
+
+/**
+ * @brief d[c] = s[c + k] (move stitches towards column 0), zero fill.
+ * @p d may equal @p s.
+ */
+static inline void rowShiftDown(uint32_t* d, const uint32_t* s, int w, int k) {
+  const int nw = patternWordsPerRow(w);
+  for (int i = 0; i < nw; i++) d[i] = rowBitsAt(s, nw, i * PATTERN_WORD_BITS + k);
+  d[nw - 1] &= rowTailMask(w);
+}
+
+/**
+ * @brief d[c + k] = s[c] (move stitches towards column w-1), zero fill.
+ * @p d must not overlap @p s.
+ */
+static inline void rowShiftUp(uint32_t* d, const uint32_t* s, int w, int k) {
+  const int nw = patternWordsPerRow(w);
+  const int q = k / PATTERN_WORD_BITS;
+  const int sh = k % PATTERN_WORD_BITS;
+  for (int i = 0; i < nw; i++) {
+    uint32_t lo = (i - q >= 0 && i - q < nw) ? s[i - q] : 0;
+    uint32_t below = (i - q - 1 >= 0 && i - q - 1 < nw) ? s[i - q - 1] : 0;
+    d[i] = (lo << sh) | ((below >> 1) >> (31 - sh));
+  }
+  d[nw - 1] &= rowTailMask(w);
+}
+
+/**
+ * @brief Rotate within the width: d[c] = s[(c + k) mod w].
+ * @p d must not overlap @p s.
+ */
+static inline void rowRotate(uint32_t* d, const uint32_t* s, int w, int k) {
+  k %= w;
+  if (k < 0) k += w;
+  uint32_t tmp[(MAX_W + PATTERN_WORD_BITS - 1) / PATTERN_WORD_BITS];
+  rowShiftDown(d, s, w, k);
+  rowShiftUp(tmp, s, w, w - k);
+  rowOr(d, d, tmp, w);
+}
+
+/**
+ * @brief Mirror: d[c] = s[w-1-c]. @p d must not overlap @p s.
+ *
+ * Reverses word order and bits per word, then drops the padding bits.
+ */
+static inline void rowReverse(uint32_t* d, const uint32_t* s, int w) {
+  const int nw = patternWordsPerRow(w);
+  for (int i = 0; i < nw; i++) d[i] = bitReverse32(s[nw - 1 - i]);
+  rowShiftDown(d, d, w, nw * PATTERN_WORD_BITS - w);
+}
+
+/**
+ * @brief OR the first @p n bits of @p s into @p d starting at bit @p pos.
+ *
+ * @p d holds @p dw words; bits past it are dropped. Source bits are read
+ * before the same word is written, so @p s may be an earlier part of @p d.
+ */
+static inline void rowInsertBits(uint32_t* d, int dw, int pos, const uint32_t* s, int n) {
+  const int sh = pos % PATTERN_WORD_BITS;
+  int wi = pos / PATTERN_WORD_BITS;
+  for (int j = 0; j * PATTERN_WORD_BITS < n; j++, wi++) {
+    uint32_t v = s[j];
+    int rem = n - j * PATTERN_WORD_BITS;
+    if (rem < PATTERN_WORD_BITS) v &= (1u << rem) - 1u;
+    if (wi < dw) d[wi] |= v << sh;
+    if (wi + 1 < dw) d[wi + 1] |= (v >> 1) >> (31 - sh);
+  }
+}
+
+/**
+ * @brief Repeat the @p bw-stitch row @p s across a @p w-stitch row @p d.
+ *
+ * Copies by doubling, so a 200-needle row from a 4-stitch motif takes
+ * six block copies rather than 200 bit moves.
+ */
+static inline void rowTile(uint32_t* d, const uint32_t* s, int bw, int w) {
+  const int nw = patternWordsPerRow(w);
+  rowClear(d, w);
+  rowInsertBits(d, nw, 0, s, min(bw, w));
+  for (int len = bw; len < w; len *= 2) rowInsertBits(d, nw, len, d, min(len, w - len));
+  d[nw - 1] &= rowTailMask(w);
+}
@@ -0,0 +1,54 @@
+/**
+ * @file RowSource.h
+ * @brief Read-only access to packed pattern rows, wherever they live.
+ *
+ * The knitting path (LED output, row stepping, state API) only needs one row
+ * at a time, so it works against this interface instead of a fully loaded
+ * @ref Pattern. Implementations: @ref PatternRowSource (rows in RAM) and
+ * @ref PatternWindow (rows fetched on demand from a binary file).
+ */
+
+#pragma once
+#include <Arduino.h>
+#include "Pattern.h"
+
+/**
+ * @brief Source of bit-packed pattern rows (same layout as Pattern::row()).
+ */
+class RowSource {
+public:
+  virtual ~RowSource() {}
+
+  virtual int width() const = 0;
+  virtual int height() const = 0;
+
+  /**
+   * @brief Packed words of row @p r (0 <= r < height()).
+   *
+   * The pointer stays valid until the next row()/prefetch() call on this
+   * source. Bits past width() are 0.
+   */
+  virtual const uint32_t* row(int r) = 0;
+
+  /**
+   * @brief Hint that the knitting position moved to @p r, stepping @p dir (+1/-1).
+   *
+   * Lazy sources use it to load the rows ahead; in-memory sources ignore it.
+   */
+  virtual void prefetch(int r, int dir) {}
+};
+
+/**
+ * @brief RowSource view of an in-memory Pattern.
+ */
+class PatternRowSource : public RowSource {
+public:
+  explicit PatternRowSource(const Pattern& p) : _p(p) {}
+
+  int width() const override { return _p.w; }
+  int height() const override { return _p.h; }
+  const uint32_t* row(int r) override { return _p.row(r); }
+
+private:
+  const Pattern& _p;
+};
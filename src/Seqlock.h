@@ -0,0 +1,65 @@
+/**
+ * @file Seqlock.h
+ * @brief Single-writer sequence lock for publishing small state structs.
+ *
+ * The writer never waits: it bumps the sequence to odd, stores the value and
+ * bumps it back to even. Readers copy the value and retry if the sequence was
+ * odd or moved while they copied. The payload is kept in relaxed atomic words,
+ * so a torn copy is detected and discarded rather than being a data race.
+ */
+
+#pragma once
+#include <Arduino.h>
+#include <atomic>
+#include <type_traits>
+
+/**
+ * @brief Lock-free snapshot of a trivially copyable @p T.
+ *
+ * Exactly one task may call store(); any task may call load().
+ */
+template <class T>
+class Seqlock {
+  static_assert(std::is_trivially_copyable<T>::value, "Seqlock needs a trivially copyable type");
+
+public:
+  Seqlock() { store(T()); }
+
+  /** @brief Publish @p v (writer side, never blocks). */
+  void store(const T& v) {
+    uint32_t w[WORDS] = {};
+    memcpy(w, &v, sizeof(T));
+    uint32_t s = _seq.load(std::memory_order_relaxed);
+    _seq.store(s + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (int i = 0; i < WORDS; i++) _data[i].store(w[i], std::memory_order_relaxed);
+    _seq.store(s + 2, std::memory_order_release);
+  }
+
+  /**
+   * @brief Copy of the last published value.
+   * @param version set to the publish count of the returned value (if not null).
+   */
+  T load(uint32_t* version = nullptr) const {
+    uint32_t w[WORDS];
+    uint32_t s1, s2;
+    do {
+      s1 = _seq.load(std::memory_order_acquire);
+      for (int i = 0; i < WORDS; i++) w[i] = _data[i].load(std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_acquire);
+      s2 = _seq.load(std::memory_order_relaxed);
+    } while ((s1 & 1u) || s1 != s2);
+    T v;
+    memcpy(&v, w, sizeof(T));
+    if (version) *version = s1 / 2;
+    return v;
+  }
+
+  /** @brief Publish count; changes whenever store() ran. */
+  uint32_t version() const { return _seq.load(std::memory_order_acquire) / 2; }
+
+private:
+  static constexpr int WORDS = (sizeof(T) + 3) / 4;
+  std::atomic<uint32_t> _data[WORDS];
+  std::atomic<uint32_t> _seq{0};
+};
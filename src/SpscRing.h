@@ -0,0 +1,50 @@
+/**
+ * @file SpscRing.h
+ * @brief Lock-free single-producer / single-consumer ring buffer.
+ *
+ * One side (e.g. an interrupt handler) only calls push(), the other (the
+ * knitting logic) only calls pop(). Head and tail are free-running 32-bit
+ * counters published with release/acquire ordering, so neither side ever
+ * blocks or disables interrupts.
+ */
+
+#pragma once
+#include <Arduino.h>
+#include <atomic>
+
+/**
+ * @brief Fixed-capacity SPSC queue of @p N items (@p N a power of two).
+ */
+template <class T, uint32_t N>
+class SpscRing {
+  static_assert(N && (N & (N - 1)) == 0, "SpscRing size must be a power of two");
+
+public:
+  /** @brief Producer side. @return false (item dropped) if the ring is full. */
+  bool push(const T& v) {
+    uint32_t head = _head.load(std::memory_order_relaxed);
+    if (head - _tail.load(std::memory_order_acquire) == N) return false;
+    _items[head & (N - 1)] = v;
+    _head.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  /** @brief Consumer side. @return false if the ring is empty. */
+  bool pop(T& v) {
+    uint32_t tail = _tail.load(std::memory_order_relaxed);
+    if (tail == _head.load(std::memory_order_acquire)) return false;
+    v = _items[tail & (N - 1)];
+    _tail.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  /** @brief Items waiting (a snapshot; either side may move on right after). */
+  uint32_t size() const {
+    return _head.load(std::memory_order_acquire) - _tail.load(std::memory_order_acquire);
+  }
+
+private:
+  T _items[N];
+  std::atomic<uint32_t> _head{0};
+  std::atomic<uint32_t> _tail{0};
+};
@@ -0,0 +1,199 @@
+/**
+ * @file StateJournal.cpp
+ * @brief Append-only knitting state journal on LittleFS.
+ */
+
+#include "StateJournal.h"
+
+static constexpr uint16_t VERSION = 1;
+static constexpr int REC = 8;
+
+enum : uint8_t {
+  REC_HEADER = 'H',   // a = version, b = pattern file id
+  REC_ROW = 'R',      // b = activeRow
+  REC_PULSES = 'P',   // b = totalPulses
+  REC_SIZE = 'S',     // b = confirmation rows; all cleared
+  REC_CONFIRM = 'C',  // a = word index, b = 32 confirmation flags
+  REC_FILE = 'F',     // b = pattern file id; confirmations dropped
+};
+
+// FNV-1a of the pattern path, so confirmations are only restored for the
+// file they were made on.
+uint32_t StateJournal::fileId(const String& path) {
+  uint32_t h = 2166136261u;
+  for (char c : path) h = (h ^ (uint8_t)c) * 16777619u;
+  return h;
+}
+
+void StateJournal::encode(const Record& r, uint8_t* out) {
+  out[0] = r.type;
+  out[2] = (uint8_t)r.a;
+  out[3] = (uint8_t)(r.a >> 8);
+  for (int i = 0; i < 4; i++) out[4 + i] = (uint8_t)(r.b >> (8 * i));
+  RecordLog::seal(out, REC);
+}
+
+void StateJournal::decode(const uint8_t* in, Record& r) {
+  r.type = in[0];
+  r.a = in[2] | (in[3] << 8);
+  r.b = (uint32_t)in[4] | ((uint32_t)in[5] << 8) | ((uint32_t)in[6] << 16) | ((uint32_t)in[7] << 24);
+}
+
+void StateJournal::State::apply(const Record& r) {
+  switch (r.type) {
+    case REC_HEADER: file = r.b; break;
+    case REC_ROW: row = (int)r.b; break;
+    case REC_PULSES: pulses = r.b; break;
+    case REC_FILE: file = r.b; confirmed.resize(0); break;
+    case REC_SIZE: confirmed.resize(0); confirmed.resize((int)r.b); break;
+    case REC_CONFIRM: if (r.a < confirmed.words()) confirmed.setWord(r.a, r.b); break;
+    default: break;
+  }
+}
+
+// Folds the log into st. False if there is no log with a valid header.
+bool StateJournal::replay(State& st) {
+  bool found = false;
+  uint8_t rec[REC];
+  _log.replay(rec, REC, [](const uint8_t*) { return 0; }, [&](const uint8_t* in, size_t) {
+    Record r;
+    decode(in, r);
+    if (!found) {
+      if (r.type != REC_HEADER || r.a != VERSION) return false;
+      found = true;
+    }
+    st.apply(r);
+    return true;
+  });
+  return found;
+}
+
+bool StateJournal::restore(const String& file, int& row, uint32_t& pulses, RowFlags& confirmed) {
+  State st;
+  bool found = replay(st);
+  if (found) {
+    if (st.row >= 0) row = st.row;
+    pulses = st.pulses;
+    if (st.file == fileId(file) && st.confirmed.size() == confirmed.size()) {
+      for (int i = 0; i < st.confirmed.words(); i++) confirmed.setWord(i, st.confirmed.word(i));
+    }
+  }
+
+  // Start a fresh log from the restored state.
+  _queued.row = row;
+  _queued.pulses = pulses;
+  _queued.file = fileId(file);
+  _queued.rows = confirmed.size();
+  _ready = compact(_queued.file, row, pulses, confirmed);
+  return found;
+}
+
+bool StateJournal::queue(uint8_t type, uint16_t a, uint32_t b) {
+  Record r{type, a, b};
+  if (!_queue.push(r)) return false;
+  switch (type) {
+    case REC_FILE: _queued.file = b; _queued.rows = 0; break;
+    case REC_SIZE: _queued.rows = (int)b; break;
+    case REC_ROW: _queued.row = (int)b; break;
+    case REC_PULSES: _queued.pulses = b; break;
+    default: break;
+  }
+  return true;
+}
+
+// Each step updates _queued (or clears its change flag) only once its record
+// is queued, so whatever does not fit is picked up again by the next call.
+void StateJournal::record(const String& file, KnitEngine& engine) {
+  const RowFlags& confirmed = engine.confirmed();
+  KnitEngine::ConfirmChanges& changes = engine.confirmChanges();
+
+  uint32_t id = fileId(file);
+  if (id != _queued.file && !queue(REC_FILE, 0, id)) return;
+
+  // A new file or height, or clearing, restarts the logged confirmations
+  // from zero in one record; the words still set are then logged again.
+  if (confirmed.size() != _queued.rows || changes.cleared) {
+    if (!queue(REC_SIZE, 0, confirmed.size())) return;
+    changes.cleared = false;
+    for (int i = 0; i < confirmed.words(); i++) {
+      if (confirmed.word(i)) changes.words.set(i);
+    }
+  }
+
+  // Changed words only, found 32 at a time.
+  RowFlags& dirty = changes.words;
+  for (int k = 0; k < dirty.words(); k++) {
+    for (uint32_t m = dirty.word(k); m; m &= m - 1) {
+      int i = k * 32 + __builtin_ctz(m);
+      if (!queue(REC_CONFIRM, (uint16_t)i, confirmed.word(i))) return;
+      dirty.set(i, false);
+    }
+  }
+
+  int row = engine.activeRow();
+  uint32_t pulses = engine.totalPulses();
+  if (row != _queued.row && !queue(REC_ROW, 0, (uint32_t)row)) return;
+  if (pulses != _queued.pulses) queue(REC_PULSES, 0, pulses);
+}
+
+void StateJournal::add(const Record& r) {
+  if (_n == STATE_JOURNAL_BATCH) append();
+  if (_n == 0) _firstMs = millis();
+  encode(r, _buf + _n * REC);
+  _n++;
+}
+
+void StateJournal::drain() {
+  Record r;
+  while (_queue.pop(r)) add(r);
+}
+
+void StateJournal::loop() {
+  if (!_ready) return;
+  drain();
+
+  if (_n && millis() - _firstMs >= STATE_JOURNAL_FLUSH_MS) append();
+
+  // A snapshot of a very tall pattern can itself exceed the threshold.
+  if (_log.due()) {
+    append();
+    State st;
+    replay(st);
+    _ready = compact(st.file, st.row, st.pulses, st.confirmed);
+  }
+}
+
+void StateJournal::flush() {
+  drain();
+  append();
+}
+
+void StateJournal::append() {
+  if (!_n) return;
+  _log.append(_buf, _n * REC);
+  _n = 0;
+}
+
+// Writes the given state as a new log and swaps it in. Buffered records
+// are already part of that state, so they are dropped.
+bool StateJournal::compact(uint32_t file, int row, uint32_t pulses, const RowFlags& confirmed) {
+  bool ok = _log.compact([&](File& f) {
+    uint8_t rec[REC];
+    size_t bytes = 0;
+    auto put = [&](uint8_t type, uint16_t a, uint32_t b) {
+      Record r{type, a, b};
+      encode(r, rec);
+      bytes += f.write(rec, REC);
+    };
+    put(REC_HEADER, VERSION, file);
+    put(REC_ROW, 0, (uint32_t)row);
+    put(REC_PULSES, 0, pulses);
+    put(REC_SIZE, 0, confirmed.size());
+    for (int i = 0; i < confirmed.words(); i++) {
+      if (confirmed.word(i)) put(REC_CONFIRM, (uint16_t)i, confirmed.word(i));
+    }
+    return bytes;
+  });
+  if (ok) _n = 0;
+  return ok;
+}
@@ -0,0 +1,126 @@
+/**
+ * @file StateJournal.h
+ * @brief Crash-safe append-only journal of the knitting progress.
+ *
+ * Active row, carriage pulse total and row confirmations change on every
+ * carriage pass. Instead of rewriting a state file (or NVS) per event, each
+ * change is appended to a LittleFS log as an 8-byte record:
+ *
+ * | Offset | Size | Field |
+ * |---|---|---|
+ * | 0 | 1 | type (`H`eader, `R`ow, `P`ulses, `S`ize/clear, `C`onfirm word, `F`ile) |
+ * | 1 | 1 | check byte over bytes 2..7 and the type |
+ * | 2 | 2 | @c a (little-endian) |
+ * | 4 | 4 | @c b (little-endian) |
+ *
+ * Records are gathered in RAM and appended in one write per batch. When the
+ * log grows past @ref STATE_JOURNAL_COMPACT_BYTES it is replaced by a
+ * snapshot (see RecordLog). At boot the log is replayed up to the first
+ * damaged record.
+ *
+ * Recording and writing run on different tasks: record() only queues
+ * records (no flash access), loop() writes them and compacts. Compaction
+ * replays the log itself, so no copy of the confirmations is kept in RAM.
+ */
+
+#pragma once
+#include <Arduino.h>
+#include <LittleFS.h>
+#include "RowFlags.h"
+#include "KnitEngine.h"
+#include "RecordLog.h"
+#include "SpscRing.h"
+
+/** @brief Journal file in LittleFS. */
+static constexpr const char* STATE_JOURNAL_PATH = "/state.log";
+
+/** @brief Snapshot being written during compaction. */
+static constexpr const char* STATE_JOURNAL_TMP = "/state.tmp";
+
+/** @brief Buffered records are appended at most this long after the first one (ms). */
+static constexpr uint32_t STATE_JOURNAL_FLUSH_MS = 1000;
+
+/** @brief Records per append (one 256-byte flash page). */
+static constexpr int STATE_JOURNAL_BATCH = 32;
+
+/** @brief Log size that triggers compaction into a snapshot. */
+static constexpr size_t STATE_JOURNAL_COMPACT_BYTES = 8192;
+
+/** @brief Records queued between record() and loop() (power of two). */
+static constexpr uint32_t STATE_JOURNAL_QUEUE = 128;
+
+/**
+ * @brief Journal of activeRow, totalPulses and row confirmations.
+ *
+ * record() compares row, pulses, file and height with what was last queued
+ * and takes the changed confirmation words from KnitEngine::confirmChanges().
+ * If the queue is full the rest simply waits for the next call.
+ */
+class StateJournal {
+public:
+  /**
+   * @brief Replay the log into @p row, @p pulses and @p confirmed.
+   *
+   * Confirmations are only restored if they were logged for the same
+   * pattern @p file and knitted height. Afterwards the log is compacted so
+   * it starts from the restored state. Values not in the log are left as
+   * they are.
+   *
+   * @return true if a log was found and replayed.
+   */
+  bool restore(const String& file, int& row, uint32_t& pulses, RowFlags& confirmed);
+
+  /** @brief Queue whatever changed since the last call (knitting task, no flash access). */
+  void record(const String& file, KnitEngine& engine);
+
+  /** @brief Write queued records; append and compact when due (web task). */
+  void loop();
+
+  /** @brief Append queued and buffered records now (shutdown, reboot). */
+  void flush();
+
+private:
+  struct Record {
+    uint8_t type;
+    uint16_t a;
+    uint32_t b;
+  };
+
+  // Progress as described by a sequence of records (replay only).
+  struct State {
+    int row = -1;
+    uint32_t pulses = 0;
+    uint32_t file = 0;
+    RowFlags confirmed;
+
+    void apply(const Record& r);
+  };
+
+  // What record() has queued; confirmation words are not mirrored.
+  struct Queued {
+    int row = -1;
+    uint32_t pulses = 0;
+    uint32_t file = 0;
+    int rows = 0;
+  };
+
+  bool queue(uint8_t type, uint16_t a, uint32_t b);
+  void drain();
+  void add(const Record& r);
+  void append();
+  bool replay(State& st);
+  bool compact(uint32_t file, int row, uint32_t pulses, const RowFlags& confirmed);
+
+  static uint32_t fileId(const String& path);
+  static void encode(const Record& r, uint8_t* out);
+  static void decode(const uint8_t* in, Record& r);
+
+  Queued _queued;
+  SpscRing<Record, STATE_JOURNAL_QUEUE> _queue;
+  RecordLog _log{STATE_JOURNAL_PATH, STATE_JOURNAL_TMP, STATE_JOURNAL_COMPACT_BYTES};
+
+  uint8_t _buf[STATE_JOURNAL_BATCH * 8];
+  int _n = 0;
+  uint32_t _firstMs = 0;
+  bool _ready = false;
+};
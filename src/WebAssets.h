@@ -0,0 +1,25 @@
+/**
+ * @file WebAssets.h
+ * @brief Web UI files compiled into flash.
+ *
+ * tools/build_web.py turns @c web/ into @c WebAssetData.h before each build:
+ * minified, gzip-compressed, with a strong ETag per file. @c app.js and
+ * @c app.css get content-hashed names, so they can be cached indefinitely;
+ * the page itself is revalidated on every load (usually a 304).
+ */
+
+#pragma once
+#include <Arduino.h>
+
+/** @brief Max-age for content-hashed assets (one year, in seconds). */
+static constexpr uint32_t WEB_ASSET_MAX_AGE = 31536000;
+
+/** @brief One file of the web UI. */
+struct WebAsset {
+  const char* path;     /**< @brief URL path ("/" for the page). */
+  const char* type;     /**< @brief Content-Type. */
+  const char* etag;     /**< @brief Strong ETag, quoted. */
+  const uint8_t* data;  /**< @brief gzip data in flash. */
+  size_t len;           /**< @brief Bytes in @ref data. */
+  bool immutable;       /**< @brief Content-hashed name: cache for @ref WEB_ASSET_MAX_AGE. */
+};
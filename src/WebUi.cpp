@@ -2,32 +2,50 @@
  * @file WebUi.cpp
  * @brief Web UI implementation (HTML + REST endpoints).
  *
- * This file is intentionally self-contained: it embeds the HTML/JS UI and registers WebServer routes.
+ * Registers the HttpServer routes: the UI files built from web/ (see WebAssets.h) and the API.
  * Doxygen comments for public APIs are in WebUi.h; this file documents key internal helpers and endpoints.
  */
 
 // WebUi.cpp - full current version
 // Provides:
-// - Main web page (edit + knit) with canvas grid
+// - Main web page (edit + knit) with canvas grid; HTML/JS/CSS live in web/
 // - Row/column numbers (needles under grid, rows on right)
-// - File management in LittleFS (/patterns/*.json): list/load/save/delete/upload/download
+// - File management in LittleFS (/patterns/*.json, *.kpb): list/load/save/delete/upload/download/convert
 // - Config modal: active/confirmed colors, brightness, auto-advance, blink warning, row counting direction
-// - API endpoints: /api/files, /api/pattern (GET/POST), /api/delete, /api/row, /api/confirm,
-//                  /api/state, /api/config (GET/POST), /download, /upload
+// - API endpoints: /api/files, /api/pattern (GET/POST), /api/pattern.bin (GET/POST), /api/pattern/patch,
+//                  /api/pattern/rows, /api/delete, /api/convert, /api/row,
+//                  /api/confirm, /api/state, /api/events, /api/config (GET/POST),
+//                  /download, /upload
 //
 // Notes:
 // - Filenames are normalized so that "diamond.json" becomes "/patterns/diamond.json"
 // - /api/row interprets delta as a STEP (+1/-1) and applies rowFromBottom + wrap-around.
+// - /api/events pushes state changes (Server-Sent Events); /api/state stays for
+//   browsers without EventSource and as the fallback while the stream is down.
+// - /api/files answers from PatternCatalog; every write to /patterns updates it.
 
 #include "WebUi.h"
+#include "PatternBin.h"
+#include "PatternWindow.h"
+#include "PatternCatalog.h"
+#include "RecordLog.h"
+#include "PatternViews.h"
+#include "LedLayout.h"
+#include "EventStream.h"
+#include "WebAssetData.h"
 
 #include <LittleFS.h>
 #include <ctype.h>
 
-// We call saveConfig() so config/row changes from the web persist immediately.
-extern void saveConfig(const AppConfig& cfg);
-
 static WebUiDeps D;
+static EventStream events;
+static PatternCatalog catalog;  // every write to /patterns goes through it
+
+// /api/files page size: default and largest accepted limit.
+static constexpr int FILES_PAGE_DEFAULT = 50;
+static constexpr int FILES_PAGE_MAX = 200;
+// /api/files entries per response piece (about one TCP segment).
+static constexpr int FILES_PER_FILL = 8;
 
 // ------------------------------------------------------------
 // Helpers
@@ -76,67 +94,218 @@ static String normalizePatternPath(String file) {
   return file;
 }
 
-static int wrapRowIndex(int r, int h) {
-  if (h <= 0) return 0;
-  while (r < 0) r += h;
-  while (r >= h) r -= h;
-  return r;
-}
+// Holds the pattern lock for a handler's scope when it changes the knitted
+// pattern or its file; the knitting task keeps running, only its LED update
+// waits.
+class KnitPatternLock {
+public:
+  explicit KnitPatternLock(bool take) : _held(take) {
+    if (_held) D.knit->lockPattern();
+  }
+  ~KnitPatternLock() {
+    if (_held) D.knit->unlockPattern();
+  }
 
-// Step semantics:
-// delta is "next row" (+1) or "previous row" (-1) in the user-selected direction.
-static void stepRowFromWeb(int deltaStep) {
-  int h = D.pattern->h;
-  if (h <= 0) return;
+private:
+  bool _held;
+};
 
-  int dir = D.cfg->rowFromBottom ? -1 : +1;
-  D.cfg->warnBlinkActive = false;
-  D.cfg->activeRow = wrapRowIndex(D.cfg->activeRow + deltaStep * dir, h);
+static String rowStateJson(const KnitSnapshot& st) {
+  return "{\"ok\":true,\"activeRow\":" + String(st.activeRow) +
+         ",\"patternRow\":" + String(st.patternRow) + "}";
+}
 
-  saveConfig(*D.cfg);
+static void sendRowState(const KnitSnapshot& st) {
+  D.server->send(200, "application/json", rowStateJson(st));
 }
 
+// Answer to a row command, sent once the snapshot shows the command as
+// handled (or after KNIT_WAIT_MS). The handler returns at once; the server
+// asks again on every pass, so the web task never waits for the knitting
+// task.
+class RowStateResponse : public HttpBodySource {
+public:
+  explicit RowStateResponse(uint32_t ticket) : _ticket(ticket), _start(millis()) {}
+
+  bool fill(Print& out) override {
+    KnitSnapshot st = D.knit->state();
+    if (!st.hasTicket(_ticket) && millis() - _start < KNIT_WAIT_MS) return true;  // not yet
+    out.print(rowStateJson(st));
+    _done = true;
+    return true;
+  }
+  bool done() const override { return _done; }
+
+private:
+  uint32_t _ticket;
+  uint32_t _start;
+  bool _done = false;
+};
+
 // ------------------------------------------------------------
 // LittleFS helpers required by WebUi.h
 // ------------------------------------------------------------
 
-bool loadPatternFile(const String& pathIn, Pattern& p) {
-  String path = normalizePatternPath(pathIn);
+static bool isBinaryPath(const String& path) {
+  return path.endsWith(PATTERN_BIN_EXT);
+}
+
+// Format is sniffed from the content, so a renamed file still loads.
+static bool readPatternFile(const String& path, Pattern& p) {
   if (!LittleFS.exists(path)) return false;
 
   File f = LittleFS.open(path, "r");
   if (!f) return false;
-  String json = f.readString();
+
+  uint8_t head[4];
+  size_t n = f.read(head, sizeof(head));
+  bool ok;
+  if (isPatternBin(head, n)) {
+    f.seek(0);
+    ok = readPatternBin(f, p);
+  } else {
+    f.seek(0);
+    ok = jsonToPattern(f, p);
+  }
   f.close();
+  return ok;
+}
+
+bool loadPatternFile(const String& pathIn, Pattern& p) {
+  return readPatternFile(normalizePatternPath(pathIn), p);
+}
 
-  return jsonToPattern(json, p);
+// Saves are written to a temporary file outside /patterns and renamed over
+// the target once complete (as uploads are): a failed write keeps the old
+// file, and the knitting task never reads a half-written one.
+static String saveTmpPath(const String& path) {
+  return String("/save") + (isBinaryPath(path) ? PATTERN_BIN_EXT : ".json");
+}
+
+// Format follows the extension: *.kpb is binary, anything else JSON.
+// Returns the bytes written to saveTmpPath(path), 0 if the write failed.
+static size_t writeSaveTmp(const String& path, const Pattern& p) {
+  const String tmp = saveTmpPath(path);
+  File f = LittleFS.open(tmp, "w");
+  if (!f) return 0;
+  size_t bytes = isBinaryPath(path) ? writePatternBin(f, p) : writePatternJson(f, p);
+  f.close();
+  if (!bytes) LittleFS.remove(tmp);
+  return bytes;
 }
 
 bool savePatternFile(const String& pathIn, const Pattern& p) {
   String path = normalizePatternPath(pathIn);
-  File f = LittleFS.open(path, "w");
+  const String tmp = saveTmpPath(path);
+  size_t bytes = writeSaveTmp(path, p);
+  if (!bytes) return false;
+  if (!replaceFile(tmp.c_str(), path.c_str())) {
+    LittleFS.remove(tmp);
+    return false;
+  }
+  catalog.update(path, p, bytes);
+  return true;
+}
+
+// JSON written by writePatternJson() has fixed-width rows after a known
+// header; anything else (hand-edited, reformatted) is refused.
+static bool patchJsonRows(File& f, const Pattern& p, const RowFlags& rows) {
+  String head = patternJsonHeader(p);
+  const size_t stride = p.w + 3;  // quotes + comma
+  if (f.size() != head.length() + p.h * stride - 1 + 2) return false;
+
+  if (!f.seek(0)) return false;
+  uint8_t buf[64];
+  for (size_t off = 0; off < head.length();) {
+    size_t k = min(sizeof(buf), head.length() - off);
+    if (f.read(buf, k) != k || memcmp(buf, head.c_str() + off, k)) return false;
+    off += k;
+  }
+
+  for (int r = 0; r < p.h; r++) {
+    if (!rows.get(r)) continue;
+    if (!f.seek(head.length() + r * stride)) return false;
+    if (writePatternJsonRow(f, p.row(r), p.w) != (size_t)p.w + 2) return false;
+  }
+  return true;
+}
+
+// Rewrites only the rows flagged in rows, if the file layout allows it
+// (packed .kpb, or JSON as written by savePatternFile). False if it does
+// not, or if anything went wrong half way.
+static bool patchRowsInPlace(const String& path, const Pattern& p, const RowFlags& rows, uint32_t& bytes) {
+  if (!LittleFS.exists(path)) return false;
+  File f = LittleFS.open(path, "r+");
   if (!f) return false;
-  f.print(patternToJson(p));
+  bool ok;
+  if (isBinaryPath(path)) {
+    PatternBinHeader hdr;
+    ok = readPatternBinHeader(f, hdr) && writePatternBinRows(f, hdr, p, rows);
+  } else {
+    ok = patchJsonRows(f, p, rows);
+  }
+  bytes = f.size();
   f.close();
+  return ok;
+}
+
+// In place where possible, otherwise the whole file is saved again.
+bool patchPatternFile(const String& pathIn, const Pattern& p, const RowFlags& rows) {
+  String path = normalizePatternPath(pathIn);
+  uint32_t bytes;
+  if (!patchRowsInPlace(path, p, rows, bytes)) return savePatternFile(path, p);
+  catalog.update(path, p, bytes);
   return true;
 }
 
+// Saves p as path for a handler. The file is written outside the pattern
+// lock: flagged rows in place when rows is given and the layout allows it,
+// otherwise the whole file through saveTmpPath(). For the knitted file the
+// lock is held to rename it into place, swap p into the knitted pattern
+// (unless the saved file is knitted through a window, see
+// patternWantsWindow()) and tell the knitting task, and for in-place rows
+// of a windowed file. p then holds the old pattern.
+static bool storePattern(const String& path, Pattern& p, const RowFlags* rows, bool knitted, bool clearConfirmed) {
+  // Decided by the new height: a row edit can move a file into or out of the window
+  const bool loaded = knitted && !(isBinaryPath(path) && p.h > PATTERN_WINDOW_ROWS);
+  uint32_t bytes = 0;
+  bool inPlace = false;
+  if (rows) {
+    KnitPatternLock lock(knitted && !loaded);
+    inPlace = patchRowsInPlace(path, p, *rows, bytes);
+  }
+  if (!inPlace) bytes = writeSaveTmp(path, p);
+
+  bool ok = inPlace || bytes > 0;
+  {
+    KnitPatternLock lock(knitted);
+    if (!inPlace && ok) ok = replaceFile(saveTmpPath(path).c_str(), path.c_str());
+    if (ok && loaded) D.pattern->swap(p);
+    // Also after a failed save: rows of a windowed file may have changed
+    if (knitted) D.knit->patternChanged(path, clearConfirmed);
+  }
+  if (!ok) {
+    LittleFS.remove(saveTmpPath(path));
+    return false;
+  }
+  catalog.update(path, loaded ? *D.pattern : p, bytes);
+  return true;
+}
+
+bool convertPatternFile(const String& srcIn, const String& dstIn) {
+  Pattern p;
+  if (!loadPatternFile(srcIn, p)) return false;
+  return savePatternFile(dstIn, p);
+}
+
+// From the catalog; the directory is not walked.
 String listPatternFilesJson() {
   String out = "[";
-  File dir = LittleFS.open("/patterns");
-  if (!dir || !dir.isDirectory()) return "[]";
-
-  File f = dir.openNextFile();
-  bool first = true;
-  while (f) {
-    if (!f.isDirectory()) {
-      if (!first) out += ",";
-      first = false;
-      out += "\"";
-      out += htmlEscape(String(f.name()));   // keep full path in value
-      out += "\"";
-    }
-    f = dir.openNextFile();
+  for (int i = 0; i < catalog.count(); i++) {
+    if (i) out += ",";
+    out += "\"";
+    out += htmlEscape(catalog.entry(i).path);
+    out += "\"";
   }
   out += "]";
   return out;
@@ -146,12 +315,48 @@ String listPatternFilesJson() {
 // Upload support
 // ------------------------------------------------------------
 
+// An upload is written to a temporary file outside /patterns and renamed
+// over its target once complete, so an aborted upload leaves the old file
+// and the knitting task never reads a half-written one.
 static File uploadFile;
+static String uploadPath;
+static String uploadTmp;      // /upload.json or /upload.kpb (same format as the target)
+static bool uploadRejected;   // the target was kept (see installUpload())
+
+// Moves the finished upload over uploadPath. The knitted file is replaced
+// under the pattern lock and the knitted pattern follows it; its new
+// contents are checked first so a bad upload cannot replace it. Files read
+// through a window are always checked, since their rows never are.
+static bool installUpload() {
+  const bool isCurrent = (uploadPath == D.cfg->currentPatternFile);
+  const bool windowed = patternWantsWindow(uploadTmp);
+  const bool load = isCurrent && !windowed;
+  Pattern p;
+  if (load && !readPatternFile(uploadTmp, p)) return false;
+  if (windowed) {
+    // Too large to load: checked row by row instead
+    File f = LittleFS.open(uploadTmp, "r");
+    PatternBinHeader hdr;
+    bool ok = f && verifyPatternBin(f, hdr);
+    if (f) f.close();
+    if (!ok) return false;
+  }
+
+  {
+    KnitPatternLock lock(isCurrent);
+    if (!replaceFile(uploadTmp.c_str(), uploadPath.c_str())) return false;
+    if (load) D.pattern->swap(p);
+    if (isCurrent) D.knit->patternChanged(uploadPath, true);
+  }
+  catalog.update(uploadPath);
+  return true;
+}
 
 static void handleUpload() {
   HTTPUpload& up = D.server->upload();
 
   if (up.status == UPLOAD_FILE_START) {
+    if (up.filename.isEmpty()) return;  // not a multipart file
     String fname = up.filename;
     fname.replace("..", "");
     fname.replace("\\", "/");
@@ -160,94 +365,497 @@ static void handleUpload() {
     int s = fname.lastIndexOf('/');
     if (s >= 0) fname = fname.substring(s + 1);
 
-    if (!fname.endsWith(".json")) fname += ".json";
-    String path = "/patterns/" + fname;
+    if (!fname.endsWith(".json") && !fname.endsWith(PATTERN_BIN_EXT)) fname += ".json";
+    uploadPath = "/patterns/" + fname;
+    uploadTmp = String("/upload") + (isBinaryPath(uploadPath) ? PATTERN_BIN_EXT : ".json");
+    uploadRejected = false;
 
-    uploadFile = LittleFS.open(path, "w");
+    uploadFile = LittleFS.open(uploadTmp, "w");
   }
   else if (up.status == UPLOAD_FILE_WRITE) {
     if (uploadFile) uploadFile.write(up.buf, up.currentSize);
   }
   else if (up.status == UPLOAD_FILE_END) {
-    if (uploadFile) uploadFile.close();
+    if (uploadFile) {
+      uploadFile.close();
+      if (!installUpload()) {
+        LittleFS.remove(uploadTmp);
+        uploadRejected = true;
+      }
+    }
+  }
+  else if (up.status == UPLOAD_FILE_ABORTED) {
+    if (uploadFile) {
+      uploadFile.close();
+      LittleFS.remove(uploadTmp);
+    }
+    uploadPath = String();
   }
 }
 
+// Names an existing file with the same stitches, if there is one.
 static void handleUploadDone() {
-  D.server->send(200, "text/plain", "Upload OK");
+  if (uploadRejected) {
+    uploadRejected = false;
+    uploadPath = String();
+    D.server->send(400, "text/plain", "Upload rejected, file kept");
+    return;
+  }
+  String msg = "Upload OK";
+  int i = uploadPath.length() ? catalog.indexOf(uploadPath) : -1;
+  const CatalogEntry* dup = i >= 0 ? catalog.duplicateOf(i) : nullptr;
+  if (dup) msg += " (same pattern as " + dup->path.substring(dup->path.lastIndexOf('/') + 1) + ")";
+  uploadPath = String();
+  D.server->send(200, "text/plain", msg);
 }
 
 // ------------------------------------------------------------
 // API endpoints
 // ------------------------------------------------------------
 
+// One /api/files entry; dup names another file with the same stitches.
+static void printFileEntry(Print& out, int i, bool comma) {
+  const CatalogEntry& e = catalog.entry(i);
+  const CatalogEntry* dup = catalog.duplicateOf(i);
+  if (comma) out.print(",");
+  out.print("{\"file\":\"");
+  out.print(htmlEscape(e.path));
+  out.print("\",\"name\":\"");
+  out.print(htmlEscape(e.name));
+  out.print("\",\"w\":");
+  out.print(e.w);
+  out.print(",\"h\":");
+  out.print(e.h);
+  out.print(",\"bytes\":");
+  out.print(e.bytes);
+  out.print(",\"mod\":");
+  out.print(e.mod);
+  out.print(",\"hash\":");
+  out.print(e.hash);
+  if (dup) {
+    out.print(",\"dup\":\"");
+    out.print(htmlEscape(dup->path));
+    out.print("\"");
+  }
+  out.print("}");
+}
+
+// One /api/files page, a few entries per fill() as the client reads it.
+// Catalog changes reorder the entries, so one before the end cuts the
+// response off.
+class FilesResponse : public HttpBodySource {
+public:
+  FilesResponse(PatternCatalog::Sort sort, bool desc, int offset, int limit, const String& q, bool dupOnly)
+      : _sort(sort), _desc(desc), _offset(offset), _limit(limit), _q(q), _dupOnly(dupOnly),
+        _mod(catalog.mod()) {}
+
+  bool fill(Print& out) override;
+  bool done() const override { return _done; }
+
+private:
+  bool matches(int i);
+
+  PatternCatalog::Sort _sort;
+  bool _desc;
+  int _offset;
+  int _limit;
+  String _q;  // lower case
+  bool _dupOnly;
+  uint32_t _mod;
+  int _k = -1;  // next position in the sort order; -1 before the header
+  int _total = 0;
+  int _shown = 0;
+  bool _done = false;
+};
+
+bool FilesResponse::matches(int i) {
+  if (_dupOnly && !catalog.duplicateOf(i)) return false;
+  if (_q.length()) {
+    const CatalogEntry& e = catalog.entry(i);
+    String hay = e.path + "\n" + e.name;
+    hay.toLowerCase();
+    if (hay.indexOf(_q) < 0) return false;
+  }
+  return true;
+}
+
+bool FilesResponse::fill(Print& out) {
+  if (catalog.mod() != _mod) return false;
+  const std::vector<uint16_t>& ord = catalog.order(_sort);
+  const int n = (int)ord.size();
+  const bool filtered = _q.length() || _dupOnly;
+
+  if (_k < 0) {
+    out.print("{\"mod\":");
+    out.print(_mod);
+    out.print(",\"offset\":");
+    out.print(_offset);
+    out.print(",\"files\":[");
+    _k = filtered ? 0 : min(_offset, n);
+  }
+
+  int batch = 0;
+  if (!filtered) {
+    for (; _k < n && _shown < _limit && batch < FILES_PER_FILL; _k++, batch++) {
+      printFileEntry(out, ord[_desc ? n - 1 - _k : _k], _shown++);
+    }
+    if (_k < n && _shown < _limit) return true;
+    _total = n;
+  } else {
+    // Filters need one pass over the in-RAM entries for the total.
+    for (; _k < n && batch < FILES_PER_FILL; _k++) {
+      int i = ord[_desc ? n - 1 - _k : _k];
+      if (!matches(i)) continue;
+      if (_total++ >= _offset && _shown < _limit) {
+        printFileEntry(out, i, _shown++);
+        batch++;
+      }
+    }
+    if (_k < n) return true;
+  }
+
+  out.print("],\"total\":");
+  out.print(_total);
+  out.print("}");
+  _done = true;
+  return true;
+}
+
+// Without parameters: the bare array of paths, as before. With any of
+// offset, limit, sort (path|name|size|mod), order (asc|desc), q (text in
+// path or name) or dup=1 (only files with a duplicate): one page of
+// entries with their catalog data. No file is opened either way; an
+// unfiltered page costs only its entries.
 static void apiFiles() {
-  D.server->send(200, "application/json", listPatternFilesJson());
+  HttpServer& S = *D.server;
+  if (!S.hasArg("offset") && !S.hasArg("limit") && !S.hasArg("sort") && !S.hasArg("order") &&
+      !S.hasArg("q") && !S.hasArg("dup")) {
+    S.send(200, "application/json", listPatternFilesJson());
+    return;
+  }
+
+  String sortArg = S.arg("sort");
+  PatternCatalog::Sort sort = PatternCatalog::SORT_PATH;
+  if (sortArg == "name") sort = PatternCatalog::SORT_NAME;
+  else if (sortArg == "size") sort = PatternCatalog::SORT_SIZE;
+  else if (sortArg == "mod") sort = PatternCatalog::SORT_MOD;
+  const bool desc = S.arg("order") == "desc";
+  const int offset = max(0, (int)S.arg("offset").toInt());
+  const int limit = S.hasArg("limit") ? constrain((int)S.arg("limit").toInt(), 1, FILES_PAGE_MAX) : FILES_PAGE_DEFAULT;
+  String q = S.arg("q");
+  q.toLowerCase();
+  const bool dupOnly = S.arg("dup") == "1";
+
+  S.sendChunked(200, "application/json", new FilesResponse(sort, desc, offset, limit, q, dupOnly));
 }
 
-static void apiGetPattern() {
-  String file = D.server->arg("file");
+// Makes ?file= (default: the current file) the knitted pattern, as every
+// pattern load from the UI does. Large binary files are never loaded whole;
+// their rows come from win. False (response sent) if the file is invalid.
+static bool selectPattern(String& file, PatternWindow& win, bool& windowed) {
+  file = D.server->arg("file");
   if (file.isEmpty()) file = D.cfg->currentPatternFile;
   file = normalizePatternPath(file);
 
+  windowed = patternWantsWindow(file) && win.open(file);
+
   Pattern p;
-  if (!loadPatternFile(file, p)) {
+  if (!windowed && !loadPatternFile(file, p)) {
+    if (LittleFS.exists(file)) { D.server->send(400, "text/plain", "Invalid pattern file"); return false; }
     // If missing, create from current pattern (or default empty)
-    p = *D.pattern;
+    if (!p.assign(*D.pattern)) { D.server->send(500, "text/plain", "Out of memory"); return false; }
     savePatternFile(file, p);
   }
 
+  {
+    KnitPatternLock lock(true);
+    if (!windowed) D.pattern->swap(p);
+    D.knit->patternChanged(file, false);  // re-selects the knitted rows and keeps activeRow valid
+  }
   D.cfg->currentPatternFile = file;
-  *D.pattern = p;
-
-  // keep activeRow valid
-  D.cfg->activeRow = wrapRowIndex(D.cfg->activeRow, D.pattern->h);
   saveConfig(*D.cfg);
+  return true;
+}
 
-  String out = "{";
-  out += "\"file\":\"" + htmlEscape(file) + "\",";
-  out += "\"activeRow\":" + String(D.cfg->activeRow) + ",";
-  out += "\"pattern\":" + patternToJson(*D.pattern);
-  out += "}";
-  D.server->send(200, "application/json", out);
+// GET /api/pattern(.bin) body, a batch of rows per fill() as the client
+// reads it; nothing pattern-sized is buffered. The first batch waits (as
+// RowStateResponse does) until the knitting task has applied the selection,
+// so the row position in the header belongs to this pattern. If the
+// knitted pattern changes before the last batch the response is cut off
+// rather than mixing two patterns.
+class PatternResponse : public HttpBodySource {
+public:
+  explicit PatternResponse(bool wire) : _wire(wire), _mem(*D.pattern) {}
+
+  PatternWindow win;  // rows of a large file (selectPattern())
+
+  void begin(const String& file, bool windowed) {
+    _info.file = file;
+    _windowed = windowed;
+    _gen = D.knit->lastPatternChange();
+    _start = millis();
+  }
+
+  bool fill(Print& out) override;
+  bool done() const override { return _done; }
+
+private:
+  bool _wire;
+  PatternRowSource _mem;
+  PatternWireInfo _info;
+  bool _windowed = false;
+  uint32_t _gen = 0;
+  uint32_t _start = 0;
+  int _row = 0;  // next row to send
+  bool _done = false;
+};
+
+bool PatternResponse::fill(Print& out) {
+  if (D.knit->lastPatternChange() != _gen) return false;
+  if (_row == 0) {
+    KnitSnapshot st = D.knit->state();
+    if (!st.hasPattern(_gen) && millis() - _start < KNIT_WAIT_MS) return true;  // not yet
+    _info.activeRow = st.activeRow;
+    _info.patternRow = st.patternRow;
+  }
+  RowSource& rows = _windowed ? (RowSource&)win : _mem;
+  const String& name = _windowed ? win.name() : D.pattern->name;
+  const int h = rows.height();
+  const int rowBytes = _wire ? (rows.width() + 7) / 8 : rows.width() + 3;
+  const int last = min(h, _row + max(1, (int)HTTP_FILL_BYTES / rowBytes));
+
+  if (_wire) {
+    if (!writePatternWire(out, rows, name, _info, _row, last)) return false;
+  } else {
+    if (_row == 0) {
+      out.print("{\"file\":\"");
+      out.print(htmlEscape(_info.file));
+      out.print("\",\"activeRow\":");
+      out.print(_info.activeRow);
+      out.print(",\"patternRow\":");
+      out.print(_info.patternRow);
+      out.print(",\"pattern\":");
+    }
+    if (!writePatternJson(out, rows, name, _row, last)) return false;
+    if (last == h) out.print("}");
+  }
+  _row = last;
+  _done = last == h;
+  return true;
+}
+
+static void sendPattern(bool wire) {
+  PatternResponse* body = new PatternResponse(wire);
+  String file;
+  bool windowed;
+  if (!selectPattern(file, body->win, windowed)) {
+    delete body;
+    return;
+  }
+  body->begin(file, windowed);
+  D.server->sendChunked(200, wire ? PATTERN_WIRE_TYPE : "application/json", body);
+}
+
+static void apiGetPattern() { sendPattern(false); }
+
+// POST /api/pattern: {"file":"...","pattern":{...}} is parsed while the
+// body arrives through the upload handler, like /api/pattern.bin below.
+struct JsonUpload {
+  Pattern pattern;
+  PatternJsonReader reader;
+  JsonUpload() : reader(pattern, true) {}
+};
+static JsonUpload* jsonUpload = nullptr;
+
+static void dropJsonUpload() {
+  delete jsonUpload;
+  jsonUpload = nullptr;
+}
+
+static void handlePatternJsonBody() {
+  HTTPUpload& up = D.server->upload();
+
+  if (up.status == UPLOAD_FILE_START) {
+    dropJsonUpload();
+    jsonUpload = new JsonUpload();
+  }
+  else if (up.status == UPLOAD_FILE_WRITE) {
+    if (jsonUpload) jsonUpload->reader.feed(up.buf, up.currentSize);
+  }
+  else if (up.status == UPLOAD_FILE_ABORTED) {
+    dropJsonUpload();
+  }
 }
 
 static void apiPostPattern() {
+  bool ok = jsonUpload && jsonUpload->reader.done();
+  if (ok && jsonUpload->reader.file().isEmpty()) { dropJsonUpload(); D.server->send(400, "text/plain", "Missing file"); return; }
+  if (!ok) { dropJsonUpload(); D.server->send(400, "text/plain", "Invalid pattern"); return; }
+  String file = normalizePatternPath(jsonUpload->reader.file());
+
+  // The saved pattern is knitted from here on; confirmations are reset
+  bool saved = storePattern(file, jsonUpload->pattern, nullptr, true, true);
+  dropJsonUpload();
+  if (!saved) { D.server->send(500, "text/plain", "Write failed"); return; }
+  D.cfg->currentPatternFile = file;
+  saveConfig(*D.cfg);
+
+  D.server->send(200, "application/json", "{\"ok\":true}");
+}
+
+// Same as GET /api/pattern in the wire format (see PatternBin.h): packed
+// rows instead of "0101..." strings, about 8x fewer bytes and no parsing
+// in the browser.
+static void apiGetPatternBin() { sendPattern(true); }
+
+// POST /api/pattern.bin: the body arrives through the upload handler and is
+// decoded row by row, so it is never held as text.
+// The server reads one such body at a time, so one reader is enough
+// (the same holds for jsonUpload above).
+static PatternWireReader* wireUpload = nullptr;
+
+static void dropWireUpload() {
+  delete wireUpload;
+  wireUpload = nullptr;
+}
+
+static void handlePatternBinBody() {
+  HTTPUpload& up = D.server->upload();
+
+  if (up.status == UPLOAD_FILE_START) {
+    dropWireUpload();
+    wireUpload = new PatternWireReader();
+  }
+  else if (up.status == UPLOAD_FILE_WRITE) {
+    if (wireUpload) wireUpload->feed(up.buf, up.currentSize);
+  }
+  else if (up.status == UPLOAD_FILE_ABORTED) {
+    dropWireUpload();
+  }
+}
+
+static void apiPostPatternBin() {
+  bool ok = wireUpload && wireUpload->done();
+  if (ok && wireUpload->file().isEmpty()) { dropWireUpload(); D.server->send(400, "text/plain", "Missing file"); return; }
+  if (!ok) { dropWireUpload(); D.server->send(400, "text/plain", "Invalid pattern"); return; }
+  String file = normalizePatternPath(wireUpload->file());
+
+  bool saved = storePattern(file, wireUpload->pattern(), nullptr, true, true);
+  dropWireUpload();
+  if (!saved) { D.server->send(500, "text/plain", "Write failed"); return; }
+  D.cfg->currentPatternFile = file;
+  saveConfig(*D.cfg);
+
+  D.server->send(200, "application/json", "{\"ok\":true}");
+}
+
+// Applies a cell/row patch (see applyPatternPatch()) to a stored pattern.
+// Only the touched rows are written back where the file format allows it.
+static void apiPatchPattern() {
   String body = D.server->arg("plain");
 
-  // extract "file":"..."
   int fpos = body.indexOf("\"file\":\"");
   if (fpos < 0) { D.server->send(400, "text/plain", "Missing file"); return; }
   fpos += 8;
   int fend = body.indexOf("\"", fpos);
   if (fend < 0) { D.server->send(400, "text/plain", "Bad file"); return; }
-  String file = body.substring(fpos, fend);
-  file = normalizePatternPath(file);
+  String file = normalizePatternPath(body.substring(fpos, fend));
+
+  // The patch goes to a copy (of the loaded pattern, or of the file when it
+  // is not loaded or knitted through a window), which replaces the knitted
+  // pattern only once the file is written: a bad patch or a failed write
+  // leaves the knitted pattern as it was.
+  const bool isCurrent = (file == D.cfg->currentPatternFile);
+  const bool loaded = isCurrent && !patternWantsWindow(file);
+  Pattern p;
+  if (loaded) {
+    if (!p.assign(*D.pattern)) { D.server->send(500, "text/plain", "Out of memory"); return; }
+  } else if (!loadPatternFile(file, p)) {
+    D.server->send(400, "text/plain", "Cannot load pattern");
+    return;
+  }
 
-  // extract "pattern":{...}
-  int ppos = body.indexOf("\"pattern\":");
-  if (ppos < 0) { D.server->send(400, "text/plain", "Missing pattern"); return; }
-  String pjson = body.substring(ppos + 10);
-  int a = pjson.indexOf("{");
-  int b = pjson.lastIndexOf("}");
-  if (a < 0 || b < 0 || b <= a) { D.server->send(400, "text/plain", "Bad pattern json"); return; }
-  pjson = pjson.substring(a, b + 1);
+  RowFlags dirty;
+  dirty.resize(p.h);
+  if (!applyPatternPatch(body.c_str(), body.length(), p, &dirty)) {
+    D.server->send(400, "text/plain", "Invalid patch");
+    return;
+  }
 
-  Pattern p;
-  if (!jsonToPattern(pjson, p)) { D.server->send(400, "text/plain", "Invalid pattern"); return; }
-  if (!savePatternFile(file, p)) { D.server->send(500, "text/plain", "Write failed"); return; }
+  // Refreshes the LEDs (and reopens a file window) if the file is knitted
+  if (!storePattern(file, p, &dirty, isCurrent, false)) {
+    D.server->send(500, "text/plain", "Write failed");
+    return;
+  }
+  D.server->send(200, "application/json", "{\"ok\":true}");
+}
 
-  D.cfg->currentPatternFile = file;
-  *D.pattern = p;
+// Structural row edits (insert/delete/duplicate/repeat/move) and resize on
+// a stored pattern. Moves keep the size and rewrite only the rows in between;
+// the others change the height, so later records shift and the file is
+// written again in full.
+static void apiPatternRows() {
+  String body = D.server->arg("plain");
 
-  // reset confirmations when pattern changes
-  for (int i = 0; i < MAX_H; i++) D.rowConfirmed[i] = false;
+  auto getStr = [&](const char* key) -> String {
+    String k = String("\"") + key + "\":\"";
+    int i = body.indexOf(k);
+    if (i < 0) return String();
+    i += k.length();
+    int j = body.indexOf('"', i);
+    return j < 0 ? String() : body.substring(i, j);
+  };
 
-  // keep activeRow valid
-  D.cfg->activeRow = wrapRowIndex(D.cfg->activeRow, D.pattern->h);
-  saveConfig(*D.cfg);
+  auto getInt = [&](const char* key, int def) -> int {
+    String k = String("\"") + key + "\":";
+    int i = body.indexOf(k);
+    if (i < 0) return def;
+    return body.substring(i + k.length()).toInt();
+  };
 
-  D.server->send(200, "application/json", "{\"ok\":true}");
+  String file = getStr("file");
+  if (file.isEmpty()) { D.server->send(400, "text/plain", "Missing file"); return; }
+  file = normalizePatternPath(file);
+  String op = getStr("op");
+
+  // As in apiPatchPattern(): the edit goes to a copy that replaces the
+  // knitted pattern once the file is written.
+  const bool isCurrent = (file == D.cfg->currentPatternFile);
+  const bool loaded = isCurrent && !patternWantsWindow(file);
+  Pattern p;
+  if (loaded) {
+    if (!p.assign(*D.pattern)) { D.server->send(500, "text/plain", "Out of memory"); return; }
+  } else if (!loadPatternFile(file, p)) {
+    D.server->send(400, "text/plain", "Cannot load pattern");
+    return;
+  }
+
+  int at = getInt("at", 0);
+  int count = getInt("count", 1);
+  int to = getInt("to", at);
+  bool ok;
+  if (op == "insert") ok = p.insertRows(at, count);
+  else if (op == "delete") ok = p.removeRows(at, count);
+  else if (op == "duplicate") ok = p.duplicateRows(at, count);
+  else if (op == "repeat") ok = p.repeatRows(at, count, getInt("times", 2));
+  else if (op == "resize") ok = p.resize(getInt("w", p.w), getInt("h", p.h));
+  else if (op == "move") ok = p.moveRows(at, count, to);
+  else { D.server->send(400, "text/plain", "Unknown op"); return; }
+  if (!ok) { D.server->send(400, "text/plain", "Invalid row range"); return; }
+
+  // Knitted rows no longer line up, so confirmations are reset
+  const int w = p.w, h = p.h;
+  RowFlags dirty;
+  if (op == "move") {
+    dirty.resize(h);
+    for (int r = min(at, to); r < max(at, to) + count; r++) dirty.set(r);
+  }
+  if (!storePattern(file, p, op == "move" ? &dirty : nullptr, isCurrent, true)) {
+    D.server->send(500, "text/plain", "Write failed");
+    return;
+  }
+  D.server->send(200, "application/json",
+                 "{\"ok\":true,\"w\":" + String(w) + ",\"h\":" + String(h) + "}");
 }
 
 static void apiDelete() {
@@ -266,10 +874,61 @@ static void apiDelete() {
     return;
   }
 
-  if (LittleFS.exists(file)) LittleFS.remove(file);
+  // Deleting the knitted file moves knitting to default.json: the knitting
+  // task may be reading the deleted file through a window, and the next
+  // boot would not find it either.
+  const bool isCurrent = (file == D.cfg->currentPatternFile);
+  const String fallback = "/patterns/default.json";
+  Pattern p;
+  if (isCurrent && !loadPatternFile(fallback, p)) {
+    p = Pattern();
+    savePatternFile(fallback, p);
+  }
+  {
+    KnitPatternLock lock(isCurrent);
+    if (LittleFS.exists(file)) LittleFS.remove(file);
+    if (isCurrent) {
+      D.pattern->swap(p);
+      D.knit->patternChanged(fallback, true);
+    }
+  }
+  catalog.remove(file);
+  if (isCurrent) {
+    D.cfg->currentPatternFile = fallback;
+    saveConfig(*D.cfg);
+    D.server->send(200, "application/json", "{\"ok\":true,\"file\":\"" + fallback + "\"}");
+    return;
+  }
   D.server->send(200, "application/json", "{\"ok\":true}");
 }
 
+// Converts between JSON and binary: a.json -> a.kpb, a.kpb -> a.json.
+// The source file is kept.
+static void apiConvert() {
+  String body = D.server->arg("plain");
+
+  int fpos = body.indexOf("\"file\":\"");
+  if (fpos < 0) { D.server->send(400, "text/plain", "Missing file"); return; }
+  fpos += 8;
+  int fend = body.indexOf("\"", fpos);
+  if (fend < 0) { D.server->send(400, "text/plain", "Bad file"); return; }
+  String file = normalizePatternPath(body.substring(fpos, fend));
+
+  String base = file;
+  int dot = base.lastIndexOf('.');
+  if (dot > base.lastIndexOf('/')) base = base.substring(0, dot);
+  String dst = base + (isBinaryPath(file) ? ".json" : PATTERN_BIN_EXT);
+
+  Pattern p;
+  if (!loadPatternFile(file, p)) { D.server->send(400, "text/plain", "Convert failed"); return; }
+  // dst may be the knitted file; it is replaced like any other save of it
+  if (!storePattern(dst, p, nullptr, dst == D.cfg->currentPatternFile, false)) {
+    D.server->send(500, "text/plain", "Write failed");
+    return;
+  }
+  D.server->send(200, "application/json", "{\"ok\":true,\"file\":\"" + htmlEscape(dst) + "\"}");
+}
+
 // delta is STEP (+1/-1) in the user's configured direction, with wrap-around.
 static void apiRow() {
   String body = D.server->arg("plain");
@@ -281,46 +940,94 @@ static void apiRow() {
   else if (delta < 0) delta = -1;
   else delta = 0;
 
-  if (delta != 0) stepRowFromWeb(delta);
+  if (delta == 0) { sendRowState(D.knit->state()); return; }
 
-  String out = "{\"ok\":true,\"activeRow\":" + String(D.cfg->activeRow) + "}";
-  D.server->send(200, "application/json", out);
+  uint32_t ticket = D.engine->post(KNIT_STEP, delta);
+  if (!ticket) { D.server->send(503, "text/plain", "Busy"); return; }
+  D.server->sendChunked(200, "application/json", new RowStateResponse(ticket));
 }
 
+// Confirmation and auto-advance happen in the knitting engine.
 static void apiConfirm() {
-  if (D.pattern->h <= 0) {
-    D.server->send(200, "application/json", "{\"ok\":true,\"activeRow\":0}");
-    return;
-  }
-
-  D.rowConfirmed[D.cfg->activeRow] = true;
-  D.cfg->warnBlinkActive = false;
-
-  if (D.cfg->autoAdvance) {
-    stepRowFromWeb(+1);
-  } else {
-    saveConfig(*D.cfg);
-  }
-
-  String out = "{\"ok\":true,\"activeRow\":" + String(D.cfg->activeRow) + "}";
-  D.server->send(200, "application/json", out);
+  uint32_t ticket = D.engine->post(KNIT_CONFIRM);
+  if (!ticket) { D.server->send(503, "text/plain", "Busy"); return; }
+  D.server->sendChunked(200, "application/json", new RowStateResponse(ticket));
 }
 
-static void apiState() {
+static String stateJson(const KnitSnapshot& st) {
   String out = "{";
-  out += "\"activeRow\":" + String(D.cfg->activeRow) + ",";
-  out += "\"totalPulses\":" + String(D.cfg->totalPulses) + ",";
-  out += "\"w\":" + String(D.pattern->w) + ",";
-  out += "\"h\":" + String(D.pattern->h) + ",";
-  out += "\"warn\":" + String(D.cfg->warnBlinkActive ? "true" : "false") + ",";
+  out += "\"activeRow\":" + String(st.activeRow) + ",";
+  out += "\"patternRow\":" + String(st.patternRow) + ",";
+  out += "\"totalPulses\":" + String(st.totalPulses) + ",";
+  out += "\"w\":" + String(st.w) + ",";
+  out += "\"h\":" + String(st.h) + ",";
+  out += "\"warn\":" + String(st.warn ? "true" : "false") + ",";
   out += "\"autoAdvance\":" + String(D.cfg->autoAdvance ? "true" : "false") + ",";
   out += "\"blinkWarning\":" + String(D.cfg->blinkWarning ? "true" : "false") + ",";
   out += "\"rowFromBottom\":" + String(D.cfg->rowFromBottom ? "true" : "false") + ",";
   out += "\"brightness\":" + String(D.cfg->brightness) + ",";
   out += "\"colorActive\":" + String((unsigned long)D.cfg->colorActive) + ",";
   out += "\"colorConfirmed\":" + String((unsigned long)D.cfg->colorConfirmed);
+  out += ",\"maxCommandUs\":" + String((unsigned long)st.maxCommandUs);
+  if (D.carriage) {
+    out += ",\"lostEdges\":" + String((unsigned long)D.carriage->lostEdges());
+    out += ",\"maxLatencyUs\":" + String((unsigned long)D.carriage->maxLatencyUs());
+  }
   out += "}";
-  D.server->send(200, "application/json", out);
+  return out;
+}
+
+static void apiState() {
+  D.server->send(200, "application/json", stateJson(D.knit->state()));
+}
+
+// ------------------------------------------------------------
+// State push (Server-Sent Events)
+// ------------------------------------------------------------
+
+// State the streams were last brought up to (web task only)
+static KnitSnapshot pushed;
+
+static void addField(String& out, const char* name, const String& v) {
+  out += out.length() > 1 ? ",\"" : "\"";
+  out += name;
+  out += "\":";
+  out += v;
+}
+
+// Changed fields only, e.g. {"totalPulses":54}.
+static String stateDelta(const KnitSnapshot& a, const KnitSnapshot& b) {
+  String out = "{";
+  if (a.activeRow != b.activeRow) addField(out, "activeRow", String(b.activeRow));
+  if (a.patternRow != b.patternRow) addField(out, "patternRow", String(b.patternRow));
+  if (a.totalPulses != b.totalPulses) addField(out, "totalPulses", String(b.totalPulses));
+  if (a.w != b.w) addField(out, "w", String(b.w));
+  if (a.h != b.h) addField(out, "h", String(b.h));
+  if (a.warn != b.warn) addField(out, "warn", b.warn ? "true" : "false");
+  out += "}";
+  return out;
+}
+
+// Bring all streams up to the current state. Compares fields rather than
+// the engine version: view changes move patternRow/w without a row command.
+static void pushState() {
+  KnitSnapshot st = D.knit->state();
+  if (st.activeRow == pushed.activeRow && st.patternRow == pushed.patternRow &&
+      st.totalPulses == pushed.totalPulses && st.w == pushed.w && st.h == pushed.h &&
+      st.warn == pushed.warn) {
+    return;
+  }
+  events.broadcast("state", stateDelta(pushed, st));
+  pushed = st;
+}
+
+// The stream starts with the full state; afterwards webuiLoop() sends the
+// knitting fields that changed.
+static void apiEvents() {
+  pushState();  // open streams catch up first, so all share one baseline
+  int slot = events.open();
+  if (slot < 0) return;
+  events.sendTo(slot, "state", stateJson(pushed));
 }
 
 static void apiGetConfig() {
@@ -328,9 +1035,20 @@ static void apiGetConfig() {
   out += "\"colorActive\":" + String((unsigned long)D.cfg->colorActive) + ",";
   out += "\"colorConfirmed\":" + String((unsigned long)D.cfg->colorConfirmed) + ",";
   out += "\"brightness\":" + String(D.cfg->brightness) + ",";
+  out += "\"colorCorrection\":" + String((unsigned long)D.cfg->colorCorrection) + ",";
+  out += "\"ledSegments\":\"" + D.cfg->ledSegments + "\",";
+  out += "\"needlePitch\":" + String(D.cfg->needlePitch) + ",";
+  out += "\"ledPitch\":" + String(D.cfg->ledPitch) + ",";
+  out += "\"viewCenter\":" + String(D.cfg->viewCenter) + ",";
   out += "\"autoAdvance\":" + String(D.cfg->autoAdvance ? "true" : "false") + ",";
   out += "\"blinkWarning\":" + String(D.cfg->blinkWarning ? "true" : "false") + ",";
-  out += "\"rowFromBottom\":" + String(D.cfg->rowFromBottom ? "true" : "false");
+  out += "\"rowFromBottom\":" + String(D.cfg->rowFromBottom ? "true" : "false") + ",";
+  out += "\"mirrorH\":" + String(D.cfg->mirrorH ? "true" : "false") + ",";
+  out += "\"mirrorV\":" + String(D.cfg->mirrorV ? "true" : "false") + ",";
+  out += "\"invert\":" + String(D.cfg->invert ? "true" : "false") + ",";
+  out += "\"tileX\":" + String(D.cfg->tileX) + ",";
+  out += "\"tileY\":" + String(D.cfg->tileY) + ",";
+  out += "\"needleOffset\":" + String(D.cfg->needleOffset);
   out += "}";
   D.server->send(200, "application/json", out);
 }
@@ -361,12 +1079,54 @@ static void apiPostConfig() {
     return true;
   };
 
-  uint32_t ca, cc, br;
-  bool aa, bw, rb;
+  auto getStr = [&](const char* key, String& v) -> bool {
+    String k = String("\"") + key + "\":\"";
+    int i = body.indexOf(k);
+    if (i < 0) return false;
+    i += k.length();
+    int j = body.indexOf('"', i);
+    if (j < 0) return false;
+    v = body.substring(i, j);
+    return true;
+  };
+
+  // Validate first so a bad layout leaves every setting untouched
+  String seg;
+  bool hasSeg = getStr("ledSegments", seg);
+  if (hasSeg) {
+    LedSegment parsed[LED_MAX_SEGMENTS];
+    int n;
+    seg.trim();
+    if (!parseLedSegments(seg, parsed, n)) {
+      D.server->send(400, "text/plain", "Invalid ledSegments");
+      return;
+    }
+  }
+
+  // Tiling down multiplies the knitted height and the per-row state with it
+  uint32_t ty;
+  bool hasTy = getNum("tileY", ty);
+  if (hasTy) {
+    ty = constrain((int)ty, 1, 64);
+    if (!knitHeightFits(D.knit->state().baseH, ty)) {
+      D.server->send(400, "text/plain", "tileY too large for this pattern");
+      return;
+    }
+  }
+
+  uint32_t ca, cc, br, cor, tx, off, np, lp, vc;
+  bool aa, bw, rb, mh, mv, inv;
 
   if (getNum("colorActive", ca))    D.cfg->colorActive = ca;
   if (getNum("colorConfirmed", cc)) D.cfg->colorConfirmed = cc;
   if (getNum("brightness", br))     D.cfg->brightness = (uint8_t)constrain((int)br, 0, 255);
+  if (getNum("colorCorrection", cor)) D.cfg->colorCorrection = cor & 0xFFFFFF;
+
+  // LED layout: segments apply after a restart, pitch and viewport right away
+  if (hasSeg)                       D.cfg->ledSegments = seg;
+  if (getNum("needlePitch", np))    D.cfg->needlePitch = (uint16_t)constrain((int32_t)np, 1, 10000);
+  if (getNum("ledPitch", lp))       D.cfg->ledPitch = (uint16_t)constrain((int32_t)lp, 1, 10000);
+  if (getNum("viewCenter", vc))     D.cfg->viewCenter = (int16_t)constrain((int32_t)vc, 0, 10000);
 
   if (getBool("autoAdvance", aa))   D.cfg->autoAdvance = aa;
   if (getBool("blinkWarning", bw))  D.cfg->blinkWarning = bw;
@@ -374,6 +1134,15 @@ static void apiPostConfig() {
   // New: row counting direction
   if (getBool("rowFromBottom", rb)) D.cfg->rowFromBottom = rb;
 
+  // Pattern view (applied by the knitting loop on its next pass)
+  if (getBool("mirrorH", mh))       D.cfg->mirrorH = mh;
+  if (getBool("mirrorV", mv))       D.cfg->mirrorV = mv;
+  if (getBool("invert", inv))       D.cfg->invert = inv;
+  if (getNum("tileX", tx))          D.cfg->tileX = (uint8_t)constrain((int)tx, 1, 64);
+  if (hasTy)                        D.cfg->tileY = (uint8_t)ty;
+  if (getNum("needleOffset", off))  D.cfg->needleOffset = (int16_t)constrain((int32_t)off, -MAX_W, MAX_W);
+
+  D.knit->publishSettings(*D.cfg);
   saveConfig(*D.cfg);
   D.server->send(200, "application/json", "{\"ok\":true}");
 }
@@ -387,472 +1156,28 @@ static void handleDownload() {
   int slash = base.lastIndexOf('/');
   if (slash >= 0) base = base.substring(slash + 1);
 
+  // The server reads the file as the client takes it and closes it when done
   File f = LittleFS.open(file, "r");
   D.server->sendHeader("Content-Disposition", "attachment; filename=\"" + base + "\"");
-  D.server->streamFile(f, "application/json");
-  f.close();
+  D.server->streamFile(f, isBinaryPath(file) ? "application/octet-stream" : "application/json");
 }
 
 // ------------------------------------------------------------
-// UI HTML
+// UI files (web/, built into WebAssetData.h)
 // ------------------------------------------------------------
 
-static const char INDEX_HTML[] PROGMEM = R"HTML(
-<!doctype html><html><head>
-<meta charset="utf-8"/><meta name="viewport" content="width=device-width,initial-scale=1"/>
-<title>KnittLED</title>
-<style>
-body{font-family:system-ui,Arial;margin:16px;max-width:980px}
-h1{font-size:22px;margin:0 0 8px}
-.small{color:#555;font-size:13px}
-.row{display:flex;gap:12px;flex-wrap:wrap}
-.card{border:1px solid #ddd;border-radius:14px;padding:12px;flex:1;min-width:300px}
-button,input,select{font:inherit}
-button{padding:10px 12px;border:0;border-radius:12px;background:#111;color:#fff;font-weight:650}
-button.secondary{background:#666}
-canvas{touch-action:manipulation;border-radius:12px;border:1px solid #ccc}
-.controls{display:flex;gap:8px;flex-wrap:wrap;align-items:center}
-.pill{display:inline-block;padding:6px 10px;border-radius:999px;background:#f2f2f2}
-label{display:block;margin-top:10px}
-input,select{width:100%;padding:10px;border-radius:12px;border:1px solid #ccc}
-.warn{background:#fff0f0;border-color:#f2b6b6}
-</style>
-</head><body>
-<h1>KnittLED</h1>
-<div class="small" id="status">Loading...</div>
-
-<div class="row" style="margin-top:12px">
-  <div class="card" id="gridCard">
-    <div class="controls">
-      <span class="pill" id="modePill">EDIT</span>
-      <button class="secondary" id="btnEdit">Edit</button>
-      <button class="secondary" id="btnKnit">Knit</button>
-      <button class="secondary" id="btnReload">Reload</button>
-      <button class="secondary" id="btnConfig">Config</button>
-    </div>
-
-    <div style="margin-top:10px;overflow:auto">
-      <canvas id="grid" width="600" height="600"></canvas>
-    </div>
-
-    <div class="small" style="margin-top:10px">
-      Needle #1 is the <b>rightmost</b> (LED0 should be rightmost too).
-    </div>
-  </div>
-
-  <div class="card" id="panelCard">
-    <div class="controls">
-      <span class="pill" id="rowPill">Row: --</span>
-      <span class="pill" id="totPill">Tot: --</span>
-      <span class="pill" id="warnPill" style="display:none">WARNING</span>
-    </div>
-
-    <label>Stored patterns</label>
-    <select id="fileList"></select>
-    <div class="controls" style="margin-top:10px">
-      <button id="btnLoad">Load</button>
-      <button id="btnSave">Save</button>
-      <button id="btnDownload">Download</button>
-    </div>
-
-    <label>New file name</label>
-    <input id="newName" placeholder="diamond.json"/>
-    <div class="controls" style="margin-top:10px">
-      <button class="secondary" id="btnNew">Create</button>
-      <button class="secondary" id="btnUpload">Upload</button>
-      <input type="file" id="uploadFile" accept=".json"/>
-      <button class="secondary" id="btnDelete">Delete</button>
-    </div>
-
-    <hr style="margin:14px 0;border:0;border-top:1px solid #eee"/>
-
-    <div><b>Size</b> <span class="small">(max 12×24)</span></div>
-    <div class="controls" style="margin-top:10px">
-      <div style="flex:1">
-        <label class="small">Width</label>
-        <input id="w" type="number" min="1" max="12" value="12"/>
-      </div>
-      <div style="flex:1">
-        <label class="small">Height</label>
-        <input id="h" type="number" min="1" max="24" value="24"/>
-      </div>
-      <button class="secondary" id="btnResize">Resize</button>
-    </div>
-
-    <hr style="margin:14px 0;border:0;border-top:1px solid #eee"/>
-
-    <div><b>Knitting controls</b></div>
-    <div class="controls" style="margin-top:10px">
-      <button class="secondary" id="btnPrevRow">Row -</button>
-      <button class="secondary" id="btnNextRow">Row +</button>
-      <button id="btnConfirm">Confirm</button>
-    </div>
-
-    <div class="small" style="margin-top:10px">
-      In knit mode, active row is highlighted. Page auto-updates from hardware buttons.
-    </div>
-  </div>
-</div>
-
-<!-- Config modal -->
-<div id="cfg" style="display:none;position:fixed;inset:0;background:rgba(0,0,0,.35);padding:16px">
-  <div class="card" style="max-width:520px;margin:40px auto;background:#fff">
-    <div class="controls" style="justify-content:space-between">
-      <b>Config</b>
-      <button class="secondary" id="cfgClose">Close</button>
-    </div>
-
-    <label>Active color</label>
-    <input id="cfgActive" type="color" value="#00ff00"/>
-
-    <label>Confirmed color</label>
-    <input id="cfgConfirmed" type="color" value="#0000ff"/>
-
-    <label>Brightness (0..255)</label>
-    <input id="cfgBright" type="range" min="0" max="255" value="64"/>
-
-    <div class="controls" style="margin-top:10px">
-      <label style="display:flex;gap:10px;align-items:center;margin:0">
-        <input id="cfgAA" type="checkbox"/> Auto-advance on confirm
-      </label>
-    </div>
-
-    <div class="controls" style="margin-top:10px">
-      <label style="display:flex;gap:10px;align-items:center;margin:0">
-        <input id="cfgBW" type="checkbox"/> Blink warning on carriage without confirm
-      </label>
-    </div>
-
-    <div class="controls" style="margin-top:10px">
-      <label style="display:flex;gap:10px;align-items:center;margin:0">
-        <input id="cfgRB" type="checkbox"/> Row 1 is bottom (count from bottom)
-      </label>
-    </div>
-
-    <div class="controls" style="margin-top:14px">
-      <button id="cfgSave">Save config</button>
-    </div>
-
-    <div class="small" style="margin-top:10px">
-      Needle #1 is rightmost. Row direction affects how Row +/- steps.
-    </div>
-  </div>
-</div>
-
-<script>
-let mode="edit";
-let pat={name:"",w:12,h:24,pixels:[]};
-let activeRow=0;
-let totalPulses=0;
-let warn=false;
-
-const c=document.getElementById("grid");
-const ctx=c.getContext("2d");
-
-function setStatus(t){document.getElementById("status").textContent=t;}
-function setMode(m){mode=m;document.getElementById("modePill").textContent=(m==="edit"?"EDIT":"KNIT"); draw();}
-document.getElementById("btnEdit").onclick=()=>setMode("edit");
-document.getElementById("btnKnit").onclick=()=>setMode("knit");
-
-function ensurePixels(){
-  if(!pat.pixels||pat.pixels.length!==pat.h){
-    pat.pixels=[];
-    for(let r=0;r<pat.h;r++) pat.pixels.push("0".repeat(pat.w));
-  } else {
-    pat.pixels=pat.pixels.map(row=>{
-      row=row.replace(/[^01]/g,"");
-      if(row.length<pat.w) row=row+"0".repeat(pat.w-row.length);
-      if(row.length>pat.w) row=row.slice(0,pat.w);
-      return row;
-    });
-  }
-}
-
-// Draw with row numbers on the RIGHT and needle numbers UNDER
-function draw(){
-  ensurePixels();
-
-  const size = 24;
-  const marginBottom = 22;
-  const marginRight  = 26;
-
-  const gridW = pat.w * size;
-  const gridH = pat.h * size;
-
-  c.width  = gridW + marginRight;
-  c.height = gridH + marginBottom;
-
-  ctx.clearRect(0,0,c.width,c.height);
-
-  // cells
-  for(let r=0;r<pat.h;r++){
-    for(let col=0;col<pat.w;col++){
-      const v = pat.pixels[r][col] === "1";
-      const x = col*size;
-      const y = r*size;
-
-      if(mode==="knit" && r===activeRow){
-        ctx.fillStyle="#fff7d6";
-        ctx.fillRect(x,y,size,size);
-        ctx.fillStyle=v?"#111":"#fff";
-        ctx.fillRect(x+4,y+4,size-8,size-8);
-      } else {
-        ctx.fillStyle = v ? "#111" : "#fff";
-        ctx.fillRect(x,y,size,size);
-      }
-
-      ctx.strokeStyle="#ccc";
-      ctx.strokeRect(x,y,size,size);
-    }
-  }
-
-  // numbers style
-  ctx.fillStyle = "#444";
-  ctx.font = "12px system-ui, Arial";
-  ctx.textBaseline = "middle";
-
-  // needle numbers under: rightmost = 1 => label = (w - col)
-  ctx.textAlign = "center";
-  for(let col=0; col<pat.w; col++){
-    const needle = pat.w - col;
-    const x = col*size + size/2;
-    const y = gridH + marginBottom/2;
-    ctx.fillText(String(needle), x, y);
-  }
-
-  // row numbers on right
-  ctx.textAlign = "left";
-  for(let r=0; r<pat.h; r++){
-    const rowNum = r + 1;
-    const x = gridW + 6;
-    const y = r*size + size/2;
-    ctx.fillText(String(rowNum).padStart(2,"0"), x, y);
-  }
-}
-
-function toggleCell(clientX,clientY){
-  if(mode!=="edit") return;
-  const rect=c.getBoundingClientRect();
-  const x=clientX-rect.left, y=clientY-rect.top;
-
-  // Only inside the actual grid area
-  const size = 24;
-  const col=Math.floor(x/size), row=Math.floor(y/size);
-  if(row<0||row>=pat.h||col<0||col>=pat.w) return;
-
-  let s=pat.pixels[row].split("");
-  s[col]=s[col]==="1"?"0":"1";
-  pat.pixels[row]=s.join("");
-  draw();
-}
-c.addEventListener("click",e=>toggleCell(e.clientX,e.clientY));
-c.addEventListener("touchstart",e=>{const t=e.touches[0];toggleCell(t.clientX,t.clientY);},{passive:true});
-
-async function apiGET(u){
-  const r=await fetch(u);
-  if(!r.ok) throw new Error(await r.text());
-  return r.json();
-}
-async function apiPOST(u,o){
-  const r=await fetch(u,{method:"POST",headers:{"Content-Type":"application/json"},body:JSON.stringify(o)});
-  if(!r.ok) throw new Error(await r.text());
-  return r.json();
-}
-
-async function refreshFiles(){
-  const list=await apiGET("/api/files");
-  const sel=document.getElementById("fileList");
-  sel.innerHTML="";
-  list.forEach(f=>{
-    const o=document.createElement("option");
-    o.value=f;                          // keep full path
-    o.textContent=f.split("/").pop();   // display base name
-    sel.appendChild(o);
-  });
-}
-
-async function loadSelected(){
-  const file=document.getElementById("fileList").value;
-  const data=await apiGET("/api/pattern?file="+encodeURIComponent(file));
-  pat=data.pattern;
-  activeRow=data.activeRow||0;
-  document.getElementById("w").value=pat.w;
-  document.getElementById("h").value=pat.h;
-  draw();
-  setStatus("Loaded "+file.split("/").pop());
-}
-
-async function saveSelected(){
-  const file=document.getElementById("fileList").value;
-  await apiPOST("/api/pattern",{file,pattern:pat});
-  setStatus("Saved "+file.split("/").pop());
-  await refreshFiles();
-  document.getElementById("fileList").value=file;
-}
-
-document.getElementById("btnLoad").onclick=loadSelected;
-document.getElementById("btnSave").onclick=saveSelected;
-
-document.getElementById("btnReload").onclick=async()=>{
-  await refreshFiles();
-  await loadSelected();
-};
-
-document.getElementById("btnNew").onclick=async()=>{
-  const name=document.getElementById("newName").value.trim();
-  if(!name) return alert("Enter a file name");
-  const file="/patterns/"+name.replace(/[^a-zA-Z0-9._-]/g,"_");
-  await apiPOST("/api/pattern",{file,pattern:pat});
-  await refreshFiles();
-  document.getElementById("fileList").value=file;
-  setStatus("Created "+file.split("/").pop());
-};
-
-document.getElementById("btnDelete").onclick=async()=>{
-  const file=document.getElementById("fileList").value;
-  if(!confirm("Delete "+file.split("/").pop()+" ?")) return;
-  await apiPOST("/api/delete",{file});
-  await refreshFiles();
-  setStatus("Deleted");
-};
-
-document.getElementById("btnResize").onclick=()=>{
-  let w=parseInt(document.getElementById("w").value,10);
-  let h=parseInt(document.getElementById("h").value,10);
-  w=Math.max(1,Math.min(12,w));
-  h=Math.max(1,Math.min(24,h));
-
-  const newPix=[];
-  for(let r=0;r<h;r++){
-    let row=(pat.pixels[r]||"0".repeat(pat.w));
-    row=row.slice(0,w);
-    if(row.length<w) row=row+"0".repeat(w-row.length);
-    newPix.push(row);
-  }
-  pat.w=w; pat.h=h; pat.pixels=newPix;
-  draw();
-};
-
-document.getElementById("btnPrevRow").onclick=async()=>{
-  const d=await apiPOST("/api/row",{delta:-1});
-  activeRow=d.activeRow;
-  if(mode==="knit") draw();
-};
-document.getElementById("btnNextRow").onclick=async()=>{
-  const d=await apiPOST("/api/row",{delta:+1});
-  activeRow=d.activeRow;
-  if(mode==="knit") draw();
-};
-document.getElementById("btnConfirm").onclick=async()=>{
-  const d=await apiPOST("/api/confirm",{});
-  activeRow=d.activeRow;
-  if(mode==="knit") draw();
-};
-
-document.getElementById("btnDownload").onclick=()=>{
-  const file=document.getElementById("fileList").value;
-  window.location="/download?file="+encodeURIComponent(file);
-};
-
-document.getElementById("btnUpload").onclick=async()=>{
-  const inp=document.getElementById("uploadFile");
-  if(!inp.files.length) return alert("Choose a file first");
-  const f=inp.files[0];
-  const fd=new FormData(); fd.append("upload",f,f.name);
-  const r=await fetch("/upload",{method:"POST",body:fd});
-  if(!r.ok) return alert("Upload failed: "+await r.text());
-  setStatus(await r.text());
-  await refreshFiles();
-};
-
-// ---- Config modal ----
-function intToHexColor(v){
-  const r=(v>>16)&255, g=(v>>8)&255, b=v&255;
-  return "#"+[r,g,b].map(x=>x.toString(16).padStart(2,"0")).join("");
-}
-function hexToInt(s){ return parseInt(s.slice(1),16); }
-
-document.getElementById("btnConfig").onclick=async()=>{
-  const cfg=await apiGET("/api/config");
-  document.getElementById("cfgActive").value=intToHexColor(cfg.colorActive);
-  document.getElementById("cfgConfirmed").value=intToHexColor(cfg.colorConfirmed);
-  document.getElementById("cfgBright").value=cfg.brightness;
-  document.getElementById("cfgAA").checked=!!cfg.autoAdvance;
-  document.getElementById("cfgBW").checked=!!cfg.blinkWarning;
-  document.getElementById("cfgRB").checked=!!cfg.rowFromBottom;
-  document.getElementById("cfg").style.display="block";
-};
-document.getElementById("cfgClose").onclick=()=>{document.getElementById("cfg").style.display="none";};
-document.getElementById("cfgSave").onclick=async()=>{
-  const payload={
-    colorActive: hexToInt(document.getElementById("cfgActive").value),
-    colorConfirmed: hexToInt(document.getElementById("cfgConfirmed").value),
-    brightness: parseInt(document.getElementById("cfgBright").value,10),
-    autoAdvance: document.getElementById("cfgAA").checked,
-    blinkWarning: document.getElementById("cfgBW").checked,
-    rowFromBottom: document.getElementById("cfgRB").checked
-  };
-  await apiPOST("/api/config", payload);
-  setStatus("Config saved");
-  document.getElementById("cfg").style.display="none";
-};
-
-// ---- State polling ----
-function renderPills(){
-  document.getElementById("rowPill").textContent =
-    "Row: " + String(activeRow+1).padStart(2,"0") + "/" + String(pat.h).padStart(2,"0");
-  document.getElementById("totPill").textContent = "Tot: " + totalPulses;
-
-  const wp=document.getElementById("warnPill");
-  const gc=document.getElementById("gridCard");
-  if(warn){
-    wp.style.display="inline-block";
-    gc.classList.add("warn");
-  } else {
-    wp.style.display="none";
-    gc.classList.remove("warn");
-  }
-}
-
-async function poll(){
-  try{
-    const s=await apiGET("/api/state");
-    activeRow = s.activeRow;
-    totalPulses = s.totalPulses;
-    warn = !!s.warn;
-    renderPills();
-    if(mode==="knit") draw();
-  }catch(e){
-    // keep quiet; polling will retry
-  }
-  setTimeout(poll, 350);
-}
-
-async function init(){
-  await refreshFiles();
-  // If no files, create default entry view by loading default
-  if (!document.getElementById("fileList").value) {
-    // Force load default pattern endpoint (server will create it if missing)
-    const data = await apiGET("/api/pattern");
-    pat = data.pattern;
-    activeRow = data.activeRow || 0;
-  } else {
-    await loadSelected();
+// gzip straight from flash. The page is revalidated on every load
+// (If-None-Match -> 304); app.<hash>.js/css never change under their name.
+static void sendAsset(const WebAsset& a) {
+  D.server->sendHeader("ETag", a.etag);
+  D.server->sendHeader("Cache-Control",
+                       a.immutable ? "public, max-age=" + String(WEB_ASSET_MAX_AGE) + ", immutable" : String("no-cache"));
+  if (D.server->header("If-None-Match").indexOf(a.etag) >= 0) {
+    D.server->send(304);
+    return;
   }
-
-  setMode("edit");
-  renderPills();
-  poll();
-  setStatus("Ready.");
-}
-
-init().catch(e=>setStatus("Error: "+e.message));
-</script>
-</body></html>
-)HTML";
-
-static void sendIndex() {
-  D.server->send(200, "text/html; charset=utf-8", FPSTR(INDEX_HTML));
+  D.server->sendHeader("Content-Encoding", "gzip");
+  D.server->send_P(200, a.type, (const char*)a.data, a.len);
 }
 
 // ------------------------------------------------------------
@@ -861,20 +1186,33 @@ static void sendIndex() {
 
 void webuiBegin(WebUiDeps deps) {
   D = deps;
+  events.begin(D.server);
 
-  // Main UI
-  D.server->on("/", HTTP_GET, sendIndex);
+  // Replay the catalog now; the first boot with it scans every file once.
+  catalog.count();
+
+  // Main UI: the page and its hashed script/style
+  for (int i = 0; i < WEB_ASSET_COUNT; i++) {
+    const WebAsset* a = &WEB_ASSETS[i];
+    D.server->on(a->path, HTTP_GET, [a]() { sendAsset(*a); });
+  }
 
   // APIs
   D.server->on("/api/files", HTTP_GET, apiFiles);
   D.server->on("/api/pattern", HTTP_GET, apiGetPattern);
-  D.server->on("/api/pattern", HTTP_POST, apiPostPattern);
+  D.server->on("/api/pattern", HTTP_POST, apiPostPattern, handlePatternJsonBody);
+  D.server->on("/api/pattern.bin", HTTP_GET, apiGetPatternBin);
+  D.server->on("/api/pattern.bin", HTTP_POST, apiPostPatternBin, handlePatternBinBody);
+  D.server->on("/api/pattern/patch", HTTP_POST, apiPatchPattern);
+  D.server->on("/api/pattern/rows", HTTP_POST, apiPatternRows);
   D.server->on("/api/delete", HTTP_POST, apiDelete);
+  D.server->on("/api/convert", HTTP_POST, apiConvert);
 
   D.server->on("/api/row", HTTP_POST, apiRow);
   D.server->on("/api/confirm", HTTP_POST, apiConfirm);
 
   D.server->on("/api/state", HTTP_GET, apiState);
+  D.server->on("/api/events", HTTP_GET, apiEvents);
 
   D.server->on("/api/config", HTTP_GET, apiGetConfig);
   D.server->on("/api/config", HTTP_POST, apiPostConfig);
@@ -888,3 +1226,8 @@ void webuiBegin(WebUiDeps deps) {
     D.server->send(302);
   });
 }
+
+void webuiLoop() {
+  events.loop();
+  if (events.count()) pushState();
+}
@@ -8,43 +8,57 @@
  * - File management (LittleFS, no SD card)
  * - Device configuration (colors, brightness, behavior, row direction)
  *
- * Pattern files are stored under @c /patterns in LittleFS as JSON.
+ * Pattern files are stored under @c /patterns in LittleFS as JSON or in the
+ * compact binary format (@c *.kpb, see PatternBin.h).
  */
 
 #pragma once
 #include <Arduino.h>
-#include <WebServer.h>
 #include <LittleFS.h>
 
 #include "Pattern.h"
+#include "RowFlags.h"
 #include "AppConfig.h"
+#include "CarriageSensor.h"
+#include "KnitEngine.h"
+#include "KnitLink.h"
+#include "HttpServer.h"
 
 /**
  * @brief Dependency bundle injected into the Web UI module.
  *
  * The web server instance is owned by the application (main.cpp).
  * WebUi registers handlers and uses these pointers for reading/writing
- * application state.
+ * application state. Handlers run on the web task: knitting state is read
+ * through @ref knit and changed only by posting commands to @ref engine.
  */
 struct WebUiDeps {
-  WebServer* server;     /**< @brief Web server instance (port 80). */
-  Pattern* pattern;      /**< @brief Current in-memory pattern. */
-  AppConfig* cfg;        /**< @brief Current configuration/state. */
-  bool* rowConfirmed;    /**< @brief Confirmation flags array [MAX_H]. */
+  HttpServer* server;    /**< @brief Web server instance (port 80). */
+  Pattern* pattern;      /**< @brief Current in-memory pattern; also knitted, so changed under the pattern lock. */
+  AppConfig* cfg;        /**< @brief Settings and current file (web task copy). */
+  KnitEngine* engine;    /**< @brief Row commands (post() only). */
+  KnitLink* knit;        /**< @brief Knitting state snapshot, settings, pattern lock. */
+  const CarriageSensor* carriage = nullptr;  /**< @brief Carriage sensor (diagnostics only). */
 };
 
 /**
  * @brief Register all routes for the web UI on the provided server.
  *
  * Routes:
- * - GET  @c /                : HTML UI
- * - GET  @c /api/files        : JSON list of pattern file paths
+ * - GET  @c /                : HTML UI (gzip, ETag; also @c /app.<hash>.js and @c .css, see WebAssets.h)
+ * - GET  @c /api/files        : JSON list of pattern file paths; paged with metadata (see PatternCatalog.h)
  * - GET  @c /api/pattern      : Load pattern (query param @c file)
  * - POST @c /api/pattern      : Save pattern (JSON body)
+ * - GET  @c /api/pattern.bin  : Load pattern, bit-packed rows (see PatternBin.h)
+ * - POST @c /api/pattern.bin  : Save pattern (same binary body)
+ * - POST @c /api/pattern/patch : Apply changed cells/rows to a stored pattern (JSON body)
+ * - POST @c /api/pattern/rows : Insert/delete/duplicate/repeat/move rows, resize (JSON body)
  * - POST @c /api/delete       : Delete file (JSON body)
+ * - POST @c /api/convert      : Convert a file between JSON and binary (JSON body)
  * - POST @c /api/row          : Step row (+1/-1) (JSON body)
  * - POST @c /api/confirm      : Confirm current row and optionally auto-advance
  * - GET  @c /api/state        : Current state for polling
+ * - GET  @c /api/events       : State pushes (Server-Sent Events, changed fields only)
  * - GET  @c /api/config       : Read config
  * - POST @c /api/config       : Update config
  * - GET  @c /download         : Download a pattern file
@@ -52,11 +66,19 @@ struct WebUiDeps {
  */
 void webuiBegin(WebUiDeps deps);
 
-/** @brief Return JSON array of stored pattern files (paths). */
+/**
+ * @brief Push knitting state changes to open @c /api/events streams.
+ *
+ * Call from the web task after HttpServer::handleClient(). Does nothing
+ * while no stream is open.
+ */
+void webuiLoop();
+
+/** @brief Return JSON array of stored pattern files (paths), from the catalog. */
 String listPatternFilesJson();
 
 /**
- * @brief Load a pattern from LittleFS.
+ * @brief Load a pattern from LittleFS (JSON or binary, detected from content).
  * @param path File path (either full path or just filename; will be normalized).
  * @param p Destination pattern.
  * @return true on success.
@@ -65,8 +87,29 @@ bool loadPatternFile(const String& path, Pattern& p);
 
 /**
  * @brief Save a pattern to LittleFS.
+ *
+ * Paths ending in @c .kpb are written in the binary format, others as JSON.
+ * The pattern is written to a temporary file that then replaces @p path, so
+ * a failed save keeps the old file.
+ *
  * @param path File path (either full path or just filename; will be normalized).
  * @param p Pattern to save.
  * @return true on success.
  */
 bool savePatternFile(const String& path, const Pattern& p);
+
+/**
+ * @brief Write back the rows of @p p flagged in @p rows.
+ *
+ * Packed binary files and JSON files in the layout written by savePatternFile()
+ * are updated in place; any other file is saved in full.
+ *
+ * @return true on success.
+ */
+bool patchPatternFile(const String& path, const Pattern& p, const RowFlags& rows);
+
+/**
+ * @brief Load @p src and save it as @p dst (format of each follows its path).
+ * @return true on success.
+ */
+bool convertPatternFile(const String& src, const String& dst);
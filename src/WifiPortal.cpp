@@ -2,7 +2,7 @@
  * @file WifiPortal.cpp
  * @brief Implementation of Wi-Fi provisioning portal.
  *
- * Uses WebServer + DNSServer to behave as a captive portal.
+ * Uses HttpServer + DNSServer to behave as a captive portal.
  * Network scanning is performed on demand when the portal root page is requested.
  */
 
@@ -48,7 +48,7 @@ static String esc(const String& s) {
 }
 
 void wifiStartPortal(
-  WebServer& server,
+  HttpServer& server,
   DNSServer& dns,
   const char* apSsid,
   WifiCreds& creds,
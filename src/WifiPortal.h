@@ -8,7 +8,7 @@
 
 #pragma once
 #include <Arduino.h>
-#include <WebServer.h>
+#include "HttpServer.h"
 #include <DNSServer.h>
 #include <functional>
 
@@ -23,7 +23,7 @@ struct WifiCreds {
 bool wifiConnectSTA(const WifiCreds& c, uint32_t timeoutMs);
 
 void wifiStartPortal(
-  WebServer& server,
+  HttpServer& server,
   DNSServer& dns,
   const char* apSsid,
   WifiCreds& creds,
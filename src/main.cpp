@@ -5,23 +5,37 @@
  * Initializes hardware (OLED, NeoPixels, buttons), Wi-Fi, file system, and web UI.
  * Implements knitting logic: stepping rows, confirmation, carriage sensor handling, and warning blink.
  * Row stepping wraps around and respects row counting direction (rowFromBottom).
+ *
+ * After setup two tasks take over: the knitting task (inputs, row state, LEDs,
+ * OLED) on one core at high priority, and the web task (HttpServer, settings
+ * and journal writes) on the other. They exchange state through KnitLink only.
+ * OledView draws and talks I2C from a third, lower-priority task.
  */
 
 #include <Arduino.h>
 #include <WiFi.h>
-#include <WebServer.h>
 #include <DNSServer.h>
 #include <Preferences.h>
 #include <LittleFS.h>
 #include <Wire.h>
 #include <U8g2lib.h>
+#include <esp_system.h>
 
 // Project modules
 #include "AppConfig.h"
 #include "Pattern.h"
+#include "PatternWindow.h"
+#include "PatternViews.h"
+#include "RowFlags.h"
+#include "StateJournal.h"
 #include "LedView.h"
+#include "RmtLedOutput.h"
 #include "OledView.h"
 #include "Buttons.h"
+#include "CarriageSensor.h"
+#include "KnitEngine.h"
+#include "KnitLink.h"
+#include "HttpServer.h"
 #include "WebUi.h"
 #include "WifiPortal.h"
 
@@ -38,16 +52,36 @@ static constexpr int PIN_BTN_DOWN        = 33; // touch
 static constexpr int PIN_BTN_CONFIRM     = 27; // touch
 static constexpr int PIN_SENSOR_CARRIAGE = 26;
 
-static constexpr int PIN_NEOPIXEL = 25;
-static constexpr int LED_COUNT    = 12;
-
+// LED strip pins and lengths are configured at runtime (AppConfig::ledSegments)
 static constexpr neoPixelType LED_TYPE = NEO_GRB + NEO_KHZ800;
 
+// ============================================================
+// -------------------------- TASKS ----------------------------
+// ============================================================
+
+// Wi-Fi and lwIP run on core 0, so the web task joins them there and the
+// knitting task has core 1 to itself.
+static constexpr BaseType_t KNIT_CORE = 1;
+static constexpr BaseType_t WEB_CORE  = 0;
+static constexpr UBaseType_t KNIT_TASK_PRIO = 5;
+static constexpr UBaseType_t WEB_TASK_PRIO  = 2;
+static constexpr uint32_t KNIT_TASK_STACK = 8192;
+static constexpr uint32_t WEB_TASK_STACK  = 8192;
+
+// OLED drawing and I2C run below the knitting task on its core and fill
+// the time it leaves idle.
+static constexpr BaseType_t OLED_CORE = KNIT_CORE;
+static constexpr UBaseType_t OLED_TASK_PRIO = 3;
+
+// The knitting task also wakes on every carriage edge and web command;
+// this only paces button polling and blinking.
+static constexpr uint32_t KNIT_TICK_MS = 5;
+
 // ============================================================
 // ------------------------ GLOBALS -----------------------------
 // ============================================================
 
-WebServer server(80);
+HttpServer server(80);
 DNSServer dns;
 Preferences prefs;
 
@@ -57,30 +91,39 @@ static bool portalActive = false;
 U8G2_SSD1306_128X32_UNIVISION_F_HW_I2C u8g2(U8G2_R0, U8X8_PIN_NONE);
 OledView oled(u8g2);
 
-// LEDs
-LedView leds(LED_COUNT, PIN_NEOPIXEL, LED_TYPE);
+// LEDs: one output per data pin of the layout, created in startLeds()
+LedView leds(LED_TYPE);
+LedOutput* ledOutputs[LED_MAX_OUTPUTS] = {};
 
 // Buttons
 EdgeButton btnUp(60);
 EdgeButton btnDown(60);
 EdgeButton btnConfirm(60);
-EdgeButton btnCarriage(40);
+CarriageSensor carriage(40);
 
-// App state
+// App state (knitting task once running)
 AppConfig cfg;
-Pattern pattern;
-bool rowConfirmed[MAX_H] = { false };
+Pattern pattern;                     // fully loaded pattern (editor, small files)
+PatternRowSource patternRows(pattern);
+PatternWindow patternWindow;         // large binary files, rows fetched on demand
+KnitView knitView;                   // mirror/invert/tile/offset over one of the two
+RowSource* knitRows = &knitView;
+KnitEngine engine(cfg);              // active row, confirmations, pulses, warning
+StateJournal journal;                // engine progress across reboots
+
+// Knitted size and shown pattern row, refreshed while holding the pattern lock
+static int knitW = 0;
+static int knitBaseH = 0;
+static int knitPatternRow = 0;
+static uint32_t patternGen = 0;      // last pattern change applied
+
+// Web task state: settings and pattern file as edited through the web UI
+AppConfig webCfg;
+KnitLink knitLink;
 
 // WiFi
 WifiCreds wifiCreds;
 
-// ============================================================
-// ------------------- FORWARD DECLARATIONS --------------------
-// ============================================================
-
-void loadConfig(AppConfig& cfg);
-void saveConfig(const AppConfig& cfg);
-
 // ============================================================
 // -------------------- UTILITY FUNCTIONS ----------------------
 // ============================================================
@@ -108,82 +151,259 @@ static void ensureFS() {
   }
 }
 
-// Wrap row index 0..h-1
-static int wrapRow(int r) {
-  if (pattern.h <= 0) return 0;
-  while (r < 0) r += pattern.h;
-  while (r >= pattern.h) r -= pattern.h;
-  return r;
+// Cache the knitted size (the pulse path must not touch the pattern) and
+// keep row state in range.
+static void syncKnitSize() {
+  knitW = knitRows->width();
+  knitBaseH = knitView.baseHeight();
+  engine.setHeight(knitRows->height());
 }
 
-// Map "step +1/-1" to internal row index change based on direction
-// rowFromBottom=false: +1 means go down (row index +1)
-// rowFromBottom=true:  +1 means go up in index (row index -1) because counting starts from bottom
-static void stepRow(int step) {
-  cfg.warnBlinkActive = false;
+// Pick the row source for cfg.currentPatternFile: large binary files are
+// knitted through the row window, everything else from the loaded pattern.
+static void selectKnitRows() {
+  if (patternWantsWindow(cfg.currentPatternFile) && patternWindow.open(cfg.currentPatternFile)) {
+    knitView.setBase(&patternWindow);
+  } else {
+    patternWindow.close();
+    knitView.setBase(&patternRows);
+  }
+  knitView.configure(cfg);
+  syncKnitSize();
+  knitRows->prefetch(engine.activeRow(), cfg.rowFromBottom ? -1 : +1);
+}
 
-  int dir = cfg.rowFromBottom ? -1 : +1;
-  cfg.activeRow = wrapRow(cfg.activeRow + step * dir);
+// Frames go out through RMT in the background, one channel per data pin;
+// the NeoPixel library is the fallback if the RMT driver can't be installed.
+static void startLeds() {
+  LedSegment seg[LED_MAX_SEGMENTS];
+  int n = 0;
+  if (!parseLedSegments(cfg.ledSegments, seg, n)) {
+    Serial.println("Invalid LED segments, using default");
+    parseLedSegments(AppConfig().ledSegments, seg, n);
+  }
+  leds.setSegments(seg, n);
+
+  for (int i = 0; i < leds.outputs(); i++) {
+    const LedOutputRange& r = leds.output(i);
+    RmtLedOutput* rmt = new RmtLedOutput(r.pin, (rmt_channel_t)i);
+    if (rmt->begin()) {
+      ledOutputs[i] = rmt;
+      continue;
+    }
+    delete rmt;
+    Serial.println("RMT LED output on pin " + String(r.pin) + " failed, using NeoPixel library");
+    NeoPixelOutput* neo = new NeoPixelOutput(r.count, r.pin, LED_TYPE);
+    neo->begin();
+    ledOutputs[i] = neo;
+  }
+  leds.begin(ledOutputs, cfg.brightness);
+}
 
-  saveConfig(cfg);
+// Outputs affected by a settings change.
+static uint8_t settingsDirty(const KnitSettings& a, const KnitSettings& b) {
+  uint8_t d = 0;
+  if (a.brightness != b.brightness) d |= DIRTY_LED_BRIGHTNESS;
+  if (a.colorActive != b.colorActive || a.colorConfirmed != b.colorConfirmed ||
+      a.colorCorrection != b.colorCorrection) {
+    d |= DIRTY_LED_FRAME;
+  }
+  if (a.rowFromBottom != b.rowFromBottom) d |= DIRTY_OLED;
+  if (a.blinkWarning != b.blinkWarning) d |= DIRTY_WARN;
+  if (a.needlePitch != b.needlePitch || a.ledPitch != b.ledPitch || a.viewCenter != b.viewCenter) {
+    d |= DIRTY_LED_LAYOUT;
+  }
+  return d;
 }
 
-static int shownRowNumber1based() {
-  // OLED/web should show "Row 1" at the "start" according to direction
-  // activeRow is internal index where 0 is top.
-  return cfg.rowFromBottom ? (pattern.h - cfg.activeRow) : (cfg.activeRow + 1);
+// Pattern changes and settings from the web task (pattern lock held).
+// Returns the outputs they affect.
+static uint8_t syncFromWeb() {
+  uint8_t dirty = 0;
+  String file;
+  bool clear;
+  uint32_t gen;
+  if (knitLink.takePatternChange(file, clear, gen)) {
+    cfg.currentPatternFile = file;
+    if (clear) engine.clearConfirmed();
+    selectKnitRows();
+    patternGen = gen;
+    dirty |= DIRTY_LED_LAYOUT | DIRTY_OLED;
+  }
+
+  KnitSettings before;
+  before.from(cfg);
+  if (knitLink.takeSettings(cfg)) {
+    KnitSettings after;
+    after.from(cfg);
+    dirty |= settingsDirty(before, after);
+
+    // View transforms may change the knitted height; keep row state in range.
+    if (knitView.configure(cfg)) {
+      syncKnitSize();
+      dirty |= DIRTY_LED_LAYOUT | DIRTY_OLED;
+    }
+  }
+
+  int dir = engine.takeStepDir();
+  if (dir) knitRows->prefetch(engine.activeRow(), dir);
+  knitPatternRow = knitView.baseRow(engine.activeRow());
+  return dirty;
 }
 
-static void refreshOutputs() {
-  // OLED
-  oled.showKnitStatus(shownRowNumber1based(), pattern.h, cfg.totalPulses);
+// ============================================================
+// ------------------- MAIN WEB SERVER -------------------------
+// ============================================================
+
+static void startMainServer() {
+  WebUiDeps deps;
+  deps.server = &server;
+  deps.pattern = &pattern;
+  deps.cfg = &webCfg;
+  deps.engine = &engine;
+  deps.knit = &knitLink;
+  deps.carriage = &carriage;
 
-  // LEDs (active row)
-  leds.showRow(pattern, cfg.activeRow, rowConfirmed[cfg.activeRow], cfg);
+  webuiBegin(deps);
+  server.begin();
 }
 
 // ============================================================
-// ------------------- KNITTING ACTIONS ------------------------
+// --------------------------- TASKS ---------------------------
 // ============================================================
 
-static void doConfirm() {
-  rowConfirmed[cfg.activeRow] = true;
-  cfg.warnBlinkActive = false;
+// Outputs waiting for an update. Collected every pass and applied once the
+// pattern lock is free, so nothing is lost while the web task edits.
+static uint8_t outputsDirty = DIRTY_ALL;
 
-  if (cfg.autoAdvance) {
-    stepRow(+1);          // wraps + respects direction
-  } else {
-    saveConfig(cfg);
+// Updates only the outputs marked dirty and drives the warning blink, so a
+// pulse count redraws the OLED without pushing the strip and a color change
+// pushes the strip without redrawing the OLED. Pattern lock held.
+static void updateOutputs() {
+  static uint32_t lastBlinkMs = 0;
+  static bool blinkOn = true;
+
+  const bool blinking = engine.warn() && cfg.blinkWarning;
+  const uint32_t now = millis();
+  uint8_t dirty = outputsDirty;
+  outputsDirty = 0;
+
+  // ---- Blink warning handling ----
+  if (dirty & DIRTY_WARN) {
+    // Warning switched on or off: restart the blink with the row shown
+    lastBlinkMs = now;
+    blinkOn = true;
+    dirty |= DIRTY_LED_FRAME;
+  } else if (blinking && now - lastBlinkMs > 300) {
+    lastBlinkMs = now;
+    blinkOn = !blinkOn;
+    dirty |= DIRTY_LED_FRAME;
+  }
+
+  // Width, pitch or viewport: rebuild the LED table before drawing
+  if (dirty & DIRTY_LED_LAYOUT) {
+    leds.setView(knitW, cfg);
+    dirty |= DIRTY_LED_FRAME;
+  }
+
+  // Brightness is applied while building frames; the frame below pushes it in the same show()
+  if (dirty & DIRTY_LED_BRIGHTNESS) {
+    leds.setBrightness(cfg.brightness);
+    dirty |= DIRTY_LED_FRAME;
   }
 
-  refreshOutputs();
+  if (dirty & DIRTY_LED_FRAME) {
+    leds.blinkRow(*knitRows, engine.activeRow(), engine.activeConfirmed(), cfg, blinkOn || !blinking);
+
+    // The next pulse or Up lands here: have its frame ready
+    int next = engine.nextRow();
+    leds.prepareRow(*knitRows, next, engine.confirmed().get(next), cfg);
+  }
+
+  if (dirty & DIRTY_OLED) {
+    oled.showKnitStatus(engine.shownRow(), engine.height(), engine.totalPulses());
+  }
+}
+
+static void publishState() {
+  KnitSnapshot s;
+  s.activeRow = engine.activeRow();
+  s.patternRow = knitPatternRow;
+  s.totalPulses = engine.totalPulses();
+  s.w = knitW;
+  s.h = engine.height();
+  s.baseH = knitBaseH;
+  s.warn = engine.warn();
+  s.version = engine.version();
+  s.ticket = engine.lastTicket();
+  s.patternGen = patternGen;
+  s.maxCommandUs = engine.maxLatencyUs();
+  knitLink.publish(s);
 }
 
-static void onCarriagePulse() {
-  cfg.totalPulses++;
+// Inputs, row state and outputs. Never waits for the web task: if the
+// pattern is being edited, pulses are still counted and the LEDs catch up
+// on the next pass.
+static void knitTask(void*) {
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(KNIT_TICK_MS));
+
+    // Hardware controls active only when connected.
+    // Carriage edges are buffered by the interrupt, so drain them every pass.
+    // Inputs become engine commands, queued with web commands in arrival order.
+    const bool connected = (WiFi.status() == WL_CONNECTED);
+    uint32_t pulseUs;
+    while (carriage.nextPulse(pulseUs)) {
+      if (connected) engine.post(KNIT_PULSE, 0, pulseUs);
+    }
+
+    if (connected) {
+      if (btnUp.pressed()) engine.post(KNIT_STEP, +1);
+      if (btnDown.pressed()) engine.post(KNIT_STEP, -1);
+      if (btnConfirm.pressed()) engine.post(KNIT_CONFIRM);
+    }
+
+    engine.process();
+
+    if (knitLink.tryLockPattern()) {
+      outputsDirty |= syncFromWeb();
+      outputsDirty |= engine.takeDirty();
+      updateOutputs();
+      knitLink.unlockPattern();
+    }
 
-  // Blink warning if carriage moved but current row not confirmed
-  if (cfg.blinkWarning && !rowConfirmed[cfg.activeRow]) {
-    cfg.warnBlinkActive = true;
+    journal.record(cfg.currentPatternFile, engine);
+    publishState();
   }
+}
+
+// HTTP, DNS (portal) and everything that writes flash.
+static void webTask(void*) {
+  for (;;) {
+    server.handleClient();
+    webuiLoop();
+    if (portalActive) {
+      dns.processNextRequest();
+    }
 
-  stepRow(+1);            // carriage acts like "UP" (next row in chosen direction)
-  refreshOutputs();
+    // Deferred settings write and progress journal
+    configLoop(webCfg);
+    journal.loop();
+
+    vTaskDelay(pdMS_TO_TICKS(2));
+  }
 }
 
-// ============================================================
-// ------------------- MAIN WEB SERVER -------------------------
-// ============================================================
+static void startTasks() {
+  publishState();
 
-static void startMainServer() {
-  WebUiDeps deps;
-  deps.server = &server;
-  deps.pattern = &pattern;
-  deps.cfg = &cfg;
-  deps.rowConfirmed = rowConfirmed;
+  TaskHandle_t knit = nullptr;
+  xTaskCreatePinnedToCore(knitTask, "knit", KNIT_TASK_STACK, nullptr, KNIT_TASK_PRIO, &knit, KNIT_CORE);
+  knitLink.setKnitTask(knit);
+  engine.setOwner(knit);
+  carriage.notify(knit);
 
-  webuiBegin(deps);
-  server.begin();
+  xTaskCreatePinnedToCore(webTask, "web", WEB_TASK_STACK, nullptr, WEB_TASK_PRIO, nullptr, WEB_CORE);
 }
 
 // ============================================================
@@ -195,7 +415,7 @@ void setup() {
 
   // OLED
   Wire.begin(PIN_SDA, PIN_SCL);
-  oled.begin();
+  if (!oled.begin(OLED_TASK_PRIO, OLED_CORE)) Serial.println("OLED task failed");
 
   // File system
   ensureFS();
@@ -204,33 +424,49 @@ void setup() {
   loadConfig(cfg);
   loadWifiCreds();
 
-  // Load or create default pattern
-  if (!loadPatternFile(cfg.currentPatternFile, pattern)) {
-    pattern.name = "default";
-    pattern.w = 12;
-    pattern.h = 24;
+  // Pending settings and progress are written before a software reset (ESP.restart()).
+  esp_register_shutdown_handler([]() {
+    flushConfig(webCfg);
+    journal.flush();
+  });
+
+  // Load or create default pattern (large binary files stay on flash)
+  if (!patternWantsWindow(cfg.currentPatternFile) &&
+      !loadPatternFile(cfg.currentPatternFile, pattern)) {
+    pattern = Pattern();
     savePatternFile("/patterns/default.json", pattern);
     cfg.currentPatternFile = "/patterns/default.json";
     saveConfig(cfg);
   }
 
-  cfg.activeRow = wrapRow(cfg.activeRow);
+  selectKnitRows();
+
+  // Knitting progress from the last session
+  int row = cfg.activeRow;
+  uint32_t pulses = 0;
+  journal.restore(cfg.currentPatternFile, row, pulses, engine.confirmed());
+  engine.restore(row, pulses);
+  knitPatternRow = knitView.baseRow(engine.activeRow());
+
+  // From here on the web side edits its own copy and hands changes over
+  webCfg = cfg;
+  if (!knitLink.begin()) Serial.println("KnitLink init failed");
 
   // LEDs
-  leds.begin(cfg.brightness);
+  startLeds();
 
   // Buttons
   btnUp.begin(PIN_BTN_UP, true);
   btnDown.begin(PIN_BTN_DOWN, true);
   btnConfirm.begin(PIN_BTN_CONFIRM, true);
-  btnCarriage.begin(PIN_SENSOR_CARRIAGE, true);
+  carriage.begin(PIN_SENSOR_CARRIAGE, true);
 
   // ---- Try STA WiFi first ----
   if (!wifiCreds.ssid.isEmpty() && wifiConnectSTA(wifiCreds, 12000)) {
     oled.showIp(WiFi.localIP().toString());
     startMainServer();
     delay(350);
-    refreshOutputs();
+    startTasks();  // first pass draws the knitting status
     return;
   }
 
@@ -258,89 +494,14 @@ void setup() {
       ESP.restart();  // reboot to clean STA mode
     }
   );
+  startTasks();
 }
 
 // ============================================================
 // ---------------------------- LOOP ---------------------------
 // ============================================================
 
+// Everything runs in knitTask() and webTask().
 void loop() {
-  server.handleClient();
-  if (portalActive) {
-    dns.processNextRequest();
-  }
-
-  // Hardware controls active only when connected
-  if (WiFi.status() == WL_CONNECTED) {
-    if (btnUp.pressed()) {
-      stepRow(+1);
-      refreshOutputs();
-    }
-    if (btnDown.pressed()) {
-      stepRow(-1);
-      refreshOutputs();
-    }
-    if (btnConfirm.pressed()) {
-      doConfirm();
-    }
-    if (btnCarriage.pressed()) {
-      onCarriagePulse();
-    }
-  }
-
-  // ---- Detect changes made by Web UI and refresh outputs ----
-  // Web UI updates cfg.activeRow via /api/row and changes cfg via /api/config.
-  // This observer makes OLED + LEDs follow those changes.
-  static int lastRow = -999;
-  static uint32_t lastTot = 0;
-  static bool lastWarn = false;
-  static uint8_t lastBright = 255;
-  static uint32_t lastCA = 0;
-  static uint32_t lastCC = 0;
-  static bool lastRB = false;
-  static int lastH = -1;
-  static int lastW = -1;
-
-  bool changed =
-    (cfg.activeRow != lastRow) ||
-    (cfg.totalPulses != lastTot) ||
-    (cfg.warnBlinkActive != lastWarn) ||
-    (cfg.brightness != lastBright) ||
-    (cfg.colorActive != lastCA) ||
-    (cfg.colorConfirmed != lastCC) ||
-    (cfg.rowFromBottom != lastRB) ||
-    (pattern.h != lastH) ||
-    (pattern.w != lastW);
-
-  if (changed) {
-    // Apply brightness change immediately
-    leds.setBrightness(cfg.brightness);
-
-    refreshOutputs();
-
-    lastRow = cfg.activeRow;
-    lastTot = cfg.totalPulses;
-    lastWarn = cfg.warnBlinkActive;
-    lastBright = cfg.brightness;
-    lastCA = cfg.colorActive;
-    lastCC = cfg.colorConfirmed;
-    lastRB = cfg.rowFromBottom;
-    lastH = pattern.h;
-    lastW = pattern.w;
-  }
-
-  // ---- Blink warning handling ----
-  static uint32_t lastBlinkMs = 0;
-  static bool blinkOn = true;
-
-  if (cfg.warnBlinkActive && cfg.blinkWarning) {
-    uint32_t now = millis();
-    if (now - lastBlinkMs > 300) {
-      lastBlinkMs = now;
-      blinkOn = !blinkOn;
-      leds.blinkRow(pattern, cfg.activeRow, rowConfirmed[cfg.activeRow], cfg, blinkOn);
-    }
-  }
-
-  delay(5);
+  vTaskDelete(nullptr);
 }
@@ -0,0 +1,234 @@
+#!/usr/bin/env python3
+"""Checks and load test for HttpServer, run against http_load/server.cpp.
+
+Usage: load_test.py <server binary> [port]
+
+Starts the server, checks request parsing, keep-alive, pipelining, uploads,
+streamed and pulled responses, event streams and the size limits, then
+measures keep-alive throughput. Exits non-zero on the first failed check.
+"""
+
+import http.client
+import random
+import socket
+import subprocess
+import sys
+import threading
+import time
+
+PORT = int(sys.argv[2]) if len(sys.argv) > 2 else 18080
+HOST = ("127.0.0.1", PORT)
+
+
+def conn():
+    return http.client.HTTPConnection(*HOST, timeout=10)
+
+
+def read_all(sock):
+    data = b""
+    while True:
+        k = sock.recv(65536)
+        if not k:
+            return data
+        data += k
+
+
+def raw(request):
+    s = socket.create_connection(HOST)
+    s.sendall(request)
+    return s
+
+
+def basic():
+    c = conn()
+    c.request("GET", "/echo?x=hello%20w+z")
+    r = c.getresponse()
+    assert r.read() == b"hello w z"
+    assert r.getheader("Connection") == "keep-alive"
+
+    c.request("POST", "/body", body='{"a":1234567890}', headers={"Content-Type": "application/json"})
+    assert c.getresponse().read() == b'16:{"a":12345'
+    c.request("POST", "/form", body="ssid=my+net&pass=p%26w",
+              headers={"Content-Type": "application/x-www-form-urlencoded"})
+    assert c.getresponse().read() == b"my net|p&w"
+    c.request("GET", "/flash")
+    assert c.getresponse().read() == b"0123456789abcdef"
+
+    c.request("GET", "/nope")
+    r = c.getresponse()
+    r.read()
+    assert r.status == 302 and r.getheader("Location") == "/"
+
+    for path in ("/chunked", "/pull"):
+        c.request("GET", path)
+        d = c.getresponse().read()
+        assert len(d) == 512 * 200 and d[512] == ord("1") and d[-512] == ord("9"), (path, len(d))
+
+    c.request("GET", "/file")
+    r = c.getresponse()
+    d = r.read()
+    assert r.getheader("X-Test") == "1" and len(d) == 60000
+    assert all(d[i] == (i * 7 + 3) & 255 for i in range(0, 60000, 997))
+    print("basic ok")
+
+
+def slow_upload():
+    """A multipart upload trickles in while other requests are served."""
+    data = bytes(random.getrandbits(8) for _ in range(100000)).replace(b"\r\n--", b"xxxx")
+    bnd = "----bnd12345"
+    body = (f'--{bnd}\r\nContent-Disposition: form-data; name="upload"; filename="a.kpb"\r\n'
+            "Content-Type: application/octet-stream\r\n\r\n").encode() + data + f"\r\n--{bnd}--\r\n".encode()
+    s = raw(f"POST /upload HTTP/1.1\r\nHost: x\r\nContent-Type: multipart/form-data; boundary={bnd}\r\n"
+            f"Content-Length: {len(body)}\r\n\r\n".encode())
+    done = []
+
+    def send():
+        for i in range(0, len(body), 7000):
+            s.sendall(body[i:i + 7000])
+            time.sleep(0.02)
+        done.append(1)
+
+    t = threading.Thread(target=send)
+    t.start()
+    served = 0
+    while not done:
+        c = conn()
+        c.request("GET", "/echo?x=1")
+        assert c.getresponse().read() == b"1"
+        served += 1
+        c.close()
+    t.join()
+    resp = b""
+    while b"\r\n\r\n" not in resp or not resp.endswith(b"a.kpb"):
+        resp += s.recv(4096)
+    assert resp.split(b"\r\n\r\n")[1] == b"100000 1 1 1 0 a.kpb", resp
+    print("upload ok, requests served meanwhile:", served)
+
+    # raw body to an upload route: streamed to the handler, empty filename
+    c = conn()
+    c.request("POST", "/upload", body=bytes(range(256)) * 40,
+              headers={"Content-Type": "application/x-knittled-pattern"})
+    t = c.getresponse().read().decode()
+    assert t.startswith("10240 1 1 1 0"), t
+    print("raw upload ok")
+
+
+def slow_reader():
+    """A client that does not read its pulled response holds up nobody."""
+    s = raw(b"GET /pull HTTP/1.1\r\nHost: x\r\n\r\n")
+    time.sleep(0.2)
+    t0 = time.time()
+    c = conn()
+    c.request("GET", "/echo?x=2")
+    assert c.getresponse().read() == b"2"
+    print("request beside a slow reader: %.3fs" % (time.time() - t0))
+    got = b""
+    while not got.endswith(b"0\r\n\r\n"):
+        got += s.recv(65536)
+
+    # a body source with nothing to write yet holds up nobody either
+    late = raw(b"GET /later HTTP/1.1\r\nHost: x\r\n\r\n")
+    t0 = time.time()
+    c.request("GET", "/echo?x=3")
+    assert c.getresponse().read() == b"3" and time.time() - t0 < 0.2
+    got = b""
+    while not got.endswith(b"0\r\n\r\n"):
+        got += late.recv(4096)
+    assert b"\r\n4\r\nlate\r\n" in got, got
+
+    # a body source that gives up: truncated response, connection closed
+    got = read_all(raw(b"GET /pullfail HTTP/1.1\r\n\r\n"))
+    assert not got.endswith(b"0\r\n\r\n") and len(got) < 512 * 60, len(got)
+    print("pulled responses ok")
+
+
+def events():
+    e = raw(b"GET /events HTTP/1.1\r\nHost: x\r\n\r\n")
+    time.sleep(0.1)
+    c = conn()
+    c.request("POST", "/push", body="hello")
+    assert c.getresponse().read() == b"ok"
+    time.sleep(0.1)
+    ev = e.recv(4096)
+    assert b"text/event-stream" in ev and ev.endswith(b"retry: 1\n\ndata: hello\n\n"), ev
+    e.close()
+    time.sleep(0.1)
+    c.request("POST", "/push", body="x")
+    assert c.getresponse().read() == b"gone"
+    print("events ok")
+
+
+def protocol():
+    got = read_all(raw(b"GET /echo?x=a HTTP/1.1\r\n\r\nGET /echo?x=b HTTP/1.1\r\nConnection: close\r\n\r\n"))
+    assert got.count(b"200 OK") == 2 and got.endswith(b"b"), got
+
+    assert b" 431 " in raw(b"GET / HTTP/1.1\r\nX: " + b"a" * 3000 + b"\r\n\r\n").recv(100)
+
+    # HTTP/1.0 has no chunks: the body ends with the connection
+    for path in (b"/chunked", b"/pull"):
+        got = read_all(raw(b"GET " + path + b" HTTP/1.0\r\n\r\n"))
+        assert len(got.split(b"\r\n\r\n", 1)[1]) == 512 * 200, path
+
+    # bodies kept in RAM: 8 KB accepted, more refused before it is read
+    c = conn()
+    c.request("POST", "/body", body="x" * 8192, headers={"Content-Type": "application/json"})
+    assert c.getresponse().read().startswith(b"8192:")
+    c.request("POST", "/body", body="x" * 8193, headers={"Content-Type": "application/json"})
+    r = c.getresponse()
+    assert r.status == 413 and r.getheader("Connection") == "close", r.status
+    assert b" 413 " in raw(b"POST /body HTTP/1.1\r\nContent-Length: 4000000000\r\n\r\n").recv(100)
+
+    # the same limit for each non-file multipart field
+    bnd = "b0"
+    for size, status in ((8192, 200), (20000, 413)):
+        body = (f'--{bnd}\r\nContent-Disposition: form-data; name="note"\r\n\r\n'.encode() + b"n" * size +
+                f"\r\n--{bnd}--\r\n".encode())
+        c = conn()
+        c.request("POST", "/upload", body=body, headers={"Content-Type": f"multipart/form-data; boundary={bnd}"})
+        r = c.getresponse()
+        r.read()
+        assert r.status == status, (size, r.status)
+    print("protocol ok")
+
+
+def load(threads=16, requests=200):
+    errs = []
+
+    def run():
+        try:
+            c = conn()
+            for i in range(requests):
+                c.request("GET", "/echo?x=%d" % i)
+                assert c.getresponse().read() == str(i).encode()
+        except Exception as ex:  # reported below
+            errs.append(ex)
+
+    ts = [threading.Thread(target=run) for _ in range(threads)]
+    t0 = time.time()
+    for t in ts:
+        t.start()
+    for t in ts:
+        t.join()
+    print("load: %d keep-alive requests on %d connections in %.2fs, errors: %d"
+          % (threads * requests, threads, time.time() - t0, len(errs)))
+    assert not errs, errs[:2]
+
+
+def main():
+    srv = subprocess.Popen([sys.argv[1], str(PORT)], stdout=subprocess.PIPE)
+    try:
+        assert srv.stdout.readline().strip() == b"ready", "server did not start"
+        basic()
+        slow_upload()
+        slow_reader()
+        events()
+        protocol()
+        load()
+        print("all ok")
+    finally:
+        srv.terminate()
+        srv.wait()
+
+
+if __name__ == "__main__":
+    main()
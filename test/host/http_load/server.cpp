@@ -0,0 +1,146 @@
+/**
+ * @file server.cpp
+ * @brief HttpServer on the host with test routes, driven by load_test.py.
+ *
+ * Usage: server [port] (default 18080). Prints "ready" once listening.
+ */
+
+#include "HttpServer.h"
+#include <signal.h>
+#include <unistd.h>
+#include <string>
+
+// The one "file" streamFile() sends: FILE_SIZE bytes, byte i = i*7+3.
+static const size_t FILE_SIZE = 60000;
+static size_t filePos = 0;
+static bool fileOpen = false;
+
+size_t fs::File::read(uint8_t* b, size_t n) {
+  size_t k = 0;
+  while (k < n && filePos < FILE_SIZE) b[k++] = (uint8_t)(filePos++ * 7 + 3);
+  return k;
+}
+size_t fs::File::size() const { return FILE_SIZE; }
+void fs::File::close() { fileOpen = false; }
+fs::File::operator bool() const { return fileOpen; }
+size_t fs::File::write(uint8_t) { return 0; }
+size_t fs::File::write(const uint8_t*, size_t) { return 0; }
+int fs::File::available() { return 0; }
+int fs::File::read() { return -1; }
+int fs::File::peek() { return -1; }
+
+// 200 pieces of 512 bytes, piece i starting with the digit i%10;
+// gives up before piece failAt if that is set.
+class Pieces : public HttpBodySource {
+public:
+  explicit Pieces(int failAt = -1) : _failAt(failAt) {}
+
+  bool fill(Print& out) override {
+    if (_i == _failAt) return false;
+    std::string s(512, 'a');
+    s[0] = (char)('0' + _i % 10);
+    out.write(s.c_str(), s.size());
+    _i++;
+    return true;
+  }
+  bool done() const override { return _i == 200; }
+
+private:
+  int _i = 0;
+  int _failAt;
+};
+
+// Writes nothing until 300 ms have passed, then "late" (an answer that
+// waits for another task, as the row commands do).
+class Later : public HttpBodySource {
+public:
+  bool fill(Print& out) override {
+    if (millis() - _start < 300) return true;
+    out.print("late");
+    _done = true;
+    return true;
+  }
+  bool done() const override { return _done; }
+
+private:
+  uint32_t _start = millis();
+  bool _done = false;
+};
+
+static HttpServer* server;
+static std::string uploaded;
+static int uploadEvents[4];
+static int streamId = -1;
+
+static void uploadDone() {
+  char b[96];
+  snprintf(b, sizeof(b), "%zu %d %d %d %d %s", uploaded.size(), uploadEvents[UPLOAD_FILE_START],
+           uploadEvents[UPLOAD_FILE_WRITE] > 0, uploadEvents[UPLOAD_FILE_END],
+           uploadEvents[UPLOAD_FILE_ABORTED], server->upload().filename.c_str());
+  server->send(200, "text/plain", b);
+  uploaded.clear();
+  for (int& e : uploadEvents) e = 0;
+}
+
+static void uploadPiece() {
+  HTTPUpload& u = server->upload();
+  uploadEvents[u.status]++;
+  if (u.status == UPLOAD_FILE_WRITE) uploaded.append((const char*)u.buf, u.currentSize);
+}
+
+int main(int argc, char** argv) {
+  signal(SIGPIPE, SIG_IGN);
+  static HttpServer srv(argc > 1 ? atoi(argv[1]) : 18080);
+  server = &srv;
+  HttpServer& S = srv;
+
+  S.on("/echo", HTTP_GET, [&] { S.send(200, "text/plain", S.arg("x")); });
+  S.on("/body", HTTP_POST, [&] {
+    String plain = S.arg("plain");
+    S.send(200, "text/plain", String(plain.length()) + ":" + plain.substring(0, 10));
+  });
+  S.on("/form", HTTP_POST, [&] { S.send(200, "text/plain", S.arg("ssid") + "|" + S.arg("pass")); });
+  S.on("/upload", HTTP_POST, uploadDone, uploadPiece);
+  S.on("/chunked", HTTP_GET, [&] {
+    S.setContentLength(CONTENT_LENGTH_UNKNOWN);
+    S.send(200, "text/plain", "");
+    std::string s(512, 'a');
+    for (int i = 0; i < 200; i++) {
+      s[0] = (char)('0' + i % 10);
+      S.sendContent(s.c_str(), s.size());
+    }
+    S.sendContent("");
+  });
+  S.on("/pull", HTTP_GET, [&] { S.sendChunked(200, "text/plain", new Pieces()); });
+  S.on("/pullfail", HTTP_GET, [&] { S.sendChunked(200, "text/plain", new Pieces(50)); });
+  S.on("/later", HTTP_GET, [&] { S.sendChunked(200, "text/plain", new Later()); });
+  static const char flashBody[] = "0123456789abcdef";
+  S.on("/flash", HTTP_GET, [&] { S.send_P(200, "text/plain", flashBody, 16); });
+  S.on("/file", HTTP_GET, [&] {
+    filePos = 0;
+    fileOpen = true;
+    File f;
+    S.sendHeader("X-Test", "1");
+    S.streamFile(f, "application/octet-stream");
+  });
+  S.on("/events", HTTP_GET, [&] {
+    streamId = S.beginStream("text/event-stream");
+    S.push(streamId, "retry: 1\n\n");
+  });
+  S.on("/push", HTTP_POST, [&] {
+    bool ok = S.push(streamId, "data: " + S.arg("plain") + "\n\n");
+    S.send(200, "text/plain", ok ? "ok" : "gone");
+  });
+  S.onNotFound([&] {
+    S.sendHeader("Location", "/");
+    S.send(302);
+  });
+
+  if (!S.begin()) return 1;
+  puts("ready");
+  fflush(stdout);
+  for (;;) {
+    S.handleClient();
+    usleep(500);
+  }
+}
@@ -0,0 +1,181 @@
+/**
+ * @file row_kernels.cpp
+ * @brief RowKernels.h against plain per-stitch loops: checks and benchmark.
+ *
+ * Usage: row_kernels [bench]
+ *
+ * Every kernel is compared with a bool-per-stitch reference (the layout rows
+ * had before they were packed) for all widths 1..MAX_W, shifts across and
+ * past the width and random rows; the tail bits must stay clear. With
+ * @c bench each kernel and its reference are also timed on 200-stitch rows.
+ */
+
+#include "RowKernels.h"
+#include <chrono>
+#include <random>
+
+static std::mt19937 rng(12345);
+static int failures = 0;
+
+static const int NW = (MAX_W + PATTERN_WORD_BITS - 1) / PATTERN_WORD_BITS;
+
+struct Row {
+  uint32_t words[NW + 1];  // one spare word catches writes past the row
+  bool bits[MAX_W];
+};
+
+static bool bitOf(const uint32_t* s, int c) { return (s[c / 32] >> (c % 32)) & 1u; }
+
+static void randomRow(Row& r, int w) {
+  memset(r.words, 0, sizeof(r.words));
+  for (int c = 0; c < w; c++) {
+    r.bits[c] = rng() & 1;
+    if (r.bits[c]) r.words[c / 32] |= 1u << (c % 32);
+  }
+}
+
+static void clobber(uint32_t* d) {
+  for (int i = 0; i <= NW; i++) d[i] = 0xA5A5A5A5u;
+}
+
+// d must hold exactly the stitches of want, with clear tail bits and the
+// word after the row untouched.
+static void expectRow(const char* what, int w, int k, const uint32_t* d, const bool* want) {
+  const int nw = patternWordsPerRow(w);
+  bool ok = (d[nw - 1] & ~rowTailMask(w)) == 0 && d[NW] == 0xA5A5A5A5u;
+  for (int c = 0; ok && c < w; c++) ok = bitOf(d, c) == want[c];
+  if (!ok && failures++ < 10) printf("FAIL %s w=%d k=%d\n", what, w, k);
+}
+
+// ---- Reference loops, one stitch at a time ----
+
+static void refReverse(bool* d, const bool* s, int w) {
+  for (int c = 0; c < w; c++) d[c] = s[w - 1 - c];
+}
+
+static void refShiftUp(bool* d, const bool* s, int w, int k) {
+  for (int c = 0; c < w; c++) d[c] = c - k >= 0 && s[c - k];
+}
+
+static void refShiftDown(bool* d, const bool* s, int w, int k) {
+  for (int c = 0; c < w; c++) d[c] = c + k < w && s[c + k];
+}
+
+static void refRotate(bool* d, const bool* s, int w, int k) {
+  for (int c = 0; c < w; c++) d[c] = s[(((c + k) % w) + w) % w];
+}
+
+static void refTile(bool* d, const bool* s, int bw, int w) {
+  for (int c = 0; c < w; c++) d[c] = s[c % bw];
+}
+
+// ---- Checks ----
+
+static void check() {
+  Row s, d;
+  bool want[MAX_W];
+  long cases = 0;
+
+  for (int w = 1; w <= MAX_W; w++) {
+    for (int round = 0; round < 4; round++) {
+      randomRow(s, w);
+      const int nw = patternWordsPerRow(w);
+
+      clobber(d.words);
+      rowReverse(d.words, s.words, w);
+      refReverse(want, s.bits, w);
+      expectRow("rowReverse", w, 0, d.words, want);
+      cases++;
+
+      for (int k = 0; k <= w + 40; k += (w > 64 ? 3 : 1)) {
+        clobber(d.words);
+        rowShiftUp(d.words, s.words, w, k);
+        refShiftUp(want, s.bits, w, k);
+        expectRow("rowShiftUp", w, k, d.words, want);
+
+        clobber(d.words);
+        rowShiftDown(d.words, s.words, w, k);
+        refShiftDown(want, s.bits, w, k);
+        expectRow("rowShiftDown", w, k, d.words, want);
+
+        clobber(d.words);
+        rowRotate(d.words, s.words, w, k - w / 2);
+        refRotate(want, s.bits, w, k - w / 2);
+        expectRow("rowRotate", w, k - w / 2, d.words, want);
+        cases += 3;
+      }
+
+      for (int pos = 0; pos < nw * 32 + 40; pos++) {
+        uint32_t got = rowBitsAt(s.words, nw, pos);
+        uint32_t ref = 0;
+        for (int b = 0; b < 32; b++) {
+          if (pos + b < w && s.bits[pos + b]) ref |= 1u << b;
+        }
+        if (got != ref && failures++ < 10) printf("FAIL rowBitsAt w=%d pos=%d\n", w, pos);
+        cases++;
+      }
+
+      for (int bw = 1; bw <= w; bw += (bw < 40 ? 1 : 7)) {
+        Row motif;
+        randomRow(motif, bw);
+        clobber(d.words);
+        rowTile(d.words, motif.words, bw, w);
+        refTile(want, motif.bits, bw, w);
+        expectRow("rowTile", w, bw, d.words, want);
+        cases++;
+      }
+    }
+  }
+  printf("%ld cases, %d failures\n", cases, failures);
+}
+
+// ---- Benchmark ----
+
+template <class F>
+static double nsPerCall(F f) {
+  const int calls = 200000;
+  auto t0 = std::chrono::steady_clock::now();
+  for (int i = 0; i < calls; i++) f(i);
+  auto t1 = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::nano>(t1 - t0).count() / calls;
+}
+
+static void bench() {
+  const int w = 200;
+  Row s, motif, d;
+  bool dbits[MAX_W];
+  randomRow(s, w);
+  randomRow(motif, 12);
+  volatile uint32_t sink = 0;  // keeps the results alive
+
+  printf("%-12s %10s %10s   (%d stitches, ns per row)\n", "kernel", "packed", "bool", w);
+  auto line = [](const char* name, double packed, double ref) {
+    printf("%-12s %10.1f %10.1f   x%.1f\n", name, packed, ref, ref / packed);
+  };
+
+  line("rowReverse",
+       nsPerCall([&](int i) { s.words[0] ^= i; rowReverse(d.words, s.words, w); sink = sink + d.words[3]; }),
+       nsPerCall([&](int i) { s.bits[0] ^= 1; refReverse(dbits, s.bits, w); sink = sink + dbits[7]; }));
+  line("rowShiftUp",
+       nsPerCall([&](int i) { rowShiftUp(d.words, s.words, w, i % w); sink = sink + d.words[3]; }),
+       nsPerCall([&](int i) { refShiftUp(dbits, s.bits, w, i % w); sink = sink + dbits[7]; }));
+  line("rowRotate",
+       nsPerCall([&](int i) { rowRotate(d.words, s.words, w, i % w); sink = sink + d.words[3]; }),
+       nsPerCall([&](int i) { refRotate(dbits, s.bits, w, i % w); sink = sink + dbits[7]; }));
+  line("rowBitsAt",
+       nsPerCall([&](int i) { sink = sink + rowBitsAt(s.words, 7, i % w); }),
+       nsPerCall([&](int i) {
+         uint32_t v = 0;
+         for (int b = 0; b < 32; b++) v |= (uint32_t)(i % w + b < w && s.bits[i % w + b]) << b;
+         sink = sink + v;
+       }));
+  line("rowTile",
+       nsPerCall([&](int i) { motif.words[0] ^= i & 1; rowTile(d.words, motif.words, 12, w); sink = sink + d.words[3]; }),
+       nsPerCall([&](int i) { motif.bits[0] ^= 1; refTile(dbits, motif.bits, 12, w); sink = sink + dbits[7]; }));
+}
+
+int main(int argc, char** argv) {
+  check();
+  if (argc > 1 && strcmp(argv[1], "bench") == 0) bench();
+  return failures ? 1 : 0;
+}
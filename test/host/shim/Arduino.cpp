@@ -0,0 +1,24 @@
+/**
+ * @file Arduino.cpp
+ * @brief Host shim: clock and Serial.
+ */
+
+#include <Arduino.h>
+#include <chrono>
+#include <thread>
+
+HardwareSerial Serial;
+
+static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+uint32_t millis() {
+  return (uint32_t)std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::steady_clock::now() - start).count();
+}
+
+uint32_t micros() {
+  return (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - start).count();
+}
+
+void delay(uint32_t ms) { std::this_thread::sleep_for(std::chrono::milliseconds(ms)); }
@@ -0,0 +1,143 @@
+/**
+ * @file Arduino.h
+ * @brief Host shim: the part of the Arduino core the host tests compile against.
+ *
+ * String is backed by std::string, Serial prints to stdout and millis()
+ * counts from program start. Only what the modules under test use is here.
+ */
+
+#pragma once
+#include <ctype.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <algorithm>
+#include <string>
+
+#define PROGMEM
+#define F(s) (s)
+
+using std::max;
+using std::min;
+
+template <class A, class B, class C>
+A constrain(A v, B lo, C hi) {
+  return v < lo ? lo : (v > hi ? hi : v);
+}
+
+uint32_t millis();
+uint32_t micros();
+void delay(uint32_t ms);
+
+class String {
+public:
+  String() {}
+  String(const char* c) : _s(c ? c : "") {}
+  explicit String(char c) : _s(1, c) {}
+  explicit String(int v) : _s(std::to_string(v)) {}
+  explicit String(unsigned v) : _s(std::to_string(v)) {}
+  explicit String(long v) : _s(std::to_string(v)) {}
+  explicit String(unsigned long v) : _s(std::to_string(v)) {}
+
+  unsigned length() const { return _s.size(); }
+  bool reserve(unsigned n) {
+    _s.reserve(n);
+    return true;
+  }
+  const char* c_str() const { return _s.c_str(); }
+  bool isEmpty() const { return _s.empty(); }
+  char operator[](unsigned i) const { return _s[i]; }
+  char charAt(unsigned i) const { return _s[i]; }
+  const char* begin() const { return _s.data(); }
+  const char* end() const { return _s.data() + _s.size(); }
+
+  bool concat(const char* c, unsigned n) {
+    _s.append(c, n);
+    return true;
+  }
+  bool concat(const String& o) { return concat(o.c_str(), o.length()); }
+  bool concat(char c) { return concat(&c, 1); }
+  String& operator+=(const String& o) { concat(o); return *this; }
+  String& operator+=(const char* o) { _s += o; return *this; }
+  String& operator+=(char c) { concat(c); return *this; }
+  friend String operator+(String a, const String& b) { a += b; return a; }
+  friend String operator+(String a, const char* b) { a += b; return a; }
+  friend String operator+(const char* a, const String& b) { String r(a); r += b; return r; }
+  friend String operator+(String a, char b) { a += b; return a; }
+
+  bool operator==(const String& o) const { return _s == o._s; }
+  bool operator==(const char* o) const { return _s == o; }
+  bool operator!=(const String& o) const { return _s != o._s; }
+  bool operator!=(const char* o) const { return _s != o; }
+  bool operator<(const String& o) const { return _s < o._s; }
+  bool equalsIgnoreCase(const String& o) const { return strcasecmp(c_str(), o.c_str()) == 0; }
+  bool startsWith(const String& p) const { return _s.compare(0, p._s.size(), p._s) == 0; }
+  bool endsWith(const String& p) const {
+    return _s.size() >= p._s.size() && _s.compare(_s.size() - p._s.size(), p._s.size(), p._s) == 0;
+  }
+
+  int indexOf(char c, unsigned from = 0) const { return pos(_s.find(c, from)); }
+  int indexOf(const String& t, unsigned from = 0) const { return pos(_s.find(t._s, from)); }
+  int lastIndexOf(char c) const { return pos(_s.rfind(c)); }
+  String substring(unsigned a) const { return substring(a, length()); }
+  String substring(unsigned a, unsigned b) const {
+    if (a > b) std::swap(a, b);
+    if (a >= _s.size()) return String();
+    return String(_s.substr(a, b - a).c_str());
+  }
+  void remove(unsigned i) { if (i < _s.size()) _s.erase(i); }
+  void remove(unsigned i, unsigned n) { if (i < _s.size()) _s.erase(i, n); }
+  void toLowerCase() { for (char& c : _s) c = (char)tolower((unsigned char)c); }
+  void trim() {
+    size_t a = _s.find_first_not_of(" \t\r\n");
+    size_t b = _s.find_last_not_of(" \t\r\n");
+    _s = a == std::string::npos ? std::string() : _s.substr(a, b - a + 1);
+  }
+  long toInt() const { return atol(c_str()); }
+
+private:
+  static int pos(size_t p) { return p == std::string::npos ? -1 : (int)p; }
+  std::string _s;
+};
+
+class Print {
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t* b, size_t n) {
+    size_t k = 0;
+    while (n--) k += write(*b++);
+    return k;
+  }
+  size_t write(const char* s, size_t n) { return write((const uint8_t*)s, n); }
+  size_t print(const char* s) { return write(s, strlen(s)); }
+  size_t print(const String& s) { return write(s.c_str(), s.length()); }
+  size_t print(char c) { return write((uint8_t)c); }
+  size_t print(int v) { return print(String(v)); }
+  size_t print(unsigned v) { return print(String(v)); }
+  size_t print(long v) { return print(String(v)); }
+  size_t print(unsigned long v) { return print(String(v)); }
+  template <class T>
+  size_t println(const T& v) { return print(v) + print("\r\n"); }
+  virtual void flush() {}
+};
+
+class Stream : public Print {
+public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+};
+
+class HardwareSerial : public Stream {
+public:
+  size_t write(uint8_t c) override { return fwrite(&c, 1, 1, stdout); }
+  int available() override { return 0; }
+  int read() override { return -1; }
+  int peek() override { return -1; }
+};
+
+extern HardwareSerial Serial;
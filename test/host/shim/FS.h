@@ -0,0 +1,28 @@
+/**
+ * @file FS.h
+ * @brief Host shim: the File interface. Each test provides the bodies.
+ */
+
+#pragma once
+#include <Arduino.h>
+
+namespace fs {
+
+enum SeekMode { SeekSet, SeekCur, SeekEnd };
+
+class File : public Stream {
+public:
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t* b, size_t n) override;
+  int available() override;
+  int read() override;
+  int peek() override;
+  size_t read(uint8_t* b, size_t n);
+  size_t size() const;
+  void close();
+  explicit operator bool() const;
+};
+
+}  // namespace fs
+
+using fs::File;
@@ -0,0 +1,123 @@
+"""Build the web UI into a C header: minify, content-hash, gzip.
+
+Runs before every PlatformIO build (extra_scripts = pre:tools/build_web.py)
+and can be run by hand: python tools/build_web.py
+
+Input:  web/index.html, web/app.js, web/app.css
+Output: src/WebAssetData.h (not checked in; rewritten only when it changes)
+
+app.js and app.css are renamed to app.<hash>.js / app.<hash>.css and the
+references in index.html are updated, so their URLs change whenever their
+content does and the browser may cache them for good. Every file is stored
+gzip-compressed with a strong ETag (hash of the stored bytes).
+"""
+
+import gzip
+import hashlib
+import os
+import re
+import sys
+
+try:
+    Import("env")  # noqa: F821 (PlatformIO/SCons)
+    PROJECT_DIR = env.subst("$PROJECT_DIR")  # noqa: F821
+except NameError:
+    PROJECT_DIR = os.path.dirname(os.path.dirname(os.path.abspath(sys.argv[0])))
+
+WEB_DIR = os.path.join(PROJECT_DIR, "web")
+OUT_PATH = os.path.join(PROJECT_DIR, "src", "WebAssetData.h")
+
+
+def minify_css(text):
+    text = re.sub(r"/\*.*?\*/", "", text, flags=re.S)
+    text = re.sub(r"\s+", " ", text)
+    text = re.sub(r"\s*([{};,>])\s*", r"\1", text)
+    return text.replace(";}", "}").strip()
+
+
+def minify_js(text):
+    # Line-based on purpose: no tokenizer, so nothing inside strings or
+    # regex literals is touched. Line breaks stay (automatic semicolons).
+    lines = []
+    for line in text.splitlines():
+        line = line.strip()
+        if not line or line.startswith("//"):
+            continue
+        lines.append(line)
+    return "\n".join(lines)
+
+
+def minify_html(text):
+    return "\n".join(line.strip() for line in text.splitlines() if line.strip())
+
+
+def read(name):
+    with open(os.path.join(WEB_DIR, name), encoding="utf-8") as f:
+        return f.read()
+
+
+def gz(data):
+    return gzip.compress(data, compresslevel=9, mtime=0)
+
+
+def c_bytes(data):
+    rows = []
+    for i in range(0, len(data), 16):
+        rows.append("  " + ",".join("0x%02x" % b for b in data[i:i + 16]) + ",")
+    return "\n".join(rows)
+
+
+def build():
+    assets = []  # (path, type, raw bytes, immutable)
+
+    html = read("index.html")
+    for name, kind, mini in (("app.js", "application/javascript", minify_js),
+                             ("app.css", "text/css", minify_css)):
+        raw = mini(read(name)).encode("utf-8")
+        stem, ext = name.rsplit(".", 1)
+        hashed = "/%s.%s.%s" % (stem, hashlib.sha256(raw).hexdigest()[:8], ext)
+        ref = '"%s"' % name
+        if ref not in html:
+            sys.exit("build_web: index.html does not reference %s" % name)
+        html = html.replace(ref, '"%s"' % hashed)
+        assets.append((hashed, kind, raw, True))
+
+    assets.insert(0, ("/", "text/html; charset=utf-8", minify_html(html).encode("utf-8"), False))
+
+    out = ["// Generated by tools/build_web.py from web/ - do not edit.",
+           "#pragma once",
+           '#include "WebAssets.h"',
+           ""]
+    table = []
+    total_raw = total_gz = 0
+    for i, (path, kind, raw, immutable) in enumerate(assets):
+        data = gz(raw)
+        etag = '\\"%s\\"' % hashlib.sha256(data).hexdigest()[:16]
+        out.append("// %s: %d bytes, %d gzip" % (path, len(raw), len(data)))
+        out.append("static const uint8_t WEB_ASSET_DATA_%d[] PROGMEM = {" % i)
+        out.append(c_bytes(data))
+        out.append("};")
+        out.append("")
+        table.append('  {"%s", "%s", "%s", WEB_ASSET_DATA_%d, %d, %s},'
+                     % (path, kind, etag, i, len(data), "true" if immutable else "false"))
+        total_raw += len(raw)
+        total_gz += len(data)
+
+    out.append("static const WebAsset WEB_ASSETS[] = {")
+    out.extend(table)
+    out.append("};")
+    out.append("")
+    out.append("static constexpr int WEB_ASSET_COUNT = %d;" % len(assets))
+    text = "\n".join(out) + "\n"
+
+    old = None
+    if os.path.exists(OUT_PATH):
+        with open(OUT_PATH, encoding="utf-8") as f:
+            old = f.read()
+    if text != old:
+        with open(OUT_PATH, "w", encoding="utf-8") as f:
+            f.write(text)
+        print("build_web: %d assets, %d bytes -> %d gzip" % (len(assets), total_raw, total_gz))
+
+
+build()
@@ -0,0 +1,545 @@
+let mode="edit";
+let pat=emptyPattern("",12,24);
+let activeRow=0;      // knitted row (after tiling/mirroring)
+let patternRow=0;     // pattern row shown at activeRow
+let knitH=24;         // knitted height
+let totalPulses=0;
+let warn=false;
+const MAX_W=256, MAX_H=4096;
+
+// Editor edits are sent as small patches after a short pause
+let patFile="";            // file the editor content belongs to
+let synced={w:12,h:24};    // size of patFile on the server
+let pending=new Map();     // "row,col" -> 0|1 not yet sent
+let patchTimer=null;
+let patchChain=Promise.resolve();  // patches go out one at a time, in order
+const PATCH_DELAY=400;
+
+const c=document.getElementById("grid");
+const ctx=c.getContext("2d");
+
+function setRow(d){
+  activeRow=d.activeRow||0;
+  patternRow=(d.patternRow!==undefined)?d.patternRow:activeRow;
+}
+function setStatus(t){document.getElementById("status").textContent=t;}
+function setMode(m){mode=m;document.getElementById("modePill").textContent=(m==="edit"?"EDIT":"KNIT"); draw();}
+document.getElementById("btnEdit").onclick=()=>setMode("edit");
+document.getElementById("btnKnit").onclick=()=>setMode("knit");
+
+// Pattern rows are kept as on the wire (/api/pattern.bin): one Uint8Array,
+// stride=ceil(w/8) bytes per row, column c in byte c>>3, bit c&7
+function emptyPattern(name,w,h){
+  const stride=(w+7)>>3;
+  return {name,w,h,stride,bits:new Uint8Array(stride*h)};
+}
+function cell(r,col){ return (pat.bits[r*pat.stride+(col>>3)]>>(col&7))&1; }
+function rowString(r){
+  let s="";
+  for(let col=0;col<pat.w;col++) s+=cell(r,col);
+  return s;
+}
+
+// Header: magic "KLPW", version, name/file lengths, w, h, activeRow, patternRow (see docs/api.md)
+const WIRE_HEAD=20;
+function decodePattern(buf){
+  const u=new Uint8Array(buf), v=new DataView(buf);
+  if(buf.byteLength<WIRE_HEAD||String.fromCharCode(u[0],u[1],u[2],u[3])!=="KLPW"||u[4]!==1)
+    throw new Error("Bad pattern data");
+  const n=u[5], f=u[6], w=v.getUint16(8,true), h=v.getUint16(10,true);
+  const stride=(w+7)>>3, at=WIRE_HEAD+n+f;
+  if(buf.byteLength!==at+stride*h) throw new Error("Bad pattern data");
+  const td=new TextDecoder();
+  return {
+    file:td.decode(u.subarray(WIRE_HEAD+n,at)),
+    activeRow:v.getInt32(12,true),
+    patternRow:v.getInt32(16,true),
+    // a view into the response, not a copy
+    pattern:{name:td.decode(u.subarray(WIRE_HEAD,WIRE_HEAD+n)),w,h,stride,bits:new Uint8Array(buf,at,stride*h)}
+  };
+}
+function encodePattern(file){
+  const te=new TextEncoder();
+  const name=te.encode(pat.name||"").subarray(0,63), path=te.encode(file).subarray(0,255);
+  const at=WIRE_HEAD+name.length+path.length;
+  const buf=new ArrayBuffer(at+pat.bits.length), u=new Uint8Array(buf), v=new DataView(buf);
+  u.set([75,76,80,87,1,name.length,path.length,0]);
+  v.setUint16(8,pat.w,true); v.setUint16(10,pat.h,true);
+  v.setInt32(12,-1,true); v.setInt32(16,-1,true);
+  u.set(name,WIRE_HEAD); u.set(path,WIRE_HEAD+name.length); u.set(pat.bits,at);
+  return buf;
+}
+
+// Cell size shrinks for wide/tall patterns so the canvas stays within browser limits
+function cellSize(){
+  let s=Math.floor(940/pat.w);
+  s=Math.min(s,Math.floor(16000/pat.h));
+  return Math.max(3,Math.min(24,s));
+}
+
+// Draw with row numbers on the RIGHT and needle numbers UNDER
+function draw(){
+  const size = cellSize();
+  const marginBottom = 22;
+  const marginRight  = 34;
+
+  const gridW = pat.w * size;
+  const gridH = pat.h * size;
+
+  c.width  = gridW + marginRight;
+  c.height = gridH + marginBottom;
+
+  ctx.clearRect(0,0,c.width,c.height);
+
+  // cells
+  for(let r=0;r<pat.h;r++){
+    for(let col=0;col<pat.w;col++){
+      const v = cell(r,col);
+      const x = col*size;
+      const y = r*size;
+
+      if(mode==="knit" && r===patternRow){
+        ctx.fillStyle="#fff7d6";
+        ctx.fillRect(x,y,size,size);
+        ctx.fillStyle=v?"#111":"#fff";
+        ctx.fillRect(x+4,y+4,size-8,size-8);
+      } else {
+        ctx.fillStyle = v ? "#111" : "#fff";
+        ctx.fillRect(x,y,size,size);
+      }
+
+      if(size>=8){
+        ctx.strokeStyle="#ccc";
+        ctx.strokeRect(x,y,size,size);
+      }
+    }
+  }
+
+  // numbers style
+  ctx.fillStyle = "#444";
+  ctx.font = "12px system-ui, Arial";
+  ctx.textBaseline = "middle";
+
+  // needle numbers under: rightmost = 1 => label = (w - col)
+  ctx.textAlign = "center";
+  const labelStep = size>=16 ? 1 : Math.ceil(16/size);
+  for(let col=0; col<pat.w; col++){
+    if((pat.w-col)%labelStep) continue;
+    const needle = pat.w - col;
+    const x = col*size + size/2;
+    const y = gridH + marginBottom/2;
+    ctx.fillText(String(needle), x, y);
+  }
+
+  // row numbers on right
+  ctx.textAlign = "left";
+  for(let r=0; r<pat.h; r++){
+    if((r+1)%labelStep) continue;
+    const rowNum = r + 1;
+    const x = gridW + 6;
+    const y = r*size + size/2;
+    ctx.fillText(String(rowNum).padStart(2,"0"), x, y);
+  }
+}
+
+function toggleCell(clientX,clientY){
+  if(mode!=="edit") return;
+  const rect=c.getBoundingClientRect();
+  const x=clientX-rect.left, y=clientY-rect.top;
+
+  // Only inside the actual grid area
+  const size = cellSize();
+  const col=Math.floor(x/size), row=Math.floor(y/size);
+  if(row<0||row>=pat.h||col<0||col>=pat.w) return;
+
+  pat.bits[row*pat.stride+(col>>3)]^=1<<(col&7);
+  draw();
+  queueCell(row,col,cell(row,col));
+}
+
+function queueCell(r,col,v){
+  pending.set(r+","+col,v);
+  clearTimeout(patchTimer);
+  patchTimer=setTimeout(flushPatch,PATCH_DELAY);
+}
+
+function setSynced(file){
+  patFile=file; synced={w:pat.w,h:pat.h}; pending=new Map();
+  clearTimeout(patchTimer); patchTimer=null;
+}
+
+function flushPatch(){
+  clearTimeout(patchTimer); patchTimer=null;
+  patchChain=patchChain.then(sendPatch);
+  return patchChain;
+}
+
+// Rows with many edits are sent whole (consecutive ones merged), the rest as cells
+async function sendPatch(){
+  if(!pending.size||!patFile) return;
+  if(pat.w!==synced.w||pat.h!==synced.h){ setStatus("Size changed - press Save"); return; }
+
+  const byRow=new Map();
+  pending.forEach((v,k)=>{
+    const [r,col]=k.split(",").map(Number);
+    if(!byRow.has(r)) byRow.set(r,[]);
+    byRow.get(r).push([r,col,v]);
+  });
+  pending=new Map();
+
+  const cells=[], rows=[];
+  [...byRow.keys()].sort((a,b)=>a-b).forEach(r=>{
+    const list=byRow.get(r);
+    if(list.length*10>pat.w){
+      const last=rows[rows.length-1];
+      if(last && last.r+last.pixels.length===r) last.pixels.push(rowString(r));
+      else rows.push({r,pixels:[rowString(r)]});
+    } else cells.push(...list);
+  });
+
+  const file=patFile;
+  try{
+    try{
+      await apiPOST("/api/pattern/patch",{file,w:pat.w,h:pat.h,cells,rows});
+    }catch(e){
+      // Server copy out of step: store the whole pattern instead
+      await postPattern(file);
+    }
+    setStatus("Saved "+file.split("/").pop());
+  }catch(e){
+    setStatus("Save failed: "+e.message);
+  }
+}
+
+c.addEventListener("click",e=>toggleCell(e.clientX,e.clientY));
+c.addEventListener("touchstart",e=>{const t=e.touches[0];toggleCell(t.clientX,t.clientY);},{passive:true});
+
+async function apiGET(u){
+  const r=await fetch(u);
+  if(!r.ok) throw new Error(await r.text());
+  return r.json();
+}
+async function apiPOST(u,o){
+  const r=await fetch(u,{method:"POST",headers:{"Content-Type":"application/json"},body:JSON.stringify(o)});
+  if(!r.ok) throw new Error(await r.text());
+  return r.json();
+}
+
+// Whole patterns travel bit-packed; see decodePattern()/encodePattern()
+async function getPattern(file){
+  const r=await fetch("/api/pattern.bin"+(file?"?file="+encodeURIComponent(file):""));
+  if(!r.ok) throw new Error(await r.text());
+  return decodePattern(await r.arrayBuffer());
+}
+async function postPattern(file){
+  const r=await fetch("/api/pattern.bin",{method:"POST",headers:{"Content-Type":"application/x-knittled-pattern"},body:encodePattern(file)});
+  if(!r.ok) throw new Error(await r.text());
+  return r.json();
+}
+
+// File list from the catalog, a page at a time; size and duplicates come
+// with it, so no file has to be loaded to label it
+const FILES_PAGE=100;
+async function refreshFiles(){
+  const sel=document.getElementById("fileList");
+  sel.innerHTML="";
+  for(let offset=0;;offset+=FILES_PAGE){
+    const page=await apiGET("/api/files?sort=path&limit="+FILES_PAGE+"&offset="+offset);
+    page.files.forEach(f=>{
+      const o=document.createElement("option");
+      o.value=f.file;                     // keep full path
+      let label=f.file.split("/").pop();  // display base name
+      if(f.w) label+=" ("+f.w+"\u00d7"+f.h+")";
+      if(f.dup) label+=" = "+f.dup.split("/").pop();
+      o.textContent=label;
+      sel.appendChild(o);
+    });
+    if(offset+FILES_PAGE>=page.total) break;
+  }
+}
+
+async function loadSelected(){
+  await flushPatch();
+  const file=document.getElementById("fileList").value;
+  const data=await getPattern(file);
+  pat=data.pattern;
+  setSynced(data.file);
+  setRow(data);
+  document.getElementById("w").value=pat.w;
+  document.getElementById("h").value=pat.h;
+  draw();
+  setStatus("Loaded "+file.split("/").pop());
+}
+
+async function saveSelected(){
+  const file=document.getElementById("fileList").value;
+  await postPattern(file);
+  setSynced(file);
+  setStatus("Saved "+file.split("/").pop());
+  await refreshFiles();
+  document.getElementById("fileList").value=file;
+}
+
+document.getElementById("btnLoad").onclick=loadSelected;
+document.getElementById("btnSave").onclick=saveSelected;
+
+document.getElementById("btnReload").onclick=async()=>{
+  await refreshFiles();
+  await loadSelected();
+};
+
+document.getElementById("btnNew").onclick=async()=>{
+  const name=document.getElementById("newName").value.trim();
+  if(!name) return alert("Enter a file name");
+  const file="/patterns/"+name.replace(/[^a-zA-Z0-9._-]/g,"_");
+  await postPattern(file);
+  setSynced(file);
+  await refreshFiles();
+  document.getElementById("fileList").value=file;
+  setStatus("Created "+file.split("/").pop());
+};
+
+document.getElementById("btnDelete").onclick=async()=>{
+  const file=document.getElementById("fileList").value;
+  if(!confirm("Delete "+file.split("/").pop()+" ?")) return;
+  const r=await apiPOST("/api/delete",{file});
+  await refreshFiles();
+  // Deleting the knitted file switched knitting to r.file
+  if(r.file){
+    document.getElementById("fileList").value=r.file;
+    await loadSelected();
+  }
+  setStatus("Deleted");
+};
+
+document.getElementById("btnResize").onclick=async()=>{
+  let w=parseInt(document.getElementById("w").value,10);
+  let h=parseInt(document.getElementById("h").value,10);
+  w=Math.max(1,Math.min(MAX_W,w));
+  h=Math.max(1,Math.min(MAX_H,h));
+
+  // Resize the stored copy too, so later edits can still go out as patches
+  if(patFile && pat.w===synced.w && pat.h===synced.h){
+    await flushPatch();
+    try{
+      await apiPOST("/api/pattern/rows",{file:patFile,op:"resize",w,h});
+      synced={w,h};
+    }catch(e){
+      setStatus("Resize not stored - press Save");
+    }
+  }
+
+  // Copy the overlap row by row; bits past a narrower width are cleared
+  const next=emptyPattern(pat.name,w,h);
+  const keep=Math.min(w,pat.w), nb=(keep+7)>>3, tail=keep&7;
+  for(let r=0;r<Math.min(h,pat.h);r++){
+    next.bits.set(pat.bits.subarray(r*pat.stride,r*pat.stride+nb),r*next.stride);
+    if(tail) next.bits[r*next.stride+nb-1]&=(1<<tail)-1;
+  }
+  pat=next;
+  draw();
+};
+
+// Row operations run on the server; the same edit is mirrored locally
+async function rowOp(op){
+  if(!patFile) return;
+  if(pat.w!==synced.w||pat.h!==synced.h) return alert("Size changed - press Save first");
+  const num=id=>parseInt(document.getElementById(id).value,10)||1;
+  const at=num("rowAt")-1, count=num("rowCount"), arg=num("rowArg");
+  await flushPatch();
+  try{
+    await apiPOST("/api/pattern/rows",{file:patFile,op,at,count,to:arg-1,times:arg});
+  }catch(e){
+    return setStatus("Row edit failed: "+e.message);
+  }
+
+  const px=[];
+  for(let r=0;r<pat.h;r++) px.push(pat.bits.subarray(r*pat.stride,(r+1)*pat.stride));
+  const blk=px.slice(at,at+count);
+  if(op==="insert") px.splice(at,0,...Array(count).fill(new Uint8Array(pat.stride)));
+  else if(op==="delete") px.splice(at,count);
+  else if(op==="duplicate") px.splice(at+count,0,...blk);
+  else if(op==="repeat") for(let i=1;i<arg;i++) px.splice(at+count*i,0,...blk);
+  else if(op==="move"){ px.splice(at,count); px.splice(arg-1,0,...blk); }
+  const bits=new Uint8Array(px.length*pat.stride);
+  px.forEach((row,r)=>bits.set(row,r*pat.stride));
+  pat.bits=bits; pat.h=px.length; synced.h=pat.h;
+  document.getElementById("h").value=pat.h;
+  draw();
+  setStatus("Rows: "+op);
+}
+document.getElementById("btnRowIns").onclick=()=>rowOp("insert");
+document.getElementById("btnRowDel").onclick=()=>rowOp("delete");
+document.getElementById("btnRowDup").onclick=()=>rowOp("duplicate");
+document.getElementById("btnRowMove").onclick=()=>rowOp("move");
+document.getElementById("btnRowRep").onclick=()=>rowOp("repeat");
+
+document.getElementById("btnPrevRow").onclick=async()=>{
+  const d=await apiPOST("/api/row",{delta:-1});
+  setRow(d);
+  if(mode==="knit") draw();
+};
+document.getElementById("btnNextRow").onclick=async()=>{
+  const d=await apiPOST("/api/row",{delta:+1});
+  setRow(d);
+  if(mode==="knit") draw();
+};
+document.getElementById("btnConfirm").onclick=async()=>{
+  const d=await apiPOST("/api/confirm",{});
+  setRow(d);
+  if(mode==="knit") draw();
+};
+
+document.getElementById("btnDownload").onclick=()=>{
+  const file=document.getElementById("fileList").value;
+  window.location="/download?file="+encodeURIComponent(file);
+};
+
+document.getElementById("btnConvert").onclick=async()=>{
+  const file=document.getElementById("fileList").value;
+  const d=await apiPOST("/api/convert",{file});
+  await refreshFiles();
+  document.getElementById("fileList").value=d.file;
+  setStatus("Converted to "+d.file.split("/").pop());
+};
+
+document.getElementById("btnUpload").onclick=async()=>{
+  const inp=document.getElementById("uploadFile");
+  if(!inp.files.length) return alert("Choose a file first");
+  const f=inp.files[0];
+  const fd=new FormData(); fd.append("upload",f,f.name);
+  const r=await fetch("/upload",{method:"POST",body:fd});
+  if(!r.ok) return alert("Upload failed: "+await r.text());
+  setStatus(await r.text());
+  await refreshFiles();
+};
+
+// ---- Config modal ----
+function intToHexColor(v){
+  const r=(v>>16)&255, g=(v>>8)&255, b=v&255;
+  return "#"+[r,g,b].map(x=>x.toString(16).padStart(2,"0")).join("");
+}
+function hexToInt(s){ return parseInt(s.slice(1),16); }
+
+document.getElementById("btnConfig").onclick=async()=>{
+  const cfg=await apiGET("/api/config");
+  document.getElementById("cfgActive").value=intToHexColor(cfg.colorActive);
+  document.getElementById("cfgConfirmed").value=intToHexColor(cfg.colorConfirmed);
+  document.getElementById("cfgBright").value=cfg.brightness;
+  document.getElementById("cfgCorr").value=intToHexColor(cfg.colorCorrection);
+  document.getElementById("cfgSeg").value=cfg.ledSegments;
+  document.getElementById("cfgNP").value=cfg.needlePitch/100;
+  document.getElementById("cfgLP").value=cfg.ledPitch/100;
+  document.getElementById("cfgVC").value=cfg.viewCenter;
+  document.getElementById("cfgAA").checked=!!cfg.autoAdvance;
+  document.getElementById("cfgBW").checked=!!cfg.blinkWarning;
+  document.getElementById("cfgRB").checked=!!cfg.rowFromBottom;
+  document.getElementById("cfgMH").checked=!!cfg.mirrorH;
+  document.getElementById("cfgMV").checked=!!cfg.mirrorV;
+  document.getElementById("cfgInv").checked=!!cfg.invert;
+  document.getElementById("cfgTX").value=cfg.tileX;
+  document.getElementById("cfgTY").value=cfg.tileY;
+  document.getElementById("cfgOff").value=cfg.needleOffset;
+  document.getElementById("cfg").style.display="block";
+};
+document.getElementById("cfgClose").onclick=()=>{document.getElementById("cfg").style.display="none";};
+document.getElementById("cfgSave").onclick=async()=>{
+  const payload={
+    colorActive: hexToInt(document.getElementById("cfgActive").value),
+    colorConfirmed: hexToInt(document.getElementById("cfgConfirmed").value),
+    brightness: parseInt(document.getElementById("cfgBright").value,10),
+    colorCorrection: hexToInt(document.getElementById("cfgCorr").value),
+    ledSegments: document.getElementById("cfgSeg").value.replace(/\s+/g,""),
+    needlePitch: Math.round(parseFloat(document.getElementById("cfgNP").value)*100)||450,
+    ledPitch: Math.round(parseFloat(document.getElementById("cfgLP").value)*100)||450,
+    viewCenter: parseInt(document.getElementById("cfgVC").value,10)||0,
+    autoAdvance: document.getElementById("cfgAA").checked,
+    blinkWarning: document.getElementById("cfgBW").checked,
+    rowFromBottom: document.getElementById("cfgRB").checked,
+    mirrorH: document.getElementById("cfgMH").checked,
+    mirrorV: document.getElementById("cfgMV").checked,
+    invert: document.getElementById("cfgInv").checked,
+    tileX: parseInt(document.getElementById("cfgTX").value,10)||1,
+    tileY: parseInt(document.getElementById("cfgTY").value,10)||1,
+    needleOffset: parseInt(document.getElementById("cfgOff").value,10)||0
+  };
+  await apiPOST("/api/config", payload);
+  setStatus("Config saved");
+  document.getElementById("cfg").style.display="none";
+};
+
+// ---- Knitting state (pushed, polled as fallback) ----
+function renderPills(){
+  document.getElementById("rowPill").textContent =
+    "Row: " + String(activeRow+1).padStart(2,"0") + "/" + String(knitH).padStart(2,"0");
+  document.getElementById("totPill").textContent = "Tot: " + totalPulses;
+
+  const wp=document.getElementById("warnPill");
+  const gc=document.getElementById("gridCard");
+  if(warn){
+    wp.style.display="inline-block";
+    gc.classList.add("warn");
+  } else {
+    wp.style.display="none";
+    gc.classList.remove("warn");
+  }
+}
+
+// Knitting state as last received: the stream sends changed fields only
+const knitState={};
+let streaming=false, polling=false;
+
+function applyState(d){
+  Object.assign(knitState, d);
+  setRow(knitState);
+  knitH = knitState.h;
+  totalPulses = knitState.totalPulses;
+  warn = !!knitState.warn;
+  renderPills();
+  if(mode==="knit") draw();
+}
+
+// Pushed updates; polling covers browsers without EventSource and the time
+// the stream is down (the browser reconnects by itself).
+function startEvents(){
+  if(!window.EventSource){ poll(); return; }
+  const es=new EventSource("/api/events");
+  es.addEventListener("state", e=>applyState(JSON.parse(e.data)));
+  es.onopen=()=>{ streaming=true; };
+  es.onerror=()=>{
+    streaming=false;
+    if(!polling) poll();
+  };
+}
+
+async function poll(){
+  if(streaming){ polling=false; return; }
+  polling=true;
+  try{
+    applyState(await apiGET("/api/state"));
+  }catch(e){
+    // keep quiet; polling will retry
+  }
+  setTimeout(poll, 350);
+}
+
+async function init(){
+  await refreshFiles();
+  // If no files, create default entry view by loading default
+  if (!document.getElementById("fileList").value) {
+    // Force load default pattern endpoint (server will create it if missing)
+    const data = await getPattern("");
+    pat = data.pattern;
+    setSynced(data.file);
+    setRow(data);
+  } else {
+    await loadSelected();
+  }
+
+  setMode("edit");
+  renderPills();
+  startEvents();
+  setStatus("Ready.");
+}
+
+init().catch(e=>setStatus("Error: "+e.message));